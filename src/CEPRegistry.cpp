@@ -0,0 +1,315 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    CEPRegistry.cpp
+/// @author  agent
+/// @date    2026/10/17
+///
+//
+/****************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include "CEPRegistry.h"
+#include "PHEMlight/Constants.h"
+
+cep_entry::cep_entry(const std::string &p_data_path, const PHEMlightdll::Helpers &p_helper, const cep_options &p_options)
+{
+  data_path = p_data_path;
+  helper = p_helper;
+  options = p_options;
+  cep_handler = NULL;
+  cep = NULL;
+  load_time = 0;
+  cached = false;
+  embedded = false;
+  loaded = false;
+}
+
+cep_entry::~cep_entry()
+{
+  // the cep handler doesn't own its ceps
+  delete cep;
+  delete cep_handler;
+}
+
+void cep_entry::load()
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  PHEMlightdll::CEPHandler *new_cep_handler = new PHEMlightdll::CEPHandler();
+  new_cep_handler->setCachePath(options.cache_path);
+  new_cep_handler->setUseEmbedded(options.use_embedded);
+  PHEMlightdll::CEP *new_cep = NULL;
+  bool new_cached = false;
+  bool new_embedded = false;
+  std::vector<std::string> path(1, data_path);
+  if (new_cep_handler->GetCEP(path, &helper))
+  {
+    // prepare the cep before it is shared
+    new_cep = new_cep_handler->getCEPS().find(helper.getgClass())->second;
+    new_cached = new_cep_handler->getCacheHits() > 0;
+    new_embedded = new_cep_handler->getEmbeddedHits() > 0;
+    if (options.use_uniform_grids)
+    {
+      new_cep->InitializeUniformGrids(options.grid_max_error, options.grid_max_size);
+    }
+    new_cep->setInstructionSet(options.instruction_set);
+    if (options.precision == PHEMlightdll::Batch::Precision_Single)
+    {
+      compare_precision(new_cep);
+    }
+  }
+  else
+  {
+    delete new_cep_handler;
+    new_cep_handler = NULL;
+  }
+
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    cep_handler = new_cep_handler;
+    cep = new_cep;
+    load_time = std::chrono::duration<double>(end - start).count();
+    cached = new_cached;
+    embedded = new_embedded;
+    loaded = true;
+  }
+  loaded_condition.notify_all();
+}
+
+void cep_entry::evaluate_drive_cycles(PHEMlightdll::CEP *new_cep, std::vector<std::vector<std::vector<double> > > &outputs)
+{
+  // same steps as the deferred calculation of the handler, all pollutants of the cep, level road
+  std::vector<int> pollutant_indices(1, PHEMlightdll::CEP::PollutantIndexFC);
+  for (int i = 0; i < new_cep->GetPollutantCount(); i++)
+  {
+    pollutant_indices.push_back(i);
+  }
+  int pollutant_count = (int)pollutant_indices.size();
+
+  const std::vector<drive_cycle> &cycles = get_standard_drive_cycles();
+  outputs.assign(cycles.size(), std::vector<std::vector<double> >());
+  for (size_t c = 0; c < cycles.size(); c++)
+  {
+    std::vector<double> velocity = cycles[c].velocity;
+    std::vector<double> acceleration = cycles[c].acceleration;
+    int n = (int)velocity.size();
+    std::vector<double> gradient(n, 0);
+    std::vector<double> max_acceleration(n);
+    std::vector<double> power(n);
+    std::vector<double> decel_coast(n);
+    std::vector<double> values(n * pollutant_count);
+
+    new_cep->GetMaxAccelBatch(n, &velocity[0], &gradient[0], &max_acceleration[0]);
+    for (int i = 0; i < n; i++)
+    {
+      if (velocity[i] == 0)
+      {
+        acceleration[i] = 0;
+      }
+      else if (acceleration[i] > max_acceleration[i])
+      {
+        acceleration[i] = max_acceleration[i];
+      }
+    }
+    new_cep->CalcPowerBatch(n, &velocity[0], &acceleration[0], &gradient[0], &power[0]);
+    new_cep->GetDecelCoastBatch(n, &velocity[0], &acceleration[0], &gradient[0], &decel_coast[0]);
+    new_cep->GetEmissionsBatch(&pollutant_indices[0], pollutant_count, n, &power[0], &velocity[0], &values[0], &helper);
+
+    // output 0 is the power, then FC and the pollutants, zero while coasting
+    outputs[c].assign(pollutant_count + 1, std::vector<double>(n, 0));
+    for (int i = 0; i < n; i++)
+    {
+      outputs[c][0][i] = power[i];
+      bool coasting = !new_cep->getIsBEV() && acceleration[i] < decel_coast[i] && velocity[i] > PHEMlightdll::Constants::ZERO_SPEED_ACCURACY;
+      for (int j = 0; j < pollutant_count && !coasting; j++)
+      {
+        outputs[c][j + 1][i] = values[i * pollutant_count + j];
+      }
+    }
+  }
+}
+
+void cep_entry::compare_precision(PHEMlightdll::CEP *new_cep)
+{
+  std::vector<std::vector<std::vector<double> > > reference;
+  new_cep->setPrecision(PHEMlightdll::Batch::Precision_Double);
+  evaluate_drive_cycles(new_cep, reference);
+
+  std::vector<std::vector<std::vector<double> > > single;
+  new_cep->setPrecision(PHEMlightdll::Batch::Precision_Single);
+  evaluate_drive_cycles(new_cep, single);
+
+  const std::vector<drive_cycle> &cycles = get_standard_drive_cycles();
+  for (size_t c = 0; c < cycles.size(); c++)
+  {
+    for (size_t j = 0; j < reference[c].size(); j++)
+    {
+      double max_value = 0;
+      double max_deviation = 0;
+      double reference_sum = 0;
+      double single_sum = 0;
+      for (size_t i = 0; i < reference[c][j].size(); i++)
+      {
+        max_value = std::max(max_value, std::fabs(reference[c][j][i]));
+        max_deviation = std::max(max_deviation, std::fabs(single[c][j][i] - reference[c][j][i]));
+        reference_sum += reference[c][j][i];
+        single_sum += single[c][j][i];
+      }
+
+      precision_error error;
+      error.cycle = cycles[c].name;
+      error.output = j == 0 ? "POWER" : j == 1 ? "FC" : new_cep->GetPollutantIdentifier((int)j - 2);
+      error.max_error = max_value > 0 ? max_deviation / max_value : 0;
+      error.total_error = reference_sum != 0 ? std::fabs(single_sum - reference_sum) / std::fabs(reference_sum) : 0;
+      precision_errors.push_back(error);
+    }
+  }
+}
+
+const PHEMlightdll::CEP *cep_entry::wait() const
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  loaded_condition.wait(lock, [this]
+                        { return loaded; });
+  return cep;
+}
+
+bool cep_entry::is_loaded() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return loaded;
+}
+
+const std::string &cep_entry::get_data_path() const
+{
+  return data_path;
+}
+
+const std::string &cep_entry::get_g_class() const
+{
+  return helper.getgClass();
+}
+
+const std::string &cep_entry::get_error() const
+{
+  return helper.getErrMsg();
+}
+
+double cep_entry::get_load_time() const
+{
+  return load_time;
+}
+
+bool cep_entry::is_cached() const
+{
+  return cached;
+}
+
+bool cep_entry::is_embedded() const
+{
+  return embedded;
+}
+
+const std::vector<precision_error> &cep_entry::get_precision_errors() const
+{
+  return precision_errors;
+}
+
+bool cep_registry::cep_key::operator<(const cep_key &other) const
+{
+  if (data_path != other.data_path)
+  {
+    return data_path < other.data_path;
+  }
+  if (g_class != other.g_class)
+  {
+    return g_class < other.g_class;
+  }
+  if (options.use_uniform_grids != other.options.use_uniform_grids)
+  {
+    return options.use_uniform_grids < other.options.use_uniform_grids;
+  }
+  if (options.use_uniform_grids && options.grid_max_error != other.options.grid_max_error)
+  {
+    return options.grid_max_error < other.options.grid_max_error;
+  }
+  if (options.use_uniform_grids && options.grid_max_size != other.options.grid_max_size)
+  {
+    return options.grid_max_size < other.options.grid_max_size;
+  }
+  if (options.use_embedded != other.options.use_embedded)
+  {
+    return options.use_embedded < other.options.use_embedded;
+  }
+  if (options.precision != other.options.precision)
+  {
+    return options.precision < other.options.precision;
+  }
+  return options.instruction_set < other.options.instruction_set;
+}
+
+cep_registry::cep_registry()
+{
+  request_count = 0;
+  load_count = 0;
+}
+
+cep_registry &cep_registry::instance()
+{
+  static cep_registry registry;
+  return registry;
+}
+
+std::shared_ptr<cep_entry> cep_registry::request(const std::string &data_path, const PHEMlightdll::Helpers &helper, const cep_options &options, bool &created)
+{
+  cep_key key;
+  key.data_path = data_path;
+  key.g_class = helper.getgClass();
+  key.options = options;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  request_count++;
+
+  std::map<cep_key, std::weak_ptr<cep_entry> >::iterator element = entries.find(key);
+  if (element != entries.end())
+  {
+    std::shared_ptr<cep_entry> entry = element->second.lock();
+    if (entry)
+    {
+      created = false;
+      return entry;
+    }
+  }
+
+  // first request or all users released it, the caller loads it
+  std::shared_ptr<cep_entry> entry(new cep_entry(data_path, helper, options));
+  entries[key] = entry;
+  load_count++;
+  created = true;
+  return entry;
+}
+
+unsigned int cep_registry::get_request_count()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return request_count;
+}
+
+unsigned int cep_registry::get_load_count()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return load_count;
+}
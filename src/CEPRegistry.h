@@ -0,0 +1,152 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    CEPRegistry.h
+/// @author  agent
+/// @date    2026/10/17
+///
+/// Process wide cache of loaded CEPs shared by vehicle types and handlers.
+//
+/****************************************************************************/
+
+#ifndef __CEPREGISTRY_H
+#define __CEPREGISTRY_H
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "DriveCycles.h"
+#include "PHEMlight/CEP.h"
+#include "PHEMlight/CEPBatch.h"
+#include "PHEMlight/CEPHandler.h"
+#include "PHEMlight/Helpers.h"
+
+// settings applied to a cep after loading, ceps with different options are separate entries
+struct cep_options
+{
+  bool use_uniform_grids;
+  double grid_max_error;
+  int grid_max_size;
+  PHEMlightdll::Batch::InstructionSet instruction_set;
+  PHEMlightdll::Batch::Precision precision;
+
+  // classes compiled into the library are used instead of their files, which may have changed since
+  bool use_embedded;
+
+  // directory of the binary cep cache, empty disables it. Not part of the key, cached and parsed
+  // ceps are identical
+  std::string cache_path;
+};
+
+// deviation of the single precision batch methods from double precision over one drive cycle
+struct precision_error
+{
+  std::string cycle;
+  std::string output; // POWER, FC or a pollutant of the cep
+
+  // largest deviation of a second relative to the largest double value of the cycle
+  double max_error;
+  // deviation of the cycle sum relative to the double sum
+  double total_error;
+};
+
+// cep of one class, loaded once by one thread and immutable afterwards
+class cep_entry
+{
+
+private:
+  std::string data_path;
+  cep_options options;
+
+  // class of the cep, receives the error message if loading fails
+  PHEMlightdll::Helpers helper;
+
+  PHEMlightdll::CEPHandler *cep_handler;
+  PHEMlightdll::CEP *cep;
+  double load_time; // seconds
+  bool cached;      // read from the binary cache instead of the source files
+  bool embedded;    // compiled into the library
+
+  // filled at load for single precision
+  std::vector<precision_error> precision_errors;
+
+  mutable std::mutex mutex;
+  mutable std::condition_variable loaded_condition;
+  bool loaded;
+
+  cep_entry(const cep_entry &);
+  cep_entry &operator=(const cep_entry &);
+
+  // power and outputs of the standard drive cycles with the current precision of the cep
+  void evaluate_drive_cycles(PHEMlightdll::CEP *new_cep, std::vector<std::vector<std::vector<double> > > &outputs);
+
+  void compare_precision(PHEMlightdll::CEP *new_cep);
+
+public:
+  cep_entry(const std::string &p_data_path, const PHEMlightdll::Helpers &p_helper, const cep_options &p_options);
+  ~cep_entry();
+
+  // parses the files of the class, called once by the thread that created the entry
+  void load();
+
+  // blocks until the cep is loaded, NULL if loading failed
+  const PHEMlightdll::CEP *wait() const;
+
+  bool is_loaded() const;
+
+  const std::string &get_data_path() const;
+  const std::string &get_g_class() const;
+
+  // valid after wait
+  const std::string &get_error() const;
+  double get_load_time() const;
+  bool is_cached() const;
+  bool is_embedded() const;
+  const std::vector<precision_error> &get_precision_errors() const;
+};
+
+class cep_registry
+{
+
+private:
+  struct cep_key
+  {
+    std::string data_path;
+    std::string g_class;
+    cep_options options;
+
+    bool operator<(const cep_key &other) const;
+  };
+
+  // entries live as long as one binding references them
+  std::mutex mutex;
+  std::map<cep_key, std::weak_ptr<cep_entry> > entries;
+
+  // statistics since process start
+  unsigned int request_count;
+  unsigned int load_count;
+
+  cep_registry();
+
+public:
+  static cep_registry &instance();
+
+  // shared entry of the class of helper (Helpers::getgClass) in data_path. If created is set the
+  // caller has to load the entry, otherwise it is loaded or being loaded by another caller
+  std::shared_ptr<cep_entry> request(const std::string &data_path, const PHEMlightdll::Helpers &helper, const cep_options &options, bool &created);
+
+  unsigned int get_request_count();
+  unsigned int get_load_count();
+};
+
+#endif /* __CEPREGISTRY_H */
@@ -0,0 +1,86 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    DriveCycles.cpp
+/// @author  agent
+/// @date    2026/10/17
+///
+//
+/****************************************************************************/
+
+#include "DriveCycles.h"
+
+// phase of a cycle, the speed changes linearly to end_speed within duration
+struct cycle_phase
+{
+  int duration;     // s
+  double end_speed; // km/h
+};
+
+// ECE-15 urban cycle, 195 s
+static const cycle_phase ECE_15[] = {
+    {11, 0}, {4, 15}, {8, 15}, {2, 10}, {3, 0}, {21, 0}, {5, 15}, {2, 15}, {5, 32}, {24, 32}, {8, 10}, {3, 0}, {21, 0},
+    {5, 15}, {2, 15}, {9, 35}, {2, 35}, {8, 50}, {12, 50}, {8, 35}, {13, 35}, {2, 35}, {7, 10}, {3, 0}, {7, 0}};
+
+// extra urban driving cycle, 400 s
+static const cycle_phase EUDC[] = {
+    {20, 0}, {5, 15}, {2, 15}, {9, 35}, {2, 35}, {8, 50}, {2, 50}, {13, 70}, {50, 70}, {8, 50}, {69, 50},
+    {13, 70}, {50, 70}, {35, 100}, {30, 100}, {20, 120}, {10, 120}, {16, 80}, {8, 50}, {10, 0}, {20, 0}};
+
+static void append_phases(std::vector<double> &speeds, const cycle_phase *phases, size_t count)
+{
+  // speeds in km/h at the start of each second, the cycles start standing
+  double speed = speeds.empty() ? 0 : speeds.back();
+  for (size_t i = 0; i < count; i++)
+  {
+    double start_speed = speed;
+    for (int t = 1; t <= phases[i].duration; t++)
+    {
+      speed = start_speed + (phases[i].end_speed - start_speed) * t / phases[i].duration;
+      speeds.push_back(speed);
+    }
+  }
+}
+
+static drive_cycle create_drive_cycle(const std::string &name, const std::vector<double> &speeds)
+{
+  drive_cycle cycle;
+  cycle.name = name;
+  for (size_t i = 0; i < speeds.size(); i++)
+  {
+    double next_speed = i + 1 < speeds.size() ? speeds[i + 1] : speeds[i];
+    cycle.velocity.push_back(speeds[i] / 3.6);
+    cycle.acceleration.push_back((next_speed - speeds[i]) / 3.6);
+  }
+  return cycle;
+}
+
+const std::vector<drive_cycle> &get_standard_drive_cycles()
+{
+  static const std::vector<drive_cycle> cycles = []
+  {
+    std::vector<double> ece_15;
+    append_phases(ece_15, ECE_15, sizeof(ECE_15) / sizeof(ECE_15[0]));
+    std::vector<double> eudc;
+    append_phases(eudc, EUDC, sizeof(EUDC) / sizeof(EUDC[0]));
+    std::vector<double> nedc;
+    for (int i = 0; i < 4; i++)
+    {
+      nedc.insert(nedc.end(), ece_15.begin(), ece_15.end());
+    }
+    nedc.insert(nedc.end(), eudc.begin(), eudc.end());
+
+    std::vector<drive_cycle> standard_cycles;
+    standard_cycles.push_back(create_drive_cycle("ECE_15", ece_15));
+    standard_cycles.push_back(create_drive_cycle("EUDC", eudc));
+    standard_cycles.push_back(create_drive_cycle("NEDC", nedc));
+    return standard_cycles;
+  }();
+  return cycles;
+}
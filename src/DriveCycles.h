@@ -0,0 +1,36 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    DriveCycles.h
+/// @author  agent
+/// @date    2026/10/17
+///
+/// Standard drive cycles at 1 Hz for the accuracy reports.
+//
+/****************************************************************************/
+
+#ifndef __DRIVECYCLES_H
+#define __DRIVECYCLES_H
+
+#include <string>
+#include <vector>
+
+struct drive_cycle
+{
+  std::string name;
+
+  // one entry per second, acceleration[i] leads from velocity[i] to velocity[i + 1]
+  std::vector<double> velocity;     // m/s
+  std::vector<double> acceleration; // m/s2
+};
+
+// urban part ECE_15, extra urban part EUDC and the whole NEDC (4 x ECE_15 + EUDC), built once
+const std::vector<drive_cycle> &get_standard_drive_cycles();
+
+#endif /* __DRIVECYCLES_H */
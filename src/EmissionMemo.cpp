@@ -0,0 +1,128 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    EmissionMemo.cpp
+/// @author  agent
+/// @date    2026/10/17
+///
+//
+/****************************************************************************/
+
+#include <cmath>
+#include <cstring>
+
+#include "EmissionMemo.h"
+
+size_t memo_key_hash::operator()(const memo_key &key) const
+{
+  // 64 bit mix of the three cells
+  uint64_t hash = (uint64_t)key.velocity * 0x9E3779B97F4A7C15ull;
+  hash ^= (uint64_t)key.acceleration + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+  hash ^= (uint64_t)key.slope + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+  return (size_t)(hash ^ (hash >> 32));
+}
+
+emission_memo::emission_memo(double p_velocity_step, double p_acceleration_step, double p_slope_step, size_t p_max_size)
+{
+  velocity_step = p_velocity_step;
+  acceleration_step = p_acceleration_step;
+  slope_step = p_slope_step;
+  max_size = p_max_size;
+  hit_count = 0;
+  miss_count = 0;
+  clear_count = 0;
+}
+
+int64_t emission_memo::quantize_value(double &value, double step)
+{
+  double cell = step > 0 ? std::floor(value / step + 0.5) : 0;
+  if (step <= 0 || !(std::fabs(cell) < 4503599627370496.0))
+  {
+    // no quantization, or no exact cell index (2^52) for the value
+    int64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+  value = cell * step;
+  return (int64_t)cell;
+}
+
+memo_key emission_memo::quantize(double &velocity, double &acceleration, double &slope) const
+{
+  memo_key key;
+  if (!(velocity > 0))
+  {
+    // standing vehicles are calculated without acceleration, all of them share one cell (key of 0
+    // in both modes)
+    velocity = 0;
+    acceleration = 0;
+    key.velocity = 0;
+  }
+  else
+  {
+    key.velocity = quantize_value(velocity, velocity_step);
+    if (key.velocity == 0)
+    {
+      // slower than half a step, kept moving in the first cell instead of the standing one
+      velocity = velocity_step;
+      key.velocity = 1;
+    }
+  }
+  key.acceleration = quantize_value(acceleration, acceleration_step);
+  key.slope = quantize_value(slope, slope_step);
+  return key;
+}
+
+const emission *emission_memo::find(const memo_key &key)
+{
+  std::unordered_map<memo_key, emission, memo_key_hash>::const_iterator element = entries.find(key);
+  if (element == entries.end())
+  {
+    miss_count++;
+    return NULL;
+  }
+  hit_count++;
+  return &element->second;
+}
+
+void emission_memo::insert(const memo_key &key, const emission &emis)
+{
+  if (entries.size() >= max_size && entries.find(key) == entries.end())
+  {
+    // bounded memory, the states of the current traffic fill it again
+    entries.clear();
+    clear_count++;
+  }
+  entries.insert(std::make_pair(key, emis));
+}
+
+void emission_memo::invalidate()
+{
+  entries.clear();
+}
+
+size_t emission_memo::size() const
+{
+  return entries.size();
+}
+
+unsigned long long emission_memo::get_hit_count() const
+{
+  return hit_count;
+}
+
+unsigned long long emission_memo::get_miss_count() const
+{
+  return miss_count;
+}
+
+unsigned long long emission_memo::get_clear_count() const
+{
+  return clear_count;
+}
@@ -0,0 +1,89 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    EmissionMemo.h
+/// @author  agent
+/// @date    2026/10/17
+///
+/// Emission results of one cep per quantized vehicle state.
+//
+/****************************************************************************/
+
+#ifndef __EMISSIONMEMO_H
+#define __EMISSIONMEMO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+#include "VehicleStore.h"
+
+// cell of a vehicle state, exact bit patterns for dimensions without quantization
+struct memo_key
+{
+  int64_t velocity;
+  int64_t acceleration;
+  int64_t slope;
+
+  memo_key() : velocity(0), acceleration(0), slope(0) {}
+
+  bool operator==(const memo_key &other) const
+  {
+    return velocity == other.velocity && acceleration == other.acceleration && slope == other.slope;
+  }
+};
+
+struct memo_key_hash
+{
+  size_t operator()(const memo_key &key) const;
+};
+
+// results of the vehicles of one handler and cep, used by one thread at a time
+class emission_memo
+{
+
+private:
+  // step per dimension, 0 keys on the exact value
+  double velocity_step;
+  double acceleration_step;
+  double slope_step;
+
+  // the memo is cleared when it is full
+  size_t max_size;
+  std::unordered_map<memo_key, emission, memo_key_hash> entries;
+
+  // statistics since creation
+  unsigned long long hit_count;
+  unsigned long long miss_count;
+  unsigned long long clear_count;
+
+  static int64_t quantize_value(double &value, double step);
+
+public:
+  emission_memo(double p_velocity_step, double p_acceleration_step, double p_slope_step, size_t p_max_size);
+
+  // cell of the state, the state is replaced by the center of the cell, so the result of a cell
+  // doesn't depend on the vehicle that computed it first
+  memo_key quantize(double &velocity, double &acceleration, double &slope) const;
+
+  // result of the cell, NULL if it isn't known yet
+  const emission *find(const memo_key &key);
+
+  void insert(const memo_key &key, const emission &emis);
+
+  // drops all states, their results are calculated with other pollutants
+  void invalidate();
+
+  size_t size() const;
+  unsigned long long get_hit_count() const;
+  unsigned long long get_miss_count() const;
+  unsigned long long get_clear_count() const;
+};
+
+#endif /* __EMISSIONMEMO_H */
@@ -17,7 +17,8 @@
 /****************************************************************************/
 
 #include "EmissionModel.h"
-#include "PHEMlightHandler.h"
+#include "EmissionModelContext.h"
+#include "Tracer.h"
 
 #define DEBUG_EMISSION_MODEL 0
 
@@ -30,23 +31,12 @@ std::ofstream debug_emission_model("emissionmodel.txt");
 
 #endif
 
-#define PROFILE_EMISSION_MODEL 0
-
-#if PROFILE_EMISSION_MODEL > 0
-
-#include <iostream>
-#include <fstream>
-
-#include <chrono>
-using default_time = std::chrono::nanoseconds;
-
-std::ofstream profile_em("profile_em.txt");
-
-#endif
+/*==========================================================================*/
 
-phem_light_handler phem = phem_light_handler();
+// context of the exported functions, NULL until their first call
+static emission_model_context *process_context = NULL;
 
-/*==========================================================================*/
+#if defined(_WIN32)
 
 BOOL APIENTRY DllMain(HANDLE hModule,
                       DWORD ul_reason_for_call,
@@ -57,20 +47,186 @@ BOOL APIENTRY DllMain(HANDLE hModule,
   case DLL_PROCESS_ATTACH:
   case DLL_THREAD_ATTACH:
   case DLL_THREAD_DETACH:
+    break;
   case DLL_PROCESS_DETACH:
+    // the threads hold a reference to the dll, after a FreeLibrary they have all ended. A reserved
+    // pointer means the process exits and its other threads are terminated already, maybe holding a
+    // lock the static destructors would wait for
+    if (process_context != NULL && lpReserved != NULL)
+    {
+      process_context->abandon_threads();
+    }
     break;
   }
   return TRUE;
 }
 
+#endif
+
 /*==========================================================================*/
 
-EMISSIONMODEL_API int EmissionModelSetValue(long type,
-                                            long index1,
-                                            long index2,
-                                            long long_value,
-                                            double double_value,
-                                            char *string_value)
+static_assert(EMISSION_DATA_NAPHT_GAS - EMISSION_DATA_BENZ + 1 == EMISSION_TYPE_COUNT, "emission types changed");
+
+// names of the vissim emission types for the columns of the config
+#define EMISSION_TYPE(type) {#type, type}
+
+static const struct
+{
+  const char *name;
+  long type;
+} emission_types[EMISSION_TYPE_COUNT] = {
+    EMISSION_TYPE(EMISSION_DATA_BENZ),
+    EMISSION_TYPE(EMISSION_DATA_CO),
+    EMISSION_TYPE(EMISSION_DATA_CO2),
+    EMISSION_TYPE(EMISSION_DATA_HC),
+    EMISSION_TYPE(EMISSION_DATA_FUEL),
+    EMISSION_TYPE(EMISSION_DATA_NMOG),
+    EMISSION_TYPE(EMISSION_DATA_NMHC),
+    EMISSION_TYPE(EMISSION_DATA_NOX),
+    EMISSION_TYPE(EMISSION_DATA_PART),
+    EMISSION_TYPE(EMISSION_DATA_SOOT),
+    EMISSION_TYPE(EMISSION_DATA_SO2),
+    EMISSION_TYPE(EMISSION_DATA_EVAP),
+    EMISSION_TYPE(EMISSION_DATA_224TMP),
+    EMISSION_TYPE(EMISSION_DATA_CH4),
+    EMISSION_TYPE(EMISSION_DATA_ELEM_C),
+    EMISSION_TYPE(EMISSION_DATA_ETHYLBENZ),
+    EMISSION_TYPE(EMISSION_DATA_MTBE),
+    EMISSION_TYPE(EMISSION_DATA_N2O),
+    EMISSION_TYPE(EMISSION_DATA_NH3),
+    EMISSION_TYPE(EMISSION_DATA_NO3),
+    EMISSION_TYPE(EMISSION_DATA_PM10BRA),
+    EMISSION_TYPE(EMISSION_DATA_PM10TIR),
+    EMISSION_TYPE(EMISSION_DATA_PM10TOT),
+    EMISSION_TYPE(EMISSION_DATA_PM25BRA),
+    EMISSION_TYPE(EMISSION_DATA_PM25TIR),
+    EMISSION_TYPE(EMISSION_DATA_PM25TOT),
+    EMISSION_TYPE(EMISSION_DATA_SULF_PART),
+    EMISSION_TYPE(EMISSION_DATA_TOG),
+    EMISSION_TYPE(EMISSION_DATA_TOLUENE),
+    EMISSION_TYPE(EMISSION_DATA_VOC),
+    EMISSION_TYPE(EMISSION_DATA_XYLENE),
+    EMISSION_TYPE(EMISSION_DATA_13BUT),
+    EMISSION_TYPE(EMISSION_DATA_FORMALD),
+    EMISSION_TYPE(EMISSION_DATA_ACETALD),
+    EMISSION_TYPE(EMISSION_DATA_HEXANE),
+    EMISSION_TYPE(EMISSION_DATA_NAPHT_GAS),
+};
+
+#undef EMISSION_TYPE
+
+static long find_emission_type(const std::string &name)
+{
+  for (int i = 0; i < EMISSION_TYPE_COUNT; i++)
+  {
+    if (name.compare(emission_types[i].name) == 0)
+    {
+      return emission_types[i].type;
+    }
+  }
+  return -1;
+}
+
+static void set_emission_field(emission_field &entry, const double emission::*field, unsigned int pollutants)
+{
+  entry.field = field;
+  entry.pollutants = pollutants;
+}
+
+void emission_model_context::init_emission_fields()
+{
+  // values calculated for every cep, CO2 is derived from the fuel consumption, CO and HC
+  set_emission_field(emission_fields[EMISSION_DATA_CO - EMISSION_DATA_BENZ], &emission::co, 1u << POLLUTANT_CO);
+  set_emission_field(emission_fields[EMISSION_DATA_CO2 - EMISSION_DATA_BENZ], &emission::co2, (1u << POLLUTANT_FC) | (1u << POLLUTANT_CO) | (1u << POLLUTANT_HC));
+  set_emission_field(emission_fields[EMISSION_DATA_HC - EMISSION_DATA_BENZ], &emission::hc, 1u << POLLUTANT_HC);
+  set_emission_field(emission_fields[EMISSION_DATA_FUEL - EMISSION_DATA_BENZ], &emission::fuel_consumption, 1u << POLLUTANT_FC);
+  set_emission_field(emission_fields[EMISSION_DATA_NOX - EMISSION_DATA_BENZ], &emission::nox, 1u << POLLUTANT_NOX);
+  set_emission_field(emission_fields[EMISSION_DATA_PART - EMISSION_DATA_BENZ], &emission::pm, 1u << POLLUTANT_PM);
+  set_emission_field(emission_fields[EMISSION_DATA_PM10TOT - EMISSION_DATA_BENZ], &emission::pm, 1u << POLLUTANT_PM);
+  set_emission_field(emission_fields[EMISSION_DATA_PM25TOT - EMISSION_DATA_BENZ], &emission::pm, 1u << POLLUTANT_PM);
+
+  // configured cep columns, replacing the value of their type
+  const std::vector<emission_column> &columns = handler.get_emission_columns();
+  for (size_t i = 0; i < columns.size(); i++)
+  {
+    long type = find_emission_type(columns[i].type);
+    if (type < 0)
+    {
+#if DEBUG_EMISSION_MODEL >= 1
+      debug_emission_model << "<ERROR> Unknown emission type " << columns[i].type << " for column " << columns[i].pollutant << "." << std::endl;
+#endif
+      continue;
+    }
+    emission_field &entry = emission_fields[type - EMISSION_DATA_BENZ];
+    set_emission_field(entry, NULL, 1u << (POLLUTANT_COUNT + i));
+    entry.column = (int)i;
+  }
+
+  // LAZY calculates the pollutants of the types read so far, or those of LAZY_TYPES from the start
+  requested_pollutants = ALL_POLLUTANTS;
+  if (handler.get_lazy_calculation())
+  {
+    const std::vector<std::string> &types = handler.get_lazy_types();
+    requested_pollutants = 0;
+    for (size_t i = 0; i < types.size(); i++)
+    {
+      long type = find_emission_type(types[i]);
+      if (type < 0)
+      {
+#if DEBUG_EMISSION_MODEL >= 1
+        debug_emission_model << "<ERROR> Unknown emission type " << types[i] << " in LAZY_TYPES." << std::endl;
+#endif
+        continue;
+      }
+      requested_pollutants |= emission_fields[type - EMISSION_DATA_BENZ].pollutants;
+    }
+    if (types.empty())
+    {
+      // types are read without a check of their pollutants once they are requested
+      for (int i = 0; i < EMISSION_TYPE_COUNT; i++)
+      {
+        lazy_fields[i] = emission_fields[i];
+        emission_fields[i] = emission_field();
+        emission_fields[i].column = LAZY_COLUMN;
+      }
+    }
+    handler.request_pollutants(requested_pollutants);
+  }
+}
+
+void emission_model_context::request_emission_field(unsigned long index)
+{
+  // rows calculated without the pollutants of the type are calculated again at their next get
+  emission_fields[index] = lazy_fields[index];
+  lazy_fields[index] = emission_field();
+  requested_pollutants |= emission_fields[index].pollutants;
+  handler.request_pollutants(requested_pollutants);
+  veh_emission_resolved = false;
+}
+
+/*==========================================================================*/
+
+emission_model_context::emission_model_context() : veh_emission(NULL), veh_emission_resolved(false)
+{
+  // ceps are loaded in the background while vissim sets up the simulation
+  handler.load_config();
+  init_emission_fields();
+}
+
+emission_model_context::emission_model_context(const std::string &config_path) : handler(config_path), veh_emission(NULL), veh_emission_resolved(false)
+{
+  handler.load_config();
+  init_emission_fields();
+}
+
+/*==========================================================================*/
+
+int emission_model_context::set_value(long type,
+                                      long index1,
+                                      long index2,
+                                      long long_value,
+                                      double double_value,
+                                      char *string_value)
 {
   /* Sets the value of a data object of type <type>, selected by <index1> */
   /* and possibly <index2>, to <long_value>, <double_value> or            */
@@ -90,7 +246,7 @@ EMISSIONMODEL_API int EmissionModelSetValue(long type,
     debug_emission_model << ";\t\t // EMISSION_DATA_TIMESTEP = " << double_value << std::endl;
     break;
   case EMISSION_DATA_TIME:
-    debug_emission_model << ";\t\t // EMISSION_DATA_TIME unused parameter" << std::endl;
+    debug_emission_model << ";\t\t // EMISSION_DATA_TIME = " << double_value << std::endl;
     break;
   case EMISSION_DATA_TIME_OF_DAY:
     debug_emission_model << ";\t\t // EMISSION_DATA_TIME_OF_DAY unused parameter" << std::endl;
@@ -126,23 +282,17 @@ EMISSIONMODEL_API int EmissionModelSetValue(long type,
   }
 #endif
 
-#if PROFILE_EMISSION_MODEL > 0
-  auto start = std::chrono::high_resolution_clock::now();
-#endif
-
-  vehicle *veh;
+  // vehicle values are only staged, EMISSION_COMMAND_CALCULATE_VEHICLE writes them to the vehicle
   switch (type)
   {
   case EMISSION_DATA_TIMESTEP:
-    buffer_timestep = double_value;
-    veh = phem.get_vehicle(buffer_veh_id);
-    if (veh != NULL)
-    {
-      veh->timestep = buffer_timestep;
-    }
+    // general value, sent once before the vehicles and not reset by their ids
+    buffer.timestep = double_value;
     break;
   case EMISSION_DATA_TIME:
-    // unused parameter
+    // start of a time step, deferred calculations of the last one are completed
+    handler.set_simulation_time(double_value);
+    veh_emission_resolved = false;
     break;
   case EMISSION_DATA_TIME_OF_DAY:
     // unused parameter
@@ -151,42 +301,28 @@ EMISSIONMODEL_API int EmissionModelSetValue(long type,
     // unused parameter
     break;
   case EMISSION_DATA_VEH_ID:
-    buffer_veh_id = long_value;
+    buffer.veh_id = long_value;
+    buffer.veh_input.fields = 0;
+    veh_emission_resolved = false;
     break;
   case EMISSION_DATA_VEH_TYPE:
-    buffer_veh_type = long_value;
+    buffer.veh_type = long_value;
     break;
   case EMISSION_DATA_VEH_VELOCITY:
-    buffer_veh_velocity = double_value;
-    veh = phem.get_vehicle(buffer_veh_id);
-    if (veh != NULL)
-    {
-      veh->velocity = buffer_veh_velocity;
-    }
+    buffer.veh_input.velocity = double_value;
+    buffer.veh_input.fields |= vehicle_input::FIELD_VELOCITY;
     break;
   case EMISSION_DATA_VEH_ACCELERATION:
-    buffer_veh_acceleration = double_value;
-    veh = phem.get_vehicle(buffer_veh_id);
-    if (veh != NULL)
-    {
-      veh->acceleration = buffer_veh_acceleration;
-    }
+    buffer.veh_input.acceleration = double_value;
+    buffer.veh_input.fields |= vehicle_input::FIELD_ACCELERATION;
     break;
   case EMISSION_DATA_VEH_WEIGHT:
-    buffer_veh_weight = double_value;
-    veh = phem.get_vehicle(buffer_veh_id);
-    if (veh != NULL)
-    {
-      veh->weight = buffer_veh_weight;
-    }
+    buffer.veh_input.weight = double_value;
+    buffer.veh_input.fields |= vehicle_input::FIELD_WEIGHT;
     break;
   case EMISSION_DATA_SLOPE:
-    buffer_slope = double_value;
-    veh = phem.get_vehicle(buffer_veh_id);
-    if (veh != NULL)
-    {
-      veh->slope = buffer_slope;
-    }
+    buffer.veh_input.slope = double_value;
+    buffer.veh_input.fields |= vehicle_input::FIELD_SLOPE;
     break;
   case EMISSION_DATA_LINKTYPE:
     // unused parameter
@@ -194,21 +330,17 @@ EMISSIONMODEL_API int EmissionModelSetValue(long type,
   default:
     return 0;
   }
-#if PROFILE_EMISSION_MODEL > 0
-  auto end = std::chrono::high_resolution_clock::now();
-  profile_em << "EM_SET;" << std::chrono::duration_cast<default_time>(end - start).count() << std::endl;
-#endif
   return 1;
 }
 
 /*--------------------------------------------------------------------------*/
 
-EMISSIONMODEL_API int EmissionModelGetValue(long type,
-                                            long index1,
-                                            long index2,
-                                            long *long_value,
-                                            double *double_value,
-                                            char **string_value)
+int emission_model_context::get_value(long type,
+                                      long index1,
+                                      long index2,
+                                      long *long_value,
+                                      double *double_value,
+                                      char **string_value)
 {
   /* Gets the value of a data object of type <type>, selected by <index1> */
   /* and possibly <index2>, and writes that value to <*double_value>,     */
@@ -266,125 +398,29 @@ EMISSIONMODEL_API int EmissionModelGetValue(long type,
   }
 #endif
 
-#if PROFILE_EMISSION_MODEL > 0
-  auto start = std::chrono::high_resolution_clock::now();
-#endif
+  unsigned long index = (unsigned long)(type - EMISSION_DATA_BENZ);
+  const emission_field *entry = index < (unsigned long)EMISSION_TYPE_COUNT ? &emission_fields[index] : NULL;
 
-  emission *emi = NULL;
-  int i = 1;
-  switch (type)
+  // first get of a type with LAZY, the vehicles are calculated again with its pollutants
+  if (entry != NULL && entry->column == LAZY_COLUMN)
   {
-  case EMISSION_DATA_CO:
-    *double_value = 0.0;
-    emi = phem.get_vehicle_emission(buffer_veh_id);
-    if (emi != NULL)
-    {
-      *double_value = emi->co;
-    }
-#if DEBUG_EMISSION_MODEL >= 1
-    else
-    {
-      debug_emission_model << std::endl
-                           << "<ERROR> phem.get_vehicle_emission( id ) found no emission!" << type << "." << std::endl;
-    }
-#endif
-    break;
-  case EMISSION_DATA_CO2:
-    *double_value = 0.0;
-    emi = phem.get_vehicle_emission(buffer_veh_id);
-    if (emi != NULL)
-    {
-      *double_value = emi->co2;
-    }
-#if DEBUG_EMISSION_MODEL >= 1
-    else
-    {
-      debug_emission_model << std::endl
-                           << "<ERROR> phem.get_vehicle_emission( id ) found no emission!" << type << "." << std::endl;
-    }
-#endif
-    break;
-  case EMISSION_DATA_HC:
-    *double_value = 0.0;
-    emi = phem.get_vehicle_emission(buffer_veh_id);
-    if (emi != NULL)
-    {
-      *double_value = emi->hc;
-    }
-#if DEBUG_EMISSION_MODEL >= 1
-    else
-    {
-      debug_emission_model << std::endl
-                           << "<ERROR> phem.get_vehicle_emission( id ) found no emission!" << type << "." << std::endl;
-    }
-#endif
-    break;
-  case EMISSION_DATA_FUEL:
-    *double_value = 0.0;
-    emi = phem.get_vehicle_emission(buffer_veh_id);
-    if (emi != NULL)
-    {
-      *double_value = emi->fuel_consumption;
-    }
-#if DEBUG_EMISSION_MODEL >= 1
-    else
-    {
-      debug_emission_model << std::endl
-                           << "<ERROR> phem.get_vehicle_emission( id ) found no emission!" << type << "." << std::endl;
-    }
-#endif
-    break;
-  case EMISSION_DATA_NOX:
-    *double_value = 0.0;
-    emi = phem.get_vehicle_emission(buffer_veh_id);
-    if (emi != NULL)
-    {
-      *double_value = emi->nox;
-    }
-#if DEBUG_EMISSION_MODEL >= 1
-    else
-    {
-      debug_emission_model << std::endl
-                           << "<ERROR> phem.get_vehicle_emission( id ) found no emission!" << type << "." << std::endl;
-    }
-#endif
-    break;
-  case EMISSION_DATA_PART:
-    *double_value = 0.0;
-    emi = phem.get_vehicle_emission(buffer_veh_id);
-    if (emi != NULL)
-    {
-      *double_value = emi->pm;
-    }
-#if DEBUG_EMISSION_MODEL >= 1
-    else
-    {
-      debug_emission_model << std::endl
-                           << "<ERROR> phem.get_vehicle_emission( id ) found no emission!" << type << "." << std::endl;
-    }
-#endif
-    break;
-  case EMISSION_DATA_PM10TOT:
-    *double_value = 0.0;
-    emi = phem.get_vehicle_emission(buffer_veh_id);
-    if (emi != NULL)
-    {
-      *double_value = emi->pm;
-    }
-#if DEBUG_EMISSION_MODEL >= 1
-    else
-    {
-      debug_emission_model << std::endl
-                           << "<ERROR> phem.get_vehicle_emission( id ) found no emission!" << type << "." << std::endl;
-    }
-#endif
-    break;
-  case EMISSION_DATA_PM25TOT:
-    *double_value = 0.0;
-    emi = phem.get_vehicle_emission(buffer_veh_id);
-    if (emi != NULL)
+    request_emission_field(index);
+  }
+
+  // the row of the vehicle is looked up by the first get after its id, set or calculate command,
+  // the following types of the vehicle read it directly
+  if (!veh_emission_resolved)
+  {
+    veh_emission = handler.get_vehicle_emission(buffer.veh_id);
+    veh_emission_resolved = true;
+  }
+
+  *double_value = 0.0;
+  if (entry != NULL && (entry->field != NULL || entry->column >= 0))
+  {
+    if (veh_emission != NULL)
     {
-      *double_value = emi->pm;
+      *double_value = entry->field != NULL ? veh_emission->*(entry->field) : veh_emission->columns[entry->column];
     }
 #if DEBUG_EMISSION_MODEL >= 1
     else
@@ -393,21 +429,13 @@ EMISSIONMODEL_API int EmissionModelGetValue(long type,
                            << "<ERROR> phem.get_vehicle_emission( id ) found no emission!" << type << "." << std::endl;
     }
 #endif
-    break;
-  default:
-    *double_value = 0;
-    break;
   }
-#if PROFILE_EMISSION_MODEL > 0
-  auto end = std::chrono::high_resolution_clock::now();
-  profile_em << "EM_GET;" << std::chrono::duration_cast<default_time>(end - start).count() << std::endl;
-#endif
   return 1;
 }
 
 /*==========================================================================*/
 
-EMISSIONMODEL_API int EmissionModelExecuteCommand(long number)
+int emission_model_context::execute_command(long number)
 {
   /* Executes the command <number> if that is available in the emission */
   /* module. Return value is 1 on success, otherwise 0.                 */
@@ -419,10 +447,10 @@ EMISSIONMODEL_API int EmissionModelExecuteCommand(long number)
     debug_emission_model << "<COMMAND> \t INIT" << std::endl;
     break;
   case EMISSION_COMMAND_CREATE_VEHICLE:
-    debug_emission_model << "<COMMAND> \t Create Vehicle with ID " << buffer_veh_id << " and Type " << buffer_veh_type << "." << std::endl;
+    debug_emission_model << "<COMMAND> \t Create Vehicle with ID " << buffer.veh_id << " and Type " << buffer.veh_type << "." << std::endl;
     break;
   case EMISSION_COMMAND_KILL_VEHICLE:
-    debug_emission_model << "<COMMAND> \t Kill Vehicle with ID " << buffer_veh_id << "." << std::endl;
+    debug_emission_model << "<COMMAND> \t Kill Vehicle with ID " << buffer.veh_id << "." << std::endl;
     break;
   case EMISSION_COMMAND_CALCULATE_VEHICLE:
     debug_emission_model << "<COMMAND> \t Calculate Emission" << std::endl;
@@ -432,44 +460,49 @@ EMISSIONMODEL_API int EmissionModelExecuteCommand(long number)
   }
 #endif
 
-#if PROFILE_EMISSION_MODEL > 0
-  auto start = std::chrono::high_resolution_clock::now();
-#endif
+  // commands may move or replace the emission rows
+  veh_emission_resolved = false;
 
   bool all_right = false;
   switch (number)
   {
   case EMISSION_COMMAND_INIT:
-    // seems like never called
+    // seems like never called, the config is already read when the context is created
+    handler.load_config();
     all_right = true;
     break;
   case EMISSION_COMMAND_CREATE_VEHICLE:
     // create vehicle with given id and type from buffer
-    all_right = phem.create_vehicle(buffer_veh_id, buffer_veh_type);
+    all_right = handler.create_vehicle(buffer.veh_id, buffer.veh_type);
 #if DEBUG_EMISSION_MODEL >= 2
     if (!all_right)
     {
-      debug_emission_model << "<ERROR> \t\t Couldn't create vehicle with id " << buffer_veh_id << " and type " << buffer_veh_type << "." << std::endl;
+      debug_emission_model << "<ERROR> \t\t Couldn't create vehicle with id " << buffer.veh_id << " and type " << buffer.veh_type << "." << std::endl;
     }
 #endif
     break;
   case EMISSION_COMMAND_KILL_VEHICLE:
     // remove vehicle with given id
-    all_right = phem.destroy_vehicle(buffer_veh_id);
+    all_right = handler.destroy_vehicle(buffer.veh_id);
 #if DEBUG_EMISSION_MODEL >= 2
     if (!all_right)
     {
-      debug_emission_model << "<ERROR> \t\t Couldn't destroy vehicle with id " << buffer_veh_id << "." << std::endl;
+      debug_emission_model << "<ERROR> \t\t Couldn't destroy vehicle with id " << buffer.veh_id << "." << std::endl;
     }
 #endif
     break;
   case EMISSION_COMMAND_CALCULATE_VEHICLE:
     /* ### call emission calculation here */
-    all_right = phem.calculate_vehicle_emission(buffer_veh_id);
+    if (buffer.timestep >= 0)
+    {
+      buffer.veh_input.timestep = buffer.timestep;
+      buffer.veh_input.fields |= vehicle_input::FIELD_TIMESTEP;
+    }
+    all_right = handler.calculate_vehicle_emission(buffer.veh_id, buffer.veh_input);
 #if DEBUG_EMISSION_MODEL >= 2
     if (!all_right)
     {
-      debug_emission_model << "<ERROR> \t\t Couldn't calculate vehicle emission with id " << buffer_veh_id << "." << std::endl;
+      debug_emission_model << "<ERROR> \t\t Couldn't calculate vehicle emission with id " << buffer.veh_id << "." << std::endl;
     }
 #endif
     break;
@@ -480,11 +513,6 @@ EMISSIONMODEL_API int EmissionModelExecuteCommand(long number)
     break;
   }
 
-#if PROFILE_EMISSION_MODEL > 0
-  auto end = std::chrono::high_resolution_clock::now();
-  profile_em << "EM_EXEC;" << std::chrono::duration_cast<default_time>(end - start).count() << std::endl;
-#endif
-
   if (all_right)
   {
     return 1;
@@ -494,3 +522,60 @@ EMISSIONMODEL_API int EmissionModelExecuteCommand(long number)
     return 0;
   }
 }
+
+bool emission_model_context::dump_trace()
+{
+  return handler.dump_trace();
+}
+
+void emission_model_context::abandon_threads()
+{
+  handler.abandon_threads();
+}
+
+/*==========================================================================*/
+
+static emission_model_context &default_context()
+{
+  // context of the simulation loading the dll, created on first use
+  static emission_model_context context;
+  process_context = &context;
+  return context;
+}
+
+EMISSIONMODEL_API int EmissionModelSetValue(long type,
+                                            long index1,
+                                            long index2,
+                                            long long_value,
+                                            double double_value,
+                                            char *string_value)
+{
+  emission_model_context &context = default_context();
+  trace_point trace(TRACE_EM_SET);
+  int result = context.set_value(type, index1, index2, long_value, double_value, string_value);
+  trace.stop();
+  return result;
+}
+
+EMISSIONMODEL_API int EmissionModelGetValue(long type,
+                                            long index1,
+                                            long index2,
+                                            long *long_value,
+                                            double *double_value,
+                                            char **string_value)
+{
+  emission_model_context &context = default_context();
+  trace_point trace(TRACE_EM_GET);
+  int result = context.get_value(type, index1, index2, long_value, double_value, string_value);
+  trace.stop();
+  return result;
+}
+
+EMISSIONMODEL_API int EmissionModelExecuteCommand(long number)
+{
+  emission_model_context &context = default_context();
+  trace_point trace(TRACE_EM_EXEC);
+  int result = context.execute_command(number);
+  trace.stop();
+  return result;
+}
@@ -19,36 +19,20 @@
 #ifndef __EMISSIONMODEL_H
 #define __EMISSIONMODEL_H
 
-#ifndef _CONSOLE
+#if defined(_WIN32) && !defined(_CONSOLE)
 #include <windows.h>
 #endif
 
 /*==========================================================================*/
 
-/* Global defines for use in cpp file. For example buffering */
-/* parameters or handling vehicle objects in map.            */
-
-/* general data buffer: */
-double buffer_timestep = -1;
-
-/* current vehicle data buffer: */
-long buffer_veh_id = -1;
-long buffer_veh_type = -1;
-double buffer_veh_velocity = -1;
-double buffer_veh_acceleration = -1;
-double buffer_veh_weight = -1;
-
-/* link buffer: */
-double buffer_slope = -1;
-
-/*==========================================================================*/
-
 /* In the creation of EmissionModel.DLL all files must be compiled */
 /* with the preprocessor definition EMISSIONMODEL_EXPORTS.         */
 /* Programs that use EmissionModel.DLL must not be compiled        */
 /* with that preprocessor definition.                              */
 
-#ifdef EMISSIONMODEL_EXPORTS
+#if !defined(_WIN32)
+#define EMISSIONMODEL_API extern "C"
+#elif defined(EMISSIONMODEL_EXPORTS)
 #define EMISSIONMODEL_API extern "C" __declspec(dllexport)
 #else
 #define EMISSIONMODEL_API extern "C" __declspec(dllimport)
@@ -0,0 +1,99 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    EmissionModelContext.h
+/// @author  agent
+/// @date    2026/10/17
+///
+/// State of one simulation behind the EmissionModel interface.
+//
+/****************************************************************************/
+
+#ifndef __EMISSIONMODELCONTEXT_H
+#define __EMISSIONMODELCONTEXT_H
+
+#include <string>
+
+#include "PHEMlightHandler.h"
+
+// values set by vissim, used by the following set, get and execute calls
+struct emission_model_buffer
+{
+  /* general data buffer: */
+  double timestep;
+
+  /* current vehicle data buffer: */
+  long veh_id;
+  long veh_type;
+
+  /* vehicle and link values of the current vehicle, staged until its calculate command: */
+  vehicle_input veh_input;
+
+  emission_model_buffer() : timestep(-1), veh_id(-1), veh_type(-1) {}
+};
+
+// vissim emission types EMISSION_DATA_BENZ to EMISSION_DATA_NAPHT_GAS
+static const int EMISSION_TYPE_COUNT = 36;
+
+// column of the types not read yet with LAZY
+static const int LAZY_COLUMN = -2;
+
+// value of a vissim emission type in the emission row
+struct emission_field
+{
+  const double emission::*field; // named value of the row, or NULL
+  int column;                    // emission::columns index if field is NULL, -1 for types without value,
+                                 // LAZY_COLUMN until the type is requested
+  unsigned int pollutants;       // pollutants the value is calculated from, see ALL_POLLUTANTS
+
+  emission_field() : field(NULL), column(-1), pollutants(0) {}
+};
+
+// one simulation with its own staging buffer and handler. The exported EmissionModel functions
+// use a context of the process, other callers create one context per simulation. A context is
+// used by one caller at a time, independent contexts may be used concurrently
+class emission_model_context
+{
+
+private:
+  emission_model_buffer buffer;
+  phem_light_handler handler;
+
+  // emission row of the buffered vehicle, shared by its get calls until the next id or command
+  const emission *veh_emission;
+  bool veh_emission_resolved;
+
+  // value per vissim type, indexed by type - EMISSION_DATA_BENZ, with the columns of the config
+  emission_field emission_fields[EMISSION_TYPE_COUNT];
+
+  // LAZY without LAZY_TYPES, values of the types not read yet, moved to emission_fields at their
+  // first get with a request of their pollutants. Their emission_fields have LAZY_COLUMN
+  emission_field lazy_fields[EMISSION_TYPE_COUNT];
+  unsigned int requested_pollutants;
+
+  void init_emission_fields();
+  void request_emission_field(unsigned long index);
+
+public:
+  emission_model_context();
+  explicit emission_model_context(const std::string &config_path);
+
+  // same semantics as EmissionModelSetValue, EmissionModelGetValue and EmissionModelExecuteCommand
+  int set_value(long type, long index1, long index2, long long_value, double double_value, char *string_value);
+  int get_value(long type, long index1, long index2, long *long_value, double *double_value, char **string_value);
+  int execute_command(long number);
+
+  // writes the trace recorded so far with TRACE = ON, otherwise at the end of the simulation
+  bool dump_trace();
+
+  // see phem_light_handler::abandon_threads
+  void abandon_threads();
+};
+
+#endif /* __EMISSIONMODELCONTEXT_H */
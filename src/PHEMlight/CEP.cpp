@@ -29,7 +29,10 @@
 
 namespace PHEMlightdll {
 
-    CEP::CEP(bool heavyVehicle, double vehicleMass, double vehicleLoading, double vehicleMassRot, double crossArea, double cWValue, double f0, double f1, double f2, double f3, double f4, double axleRatio, std::vector<double>& transmissionGearRatios, double auxPower, double ratedPower, double engineIdlingSpeed, double engineRatedSpeed, double effictiveWheelDiameter, double pNormV0, double pNormP0, double pNormV1, double pNormP1, const std::string& vehicelFuelType, std::vector<std::vector<double> >& matrixFC, std::vector<std::string>& headerLinePollutants, std::vector<std::vector<double> >& matrixPollutants, std::vector<std::vector<double> >& matrixSpeedRotational, std::vector<std::vector<double> >& normedDragTable, double idlingFC, std::vector<double>& idlingPollutants) {
+    const int CEP::PollutantIndexFC;
+    const int CEP::PollutantIndexUnknown;
+
+    CEP::CEP(bool heavyVehicle, double vehicleMass, double vehicleLoading, double vehicleMassRot, double crossArea, double cWValue, double f0, double f1, double f2, double f3, double f4, double axleRatio, std::vector<double>& transmissionGearRatios, double auxPower, double ratedPower, double engineIdlingSpeed, double engineRatedSpeed, double effictiveWheelDiameter, double pNormV0, double pNormP0, double pNormV1, double pNormP1, const std::string& vehicelFuelType, std::vector<std::vector<double> >& matrixFC, std::vector<std::string>& headerLinePollutants, std::vector<std::vector<double> >& matrixPollutants, std::vector<std::vector<double> >& matrixSpeedRotational, std::vector<std::vector<double> >& normedDragTable, double idlingFC, std::vector<double>& idlingPollutants, double driveTrainEfficiency) {
         (void)transmissionGearRatios; // just to make the compiler happy about the unused parameter
         InitializeInstanceFields();
         _resistanceF0 = f0;
@@ -50,6 +53,10 @@ namespace PHEMlightdll {
         _fuelType = vehicelFuelType;
         _axleRatio = axleRatio;
         _auxPower = auxPower;
+        _driveTrainEfficiency = driveTrainEfficiency;
+
+        InitializeFuelType();
+        InitializePowerCoefficients();
 
         _pNormV0 = pNormV0 / 3.6;
         _pNormP0 = pNormP0;
@@ -153,18 +160,40 @@ namespace PHEMlightdll {
             }
         }
 
-        _cepCurvePollutants = std::map<std::string, std::vector<double> >();
-        _idlingValuesPollutants = std::map<std::string, double>();
+        _pollutantIdentifiers = std::vector<std::string>();
+        _pollutantIndices = std::map<std::string, int>();
+        _idlingValuesPollutants = std::vector<double>();
 
+        std::vector<int> pollutantColumns;
         for (int i = 0; i < (int)headerLinePollutants.size(); i++) {
-            _cepCurvePollutants.insert(std::make_pair(pollutantIdentifier[i], pollutantMeasures[i]));
+            if (_pollutantIndices.find(pollutantIdentifier[i]) != _pollutantIndices.end()) {
+                // first column wins for duplicate identifiers, as with the former map
+                continue;
+            }
+            _pollutantIndices.insert(std::make_pair(pollutantIdentifier[i], (int)_pollutantIdentifiers.size()));
+            _pollutantIdentifiers.push_back(pollutantIdentifier[i]);
             _cepNormalizedCurvePollutants.insert(std::make_pair(pollutantIdentifier[i], normalizedPollutantMeasures[i]));
-            _idlingValuesPollutants.insert(std::make_pair(pollutantIdentifier[i], idlingPollutants[i] * pollutantMultiplyer));
+            _idlingValuesPollutants.push_back(idlingPollutants[i] * pollutantMultiplyer);
+            pollutantColumns.push_back(i);
+        }
+
+        // interleave the pollutant curves row by row
+        _pollutantCount = (int)pollutantColumns.size();
+        _cepTablePollutants = std::vector<double>();
+        _cepTablePollutants.reserve(_powerPatternPollutants.size() * _pollutantCount);
+        for (int i = 0; i < (int)_powerPatternPollutants.size(); i++) {
+            for (int j = 0; j < _pollutantCount; j++) {
+                _cepTablePollutants.push_back(pollutantMeasures[pollutantColumns[j]][i]);
+            }
         }
 
         _idlingValueFC = idlingFC * _ratedPower;
     }
 
+    CEP::CEP() {
+        InitializeInstanceFields();
+    }
+
     const bool& CEP::getHeavyVehicle() const {
         return _heavyVehicle;
     }
@@ -173,6 +202,14 @@ namespace PHEMlightdll {
         return _fuelType;
     }
 
+    const bool& CEP::getIsBEV() const {
+        return _isBEV;
+    }
+
+    const bool& CEP::getFuelTypeKnown() const {
+        return _fuelTypeKnown;
+    }
+
     const CEP::NormalizingType& CEP::getNormalizingTypeX() const {
         return _normalizingType;
     }
@@ -183,6 +220,7 @@ namespace PHEMlightdll {
 
     void CEP::setRatedPower(const double& value) {
         _ratedPower = value;
+        InitializePowerCoefficients();
     }
 
     const double& CEP::getNormalizingPower() const {
@@ -193,30 +231,57 @@ namespace PHEMlightdll {
         return _drivingPower;
     }
 
+    const double& CEP::getDriveTrainEfficiency() const {
+        return _driveTrainEfficiency;
+    }
+
+    const Batch::PowerCoefficients& CEP::getPowerCoefficients() const {
+        return _powerCoefficients;
+    }
+
     void CEP::setDrivingPower(const double& value) {
         _drivingPower = value;
     }
 
-    double CEP::CalcPower(double speed, double acc, double gradient) {
+    const Batch::InstructionSet& CEP::getInstructionSet() const {
+        return _instructionSet;
+    }
+
+    void CEP::setInstructionSet(const Batch::InstructionSet& value) {
+        // never select an extension the CPU doesn't have
+        _instructionSet = value > Batch::GetSupportedInstructionSet() ? Batch::GetSupportedInstructionSet() : value;
+    }
+
+    const Batch::Precision& CEP::getPrecision() const {
+        return _precision;
+    }
+
+    void CEP::setPrecision(const Batch::Precision& value) {
+        _precision = value;
+        InitializeSingleTables();
+    }
+
+    double CEP::CalcPower(double speed, double acc, double gradient) const {
         //Declaration
-        double power = 0;
+        double power;
         double rotFactor = GetRotationalCoeffecient(speed);
-        double powerAux = (_auxPower * _ratedPower);
+        const Batch::PowerCoefficients& c = _powerCoefficients;
 
         //Calculate the power
-        power += (_massVehicle + _vehicleLoading) * Constants::GRAVITY_CONST * (_resistanceF0 + _resistanceF1 * speed + _resistanceF4 * std::pow(speed, 4)) * speed;
-        power += (_crossSectionalArea * _cWValue * Constants::AIR_DENSITY_CONST / 2) * std::pow(speed, 3);
-        power += (_massVehicle * rotFactor + _vehicleMassRot + _vehicleLoading) * acc * speed;
-        power += (_massVehicle + _vehicleLoading) * Constants::GRAVITY_CONST * gradient * 0.01 * speed;
-        power /= 1000;
-        power /= Constants::_DRIVE_TRAIN_EFFICIENCY;
-        power += powerAux;
+        // speed polynomial in Horner form, the batch kernels evaluate it in the same order
+        double polynomial = c.speed3 + (speed * speed) * c.speed5;
+        polynomial = c.speed2 + speed * polynomial;
+        double inertia = c.inertiaMass * rotFactor + c.inertiaOffset;
+        power = c.speed1 + c.gradient * gradient;
+        power = power + inertia * acc;
+        power = power + speed * polynomial;
+        power = speed * power + c.aux;
 
         //Return result
         return power;
     }
 
-    double CEP::CalcEngPower(double power) {
+    double CEP::CalcEngPower(double power) const {
         if (power < _powerPatternFC.front()) {
             return _powerPatternFC.front();
         }
@@ -227,47 +292,78 @@ namespace PHEMlightdll {
         return power;
     }
 
-    double CEP::GetEmission(const std::string& pollutant, double power, double speed, Helpers* VehicleClass) {
+    int CEP::GetPollutantIndex(const std::string& pollutant) const {
+        if (pollutant == "FC") {
+            return PollutantIndexFC;
+        }
+
+        std::map<std::string, int>::const_iterator index = _pollutantIndices.find(pollutant);
+        if (index == _pollutantIndices.end()) {
+            return PollutantIndexUnknown;
+        }
+        return index->second;
+    }
+
+    int CEP::GetPollutantCount() const {
+        return (int)_pollutantIdentifiers.size();
+    }
+
+    const std::string& CEP::GetPollutantIdentifier(int pollutantIndex) const {
+        static const std::string fc = "FC";
+        static const std::string unknown = "";
+        if (pollutantIndex == PollutantIndexFC) {
+            return fc;
+        }
+        if (pollutantIndex < 0 || pollutantIndex >= (int)_pollutantIdentifiers.size()) {
+            return unknown;
+        }
+        return _pollutantIdentifiers[pollutantIndex];
+    }
+
+    double CEP::GetEmission(const std::string& pollutant, double power, double speed, Helpers* VehicleClass) const {
+        int pollutantIndex = GetPollutantIndex(pollutant);
+        if (pollutantIndex == PollutantIndexUnknown) {
+            VehicleClass->setErrMsg(std::string("Emission pollutant ") + pollutant + std::string(" not found!"));
+            return 0;
+        }
+
+        return GetEmission(pollutantIndex, power, speed, VehicleClass);
+    }
+
+    double CEP::GetEmission(int pollutantIndex, double power, double speed, Helpers* VehicleClass) const {
         //Declaration
-        std::vector<double> emissionCurve;
-        std::vector<double> powerPattern;
+        double value;
 
         // bisection search to find correct position in power pattern	
         int upperIndex;
         int lowerIndex;
 
-        if (_fuelType != Constants::strBEV) {
+        if (pollutantIndex != PollutantIndexFC && (pollutantIndex < 0 || pollutantIndex >= _pollutantCount)) {
+            VehicleClass->setErrMsg(std::string("Emission pollutant index ") + std::to_string(pollutantIndex) + std::string(" not found!"));
+            return 0;
+        }
+
+        if (!_isBEV) {
             if (std::abs(speed) <= Constants::ZERO_SPEED_ACCURACY) {
-                if (pollutant == "FC") {
+                if (pollutantIndex == PollutantIndexFC) {
                     return _idlingValueFC;
                 }
                 else {
-                    if (_cepCurvePollutants.find(pollutant) == _cepCurvePollutants.end()) {
-                        VehicleClass->setErrMsg(std::string("Emission pollutant ") + pollutant + std::string(" not found!"));
-                        return 0;
-                    }
-
-                    return _idlingValuesPollutants[pollutant];
+                    return _idlingValuesPollutants[pollutantIndex];
                 }
             }
         }
 
-        if (pollutant == "FC") {
-            emissionCurve = _cepCurveFC;
-            powerPattern = _powerPatternFC;
-        }
-        else {
-            if (_cepCurvePollutants.find(pollutant) == _cepCurvePollutants.end()) {
-                VehicleClass->setErrMsg(std::string("Emission pollutant ") + pollutant + std::string(" not found!"));
-                return 0;
-            }
-
-            emissionCurve = _cepCurvePollutants[pollutant];
-            powerPattern = _powerPatternPollutants;
+        if (pollutantIndex != PollutantIndexFC) {
+            // single column of the interleaved table
+            GetEmissions(&pollutantIndex, 1, power, speed, &value, VehicleClass);
+            return value;
         }
+        const std::vector<double>& emissionCurve = _cepCurveFC;
+        const std::vector<double>& powerPattern = _powerPatternFC;
 
         if (emissionCurve.empty()) {
-            VehicleClass->setErrMsg(std::string("Empty emission curve for ") + pollutant + std::string(" found!"));
+            VehicleClass->setErrMsg(std::string("Empty emission curve for ") + GetPollutantIdentifier(pollutantIndex) + std::string(" found!"));
             return 0;
         }
         if (emissionCurve.size() == 1) {
@@ -284,90 +380,475 @@ namespace PHEMlightdll {
             return emissionCurve.back();
         }
 
+        if (_gridFC.getValid()) {
+            return _gridFC.Evaluate(power, 0);
+        }
+
         FindLowerUpperInPattern(lowerIndex, upperIndex, powerPattern, power);
         return Interpolate(power, powerPattern[lowerIndex], powerPattern[upperIndex], emissionCurve[lowerIndex], emissionCurve[upperIndex]);
     }
 
-    double CEP::GetCO2Emission(double _FC, double _CO, double _HC, Helpers* VehicleClass) {
+    void CEP::GetEmissions(const int* pollutantIndices, int count, double power, double speed, double* values, Helpers* VehicleClass) const {
         //Declaration
-        double fCBr;
-        double fCHC = 0.866;
-        double fCCO = 0.429;
-        double fCCO2 = 0.273;
+        int upperIndex;
+        int lowerIndex;
+        const int rowCount = (int)_powerPatternPollutants.size();
+
+        // idling values, fuel consumption and unknown pollutants are handled by the single pollutant path
+        bool idling = !_isBEV && std::abs(speed) <= Constants::ZERO_SPEED_ACCURACY;
+        for (int i = 0; i < count; i++) {
+            int pollutantIndex = pollutantIndices[i];
+            if (pollutantIndex == PollutantIndexFC || pollutantIndex < 0 || pollutantIndex >= _pollutantCount) {
+                values[i] = GetEmission(pollutantIndex, power, speed, VehicleClass);
+            }
+            else if (idling) {
+                values[i] = _idlingValuesPollutants[pollutantIndex];
+            }
+            else if (rowCount == 0) {
+                VehicleClass->setErrMsg(std::string("Empty emission curve for ") + GetPollutantIdentifier(pollutantIndex) + std::string(" found!"));
+                values[i] = 0;
+            }
+        }
+        if (idling || rowCount == 0) {
+            return;
+        }
+
+        if (_gridPollutants.getValid()) {
+            _gridPollutants.Evaluate(power, pollutantIndices, count, values);
+            return;
+        }
+
+        // one search in the shared power pattern for all pollutant columns
+        if (rowCount == 1 || power <= _powerPatternPollutants.front()) {
+            lowerIndex = 0;
+            upperIndex = 0;
+        }
+        else if (power >= _powerPatternPollutants.back()) {
+            lowerIndex = rowCount - 1;
+            upperIndex = rowCount - 1;
+        }
+        else {
+            FindLowerUpperInPattern(lowerIndex, upperIndex, _powerPatternPollutants, power);
+        }
+
+        const double* lowerRow = &_cepTablePollutants[lowerIndex * _pollutantCount];
+        const double* upperRow = &_cepTablePollutants[upperIndex * _pollutantCount];
+        double p1 = _powerPatternPollutants[lowerIndex];
+        double p2 = _powerPatternPollutants[upperIndex];
+        for (int i = 0; i < count; i++) {
+            int pollutantIndex = pollutantIndices[i];
+            if (pollutantIndex < 0 || pollutantIndex >= _pollutantCount) {
+                continue;
+            }
+            if (lowerIndex == upperIndex) {
+                values[i] = lowerRow[pollutantIndex];
+            }
+            else {
+                values[i] = Interpolate(power, p1, p2, lowerRow[pollutantIndex], upperRow[pollutantIndex]);
+            }
+        }
+    }
+
+    void CEP::InitializePowerCoefficients() {
+        // rolling resistance, air drag, inertia and gradient of CalcPower in kW at the engine
+        const double scale = 1 / (1000 * _driveTrainEfficiency);
+        const double weight = (_massVehicle + _vehicleLoading) * Constants::GRAVITY_CONST;
+        _powerCoefficients.speed1 = weight * _resistanceF0 * scale;
+        _powerCoefficients.speed2 = weight * _resistanceF1 * scale;
+        _powerCoefficients.speed3 = _crossSectionalArea * _cWValue * Constants::AIR_DENSITY_CONST / 2 * scale;
+        _powerCoefficients.speed5 = weight * _resistanceF4 * scale;
+        _powerCoefficients.gradient = weight * 0.01 * scale;
+        _powerCoefficients.inertiaMass = _massVehicle * scale;
+        _powerCoefficients.inertiaOffset = (_vehicleMassRot + _vehicleLoading) * scale;
+        _powerCoefficients.aux = _auxPower * _ratedPower;
+    }
+
+    void CEP::InitializeFuelType() {
+        _isBEV = _fuelType == Constants::strBEV;
+        _fuelTypeKnown = true;
+        _fCBr = 0;
+        _fCHC = 0.866;
 
 //C# TO C++ CONVERTER NOTE: The following 'switch' operated on a string variable and was converted to C++ 'if-else' logic:
 //        switch (_fuelType)
 //ORIGINAL LINE: case Constants.strGasoline:
         if (_fuelType == Constants::strGasoline) {
-                fCBr = 0.865;
+                _fCBr = 0.865;
         }
 //ORIGINAL LINE: case Constants.strDiesel:
         else if (_fuelType == Constants::strDiesel) {
-                fCBr = 0.863;
+                _fCBr = 0.863;
         }
 //ORIGINAL LINE: case Constants.strCNG:
         else if (_fuelType == Constants::strCNG) {
-                fCBr = 0.693;
-                fCHC = 0.803;
+                _fCBr = 0.693;
+                _fCHC = 0.803;
         }
 //ORIGINAL LINE: case Constants.strLPG:
         else if (_fuelType == Constants::strLPG) {
-                fCBr = 0.825;
-                fCHC = 0.825;
+                _fCBr = 0.825;
+                _fCHC = 0.825;
         }
         else {
+                _fuelTypeKnown = false;
+        }
+    }
+
+    double CEP::GetCO2Emission(double _FC, double _CO, double _HC, Helpers* VehicleClass) const {
+        //Declaration
+        double fCCO = 0.429;
+        double fCCO2 = 0.273;
+
+        if (!_fuelTypeKnown) {
                 VehicleClass->setErrMsg(std::string("The propolsion type is not known! (") + _fuelType + std::string(")"));
                 return 0;
         }
 
-        return (_FC * fCBr - _CO * fCCO - _HC * fCHC) / fCCO2;
+        return (_FC * _fCBr - _CO * fCCO - _HC * _fCHC) / fCCO2;
     }
 
-    double CEP::GetDecelCoast(double speed, double acc, double gradient) {
+    double CEP::GetDecelCoast(double speed, double acc, double gradient) const {
         //Declaration
         int upperIndex;
         int lowerIndex;
 
+        if (_gridDecelCoast.getValid() && speed >= 0 && speed <= _gridDecelCoast.getEnd()) {
+            double values[2];
+            _gridDecelCoast.Evaluate(speed, values);
+            return values[0] + values[1] * gradient;
+        }
+
         if (speed < Constants::SPEED_DCEL_MIN) {
             return speed / Constants::SPEED_DCEL_MIN * GetDecelCoast(Constants::SPEED_DCEL_MIN, acc, gradient);
         }
 
         double rotCoeff = GetRotationalCoeffecient(speed);
-        FindLowerUpperInPattern(lowerIndex, upperIndex, _speedPatternRotational, speed);
-        double iGear = Interpolate(speed, _speedPatternRotational[lowerIndex], _speedPatternRotational[upperIndex], _gearTransmissionCurve[lowerIndex], _gearTransmissionCurve[upperIndex]);
+        double iGear;
+        if (_gridRotational.getValid()) {
+            iGear = _gridRotational.Evaluate(speed, 1);
+        }
+        else {
+            FindLowerUpperInPattern(lowerIndex, upperIndex, _speedPatternRotational, speed);
+            iGear = Interpolate(speed, _speedPatternRotational[lowerIndex], _speedPatternRotational[upperIndex], _gearTransmissionCurve[lowerIndex], _gearTransmissionCurve[upperIndex]);
+        }
 
         double iTot = iGear * _axleRatio;
 
         double n = (30 * speed * iTot) / ((_effectiveWheelDiameter / 2) * M_PI);
         double nNorm = (n - _engineIdlingSpeed) / (_engineRatedSpeed - _engineIdlingSpeed);
 
-        FindLowerUpperInPattern(lowerIndex, upperIndex, _nNormTable, nNorm);
-
         double fMot = 0;
 
         if (speed >= 10e-2) {
-            fMot = (-Interpolate(nNorm, _nNormTable[lowerIndex], _nNormTable[upperIndex], _dragNormTable[lowerIndex], _dragNormTable[upperIndex]) * _ratedPower * 1000 / speed) / 0.9;
+            double dragNorm;
+            if (_gridDrag.getValid()) {
+                dragNorm = _gridDrag.Evaluate(nNorm, 0);
+            }
+            else {
+                FindLowerUpperInPattern(lowerIndex, upperIndex, _nNormTable, nNorm);
+                dragNorm = Interpolate(nNorm, _nNormTable[lowerIndex], _nNormTable[upperIndex], _dragNormTable[lowerIndex], _dragNormTable[upperIndex]);
+            }
+            fMot = (-dragNorm * _ratedPower * 1000 / speed) / 0.9;
         }
 
-        double fRoll = (_resistanceF0 + _resistanceF1 * speed + std::pow(_resistanceF2 * speed, 2) + std::pow(_resistanceF3 * speed, 3) + std::pow(_resistanceF4 * speed, 4)) * (_massVehicle + _vehicleLoading) * Constants::GRAVITY_CONST;
+        double f2 = _resistanceF2 * speed;
+        double f3 = _resistanceF3 * speed;
+        double f4 = _resistanceF4 * speed;
+        double fRoll = (_resistanceF0 + _resistanceF1 * speed + f2 * f2 + f3 * f3 * f3 + f4 * f4 * f4 * f4) * (_massVehicle + _vehicleLoading) * Constants::GRAVITY_CONST;
 
-        double fAir = _cWValue * _crossSectionalArea * 1.2 * 0.5 * std::pow(speed, 2);
+        double fAir = _cWValue * _crossSectionalArea * 1.2 * 0.5 * (speed * speed);
 
         double fGrad = (_massVehicle + _vehicleLoading) * Constants::GRAVITY_CONST * gradient / 100;
 
         return -(fMot + fRoll + fAir + fGrad) / ((_massVehicle + _vehicleLoading) * rotCoeff);
     }
 
-    double CEP::GetRotationalCoeffecient(double speed) {
+    double CEP::GetRotationalCoeffecient(double speed) const {
         //Declaration
         int upperIndex;
         int lowerIndex;
 
+        if (_gridRotational.getValid()) {
+            return _gridRotational.Evaluate(speed, 0);
+        }
+
         FindLowerUpperInPattern(lowerIndex, upperIndex, _speedPatternRotational, speed);
         return Interpolate(speed, _speedPatternRotational[lowerIndex], _speedPatternRotational[upperIndex], _speedCurveRotational[lowerIndex], _speedCurveRotational[upperIndex]);
     }
 
-    void CEP::FindLowerUpperInPattern(int& lowerIndex, int& upperIndex, std::vector<double>& pattern, double value) {
+    void CEP::InitializeUniformGrids(double maxRelativeError, int maxSize) {
+        // the derived curves are sampled from the original tables
+        _gridRotational = UniformGrid();
+        _gridDrag = UniformGrid();
+        _gridFC = UniformGrid();
+        _gridPollutants = UniformGrid();
+        _gridMaxAccel = UniformGrid();
+        _gridDecelCoast = UniformGrid();
+        if (!_speedPatternRotational.empty()) {
+            // kinks of the curves, the drag table kinks depend on the gear and are left to the cell checks
+            std::vector<double> kinks = _speedPatternRotational;
+            kinks.push_back(_pNormV0);
+            kinks.push_back(_pNormV1);
+            kinks.push_back(Constants::SPEED_DCEL_MIN);
+            _gridMaxAccel.Build("MaxAccel", &SampleMaxAccel, this, 0, _speedPatternRotational.back(), kinks, 2, maxRelativeError, maxSize);
+            if (!_nNormTable.empty()) {
+                _gridDecelCoast.Build("DecelCoast", &SampleDecelCoast, this, 0, _speedPatternRotational.back(), kinks, 2, maxRelativeError, maxSize);
+            }
+        }
+
+        // rotational coefficient and gear ratio share the speed pattern
+        std::vector<double> speedTable;
+        for (int i = 0; i < (int)_speedPatternRotational.size(); i++) {
+            speedTable.push_back(_speedCurveRotational[i]);
+            speedTable.push_back(_gearTransmissionCurve[i]);
+        }
+
+        _gridRotational.Build("SpeedRotational", _speedPatternRotational, speedTable, 2, maxRelativeError, maxSize);
+        _gridDrag.Build("DragNorm", _nNormTable, _dragNormTable, 1, maxRelativeError, maxSize);
+        _gridFC.Build("FC", _powerPatternFC, _cepCurveFC, 1, maxRelativeError, maxSize);
+        _gridPollutants.Build("Pollutants", _powerPatternPollutants, _cepTablePollutants, _pollutantCount, maxRelativeError, maxSize);
+
+        // the float copies follow the new grids
+        InitializeSingleTables();
+    }
+
+    std::vector<const UniformGrid*> CEP::GetUniformGrids() const {
+        std::vector<const UniformGrid*> grids;
+        grids.push_back(&_gridRotational);
+        grids.push_back(&_gridDrag);
+        grids.push_back(&_gridFC);
+        grids.push_back(&_gridPollutants);
+        grids.push_back(&_gridMaxAccel);
+        grids.push_back(&_gridDecelCoast);
+        return grids;
+    }
+
+    void CEP::CalcPowerBatch(int vehicleCount, const double* speed, const double* acc, const double* gradient, double* power) const {
+        const Batch::Kernels* kernels = Batch::GetKernels(_instructionSet);
+        if ((kernels == NULL && _precision == Batch::Precision_Double) || _speedPatternRotational.empty()) {
+            for (int i = 0; i < vehicleCount; i++) {
+                power[i] = CalcPower(speed[i], acc[i], gradient[i]);
+            }
+            return;
+        }
+
+        if (_precision == Batch::Precision_Single) {
+            Batch::SingleModel model;
+            GetBatchModel(model);
+            Batch::GetSingleKernels(_instructionSet)->calcPower(model, vehicleCount, speed, acc, gradient, power);
+            return;
+        }
+
+        Batch::Model model;
+        GetBatchModel(model);
+        kernels->calcPower(model, vehicleCount, speed, acc, gradient, power);
+    }
+
+    void CEP::GetMaxAccelBatch(int vehicleCount, const double* speed, const double* gradient, double* maxAccel) const {
+        const Batch::Kernels* kernels = Batch::GetKernels(_instructionSet);
+        if ((kernels == NULL && _precision == Batch::Precision_Double) || _speedPatternRotational.empty()) {
+            for (int i = 0; i < vehicleCount; i++) {
+                maxAccel[i] = GetMaxAccel(speed[i], gradient[i]);
+            }
+            return;
+        }
+
+        if (_precision == Batch::Precision_Single) {
+            Batch::SingleModel model;
+            GetBatchModel(model);
+            Batch::GetSingleKernels(_instructionSet)->getMaxAccel(model, vehicleCount, speed, gradient, maxAccel);
+            return;
+        }
+
+        Batch::Model model;
+        GetBatchModel(model);
+        kernels->getMaxAccel(model, vehicleCount, speed, gradient, maxAccel);
+    }
+
+    void CEP::GetDecelCoastBatch(int vehicleCount, const double* speed, const double* acc, const double* gradient, double* decelCoast) const {
+        const Batch::Kernels* kernels = Batch::GetKernels(_instructionSet);
+        if ((kernels == NULL && _precision == Batch::Precision_Double) || _speedPatternRotational.empty() || _nNormTable.empty()) {
+            for (int i = 0; i < vehicleCount; i++) {
+                decelCoast[i] = GetDecelCoast(speed[i], acc[i], gradient[i]);
+            }
+            return;
+        }
+
+        if (_precision == Batch::Precision_Single) {
+            Batch::SingleModel model;
+            GetBatchModel(model);
+            Batch::GetSingleKernels(_instructionSet)->getDecelCoast(model, vehicleCount, speed, acc, gradient, decelCoast);
+            return;
+        }
+
+        Batch::Model model;
+        GetBatchModel(model);
+        kernels->getDecelCoast(model, vehicleCount, speed, acc, gradient, decelCoast);
+    }
+
+    void CEP::GetEmissionsBatch(const int* pollutantIndices, int count, int vehicleCount, const double* power, const double* speed, double* values, Helpers* VehicleClass) const {
+        const Batch::Kernels* kernels = Batch::GetKernels(_instructionSet);
+        if (kernels == NULL && _precision == Batch::Precision_Double) {
+            for (int i = 0; i < vehicleCount; i++) {
+                GetEmissions(pollutantIndices, count, power[i], speed[i], values + i * count, VehicleClass);
+            }
+            return;
+        }
+
+        if (_precision == Batch::Precision_Single) {
+            Batch::SingleModel model;
+            GetBatchModel(model);
+            Batch::GetSingleKernels(_instructionSet)->getEmissions(model, pollutantIndices, count, vehicleCount, power, speed, values);
+        }
+        else {
+            Batch::Model model;
+            GetBatchModel(model);
+            kernels->getEmissions(model, pollutantIndices, count, vehicleCount, power, speed, values);
+        }
+
+        // unknown pollutants and empty curves are left to the single calls, which report the error
+        for (int j = 0; j < count; j++) {
+            int pollutantIndex = pollutantIndices[j];
+            bool vectorized = pollutantIndex == PollutantIndexFC ? !_cepCurveFC.empty() : pollutantIndex >= 0 && pollutantIndex < _pollutantCount && !_powerPatternPollutants.empty();
+            if (vectorized) {
+                continue;
+            }
+            for (int i = 0; i < vehicleCount; i++) {
+                values[i * count + j] = GetEmission(pollutantIndex, power[i], speed[i], VehicleClass);
+            }
+        }
+    }
+
+    void CEP::GetBatchModel(Batch::Model& model) const {
+        model.massVehicle = _massVehicle;
+        model.vehicleLoading = _vehicleLoading;
+        model.vehicleMassRot = _vehicleMassRot;
+        model.crossSectionalArea = _crossSectionalArea;
+        model.cWValue = _cWValue;
+        model.resistanceF0 = _resistanceF0;
+        model.resistanceF1 = _resistanceF1;
+        model.resistanceF2 = _resistanceF2;
+        model.resistanceF3 = _resistanceF3;
+        model.resistanceF4 = _resistanceF4;
+        model.axleRatio = _axleRatio;
+        model.auxPower = _auxPower;
+        model.ratedPower = _ratedPower;
+        model.pNormV0 = _pNormV0;
+        model.pNormP0 = _pNormP0;
+        model.pNormV1 = _pNormV1;
+        model.pNormP1 = _pNormP1;
+        model.engineRatedSpeed = _engineRatedSpeed;
+        model.engineIdlingSpeed = _engineIdlingSpeed;
+        model.wheelRadiusPi = (_effectiveWheelDiameter / 2) * M_PI;
+        model.power = _powerCoefficients;
+
+        model.isBEV = _isBEV;
+        model.idlingValueFC = _idlingValueFC;
+        model.idlingValuesPollutants = _idlingValuesPollutants.empty() ? NULL : &_idlingValuesPollutants[0];
+
+        GetBatchTable(model.speedRotational, _speedPatternRotational, _speedCurveRotational, 1);
+        GetBatchTable(model.gearTransmission, _speedPatternRotational, _gearTransmissionCurve, 1);
+        GetBatchTable(model.dragNorm, _nNormTable, _dragNormTable, 1);
+        GetBatchTable(model.fc, _powerPatternFC, _cepCurveFC, 1);
+        GetBatchTable(model.pollutants, _powerPatternPollutants, _cepTablePollutants, _pollutantCount);
+
+        GetBatchGrid(model.gridRotational, _gridRotational);
+        GetBatchGrid(model.gridDrag, _gridDrag);
+        GetBatchGrid(model.gridFC, _gridFC);
+        GetBatchGrid(model.gridPollutants, _gridPollutants);
+        GetBatchGrid(model.gridMaxAccel, _gridMaxAccel);
+        GetBatchGrid(model.gridDecelCoast, _gridDecelCoast);
+    }
+
+    void CEP::GetBatchModel(Batch::SingleModel& model) const {
+        // the parameters are rounded like the tables, the fused coefficients from their double values
+        Batch::Model source;
+        GetBatchModel(source);
+        model.massVehicle = (float)source.massVehicle;
+        model.vehicleLoading = (float)source.vehicleLoading;
+        model.vehicleMassRot = (float)source.vehicleMassRot;
+        model.crossSectionalArea = (float)source.crossSectionalArea;
+        model.cWValue = (float)source.cWValue;
+        model.resistanceF0 = (float)source.resistanceF0;
+        model.resistanceF1 = (float)source.resistanceF1;
+        model.resistanceF2 = (float)source.resistanceF2;
+        model.resistanceF3 = (float)source.resistanceF3;
+        model.resistanceF4 = (float)source.resistanceF4;
+        model.axleRatio = (float)source.axleRatio;
+        model.auxPower = (float)source.auxPower;
+        model.ratedPower = (float)source.ratedPower;
+        model.pNormV0 = (float)source.pNormV0;
+        model.pNormP0 = (float)source.pNormP0;
+        model.pNormV1 = (float)source.pNormV1;
+        model.pNormP1 = (float)source.pNormP1;
+        model.engineRatedSpeed = (float)source.engineRatedSpeed;
+        model.engineIdlingSpeed = (float)source.engineIdlingSpeed;
+        model.wheelRadiusPi = (float)source.wheelRadiusPi;
+        model.power.speed1 = (float)source.power.speed1;
+        model.power.speed2 = (float)source.power.speed2;
+        model.power.speed3 = (float)source.power.speed3;
+        model.power.speed5 = (float)source.power.speed5;
+        model.power.gradient = (float)source.power.gradient;
+        model.power.inertiaMass = (float)source.power.inertiaMass;
+        model.power.inertiaOffset = (float)source.power.inertiaOffset;
+        model.power.aux = (float)source.power.aux;
+
+        model.isBEV = source.isBEV;
+        model.idlingValueFC = (float)source.idlingValueFC;
+        model.idlingValuesPollutants = _singleTables.idlingValuesPollutants.empty() ? NULL : &_singleTables.idlingValuesPollutants[0];
+
+        const SingleTables& t = _singleTables;
+        GetBatchTable(model.speedRotational, t.speedPatternRotational, t.speedCurveRotational, 1);
+        GetBatchTable(model.gearTransmission, t.speedPatternRotational, t.gearTransmissionCurve, 1);
+        GetBatchTable(model.dragNorm, t.nNormTable, t.dragNormTable, 1);
+        GetBatchTable(model.fc, t.powerPatternFC, t.cepCurveFC, 1);
+        GetBatchTable(model.pollutants, t.powerPatternPollutants, t.cepTablePollutants, _pollutantCount);
+
+        GetBatchGrid(model.gridRotational, _gridRotational, t.gridRotational);
+        GetBatchGrid(model.gridDrag, _gridDrag, t.gridDrag);
+        GetBatchGrid(model.gridFC, _gridFC, t.gridFC);
+        GetBatchGrid(model.gridPollutants, _gridPollutants, t.gridPollutants);
+        GetBatchGrid(model.gridMaxAccel, _gridMaxAccel, t.gridMaxAccel);
+        GetBatchGrid(model.gridDecelCoast, _gridDecelCoast, t.gridDecelCoast);
+    }
+
+    void CEP::GetBatchTable(Batch::Table& table, const std::vector<double>& pattern, const std::vector<double>& values, int columns) {
+        table.pattern = pattern.empty() ? NULL : &pattern[0];
+        table.values = values.empty() ? NULL : &values[0];
+        table.rows = values.empty() ? 0 : (int)pattern.size();
+        table.columns = columns;
+    }
+
+    void CEP::GetBatchGrid(Batch::Grid& grid, const UniformGrid& uniformGrid) {
+        grid.valid = uniformGrid.getValid();
+        grid.values = uniformGrid.getValues().empty() ? NULL : &uniformGrid.getValues()[0];
+        grid.columns = uniformGrid.getColumnCount();
+        grid.size = uniformGrid.getSize();
+        grid.start = uniformGrid.getStart();
+        grid.end = uniformGrid.getEnd();
+        grid.inverseStep = uniformGrid.getInverseStep();
+        grid.lastCell = uniformGrid.getLastCell();
+    }
+
+    void CEP::GetBatchTable(Batch::BasicTable<float>& table, const std::vector<float>& pattern, const std::vector<float>& values, int columns) {
+        table.pattern = pattern.empty() ? NULL : &pattern[0];
+        table.values = values.empty() ? NULL : &values[0];
+        table.rows = values.empty() ? 0 : (int)pattern.size();
+        table.columns = columns;
+    }
+
+    void CEP::GetBatchGrid(Batch::BasicGrid<float>& grid, const UniformGrid& uniformGrid, const std::vector<float>& values) {
+        grid.valid = uniformGrid.getValid() && !values.empty();
+        grid.values = values.empty() ? NULL : &values[0];
+        grid.columns = uniformGrid.getColumnCount();
+        grid.size = uniformGrid.getSize();
+        grid.start = (float)uniformGrid.getStart();
+        grid.end = (float)uniformGrid.getEnd();
+        grid.inverseStep = (float)uniformGrid.getInverseStep();
+        grid.lastCell = (float)uniformGrid.getLastCell();
+    }
+
+    void CEP::FindLowerUpperInPattern(int& lowerIndex, int& upperIndex, const std::vector<double>& pattern, double value) const {
         lowerIndex = 0;
         upperIndex = 0;
 
@@ -409,7 +890,7 @@ namespace PHEMlightdll {
         }
     }
 
-    double CEP::Interpolate(double px, double p1, double p2, double e1, double e2) {
+    double CEP::Interpolate(double px, double p1, double p2, double e1, double e2) const {
         if (p2 == p1) {
             return e1;
         }
@@ -417,14 +898,40 @@ namespace PHEMlightdll {
         return e1 + (px - p1) / (p2 - p1) * (e2 - e1);
     }
 
-    double CEP::GetMaxAccel(double speed, double gradient) {
+    double CEP::GetMaxAccel(double speed, double gradient) const {
+        if (_gridMaxAccel.getValid() && speed > 0 && speed <= _gridMaxAccel.getEnd()) {
+            double values[2];
+            _gridMaxAccel.Evaluate(speed, values);
+            return values[0] / speed + values[1] * gradient;
+        }
+
         double rotFactor = GetRotationalCoeffecient(speed);
         double pMaxForAcc = GetPMaxNorm(speed) * _ratedPower - CalcPower(speed, 0, gradient);
 
         return (pMaxForAcc * 1000) / ((_massVehicle * rotFactor + _vehicleMassRot + _vehicleLoading) * speed);
     }
 
-    double CEP::GetPMaxNorm(double speed) {
+    void CEP::SampleMaxAccel(const void* context, double speed, double* values) {
+        // GetMaxAccel without the division by speed, which has a pole at standstill
+        const CEP* cep = (const CEP*)context;
+        double massRot = cep->_massVehicle * cep->GetRotationalCoeffecient(speed) + cep->_vehicleMassRot + cep->_vehicleLoading;
+        values[0] = (cep->GetPMaxNorm(speed) * cep->_ratedPower - cep->CalcPower(speed, 0, 0)) * 1000 / massRot;
+        values[1] = -cep->_powerCoefficients.gradient * 1000 / massRot;
+    }
+
+    void CEP::SampleDecelCoast(const void* context, double speed, double* values) {
+        // the gradient force over the rotating mass, scaled like the curve below SPEED_DCEL_MIN
+        const CEP* cep = (const CEP*)context;
+        values[0] = cep->GetDecelCoast(speed, 0, 0);
+        if (speed < Constants::SPEED_DCEL_MIN) {
+            values[1] = speed / Constants::SPEED_DCEL_MIN * (-Constants::GRAVITY_CONST / (100 * cep->GetRotationalCoeffecient(Constants::SPEED_DCEL_MIN)));
+        }
+        else {
+            values[1] = -Constants::GRAVITY_CONST / (100 * cep->GetRotationalCoeffecient(speed));
+        }
+    }
+
+    double CEP::GetPMaxNorm(double speed) const {
         // Linear function between v0 and v1, constant elsewhere
         if (speed <= _pNormV0) {
             return _pNormP0;
@@ -443,6 +950,7 @@ namespace PHEMlightdll {
         _ratedPower = 0;
         _normalizingPower = 0;
         _drivingPower = 0;
+        _driveTrainEfficiency = 0;
         _massVehicle = 0;
         _vehicleLoading = 0;
         _vehicleMassRot = 0;
@@ -463,5 +971,37 @@ namespace PHEMlightdll {
         _engineIdlingSpeed = 0;
         _effectiveWheelDiameter = 0;
         _idlingValueFC = 0;
+        _pollutantCount = 0;
+        _isBEV = false;
+        _fuelTypeKnown = false;
+        _fCBr = 0;
+        _fCHC = 0;
+        _instructionSet = Batch::GetSupportedInstructionSet();
+        _precision = Batch::Precision_Double;
+    }
+
+    void CEP::InitializeSingleTables() {
+        SingleTables& t = _singleTables;
+        t = SingleTables();
+        if (_precision != Batch::Precision_Single) {
+            return;
+        }
+
+        t.speedPatternRotational.assign(_speedPatternRotational.begin(), _speedPatternRotational.end());
+        t.speedCurveRotational.assign(_speedCurveRotational.begin(), _speedCurveRotational.end());
+        t.gearTransmissionCurve.assign(_gearTransmissionCurve.begin(), _gearTransmissionCurve.end());
+        t.nNormTable.assign(_nNormTable.begin(), _nNormTable.end());
+        t.dragNormTable.assign(_dragNormTable.begin(), _dragNormTable.end());
+        t.powerPatternFC.assign(_powerPatternFC.begin(), _powerPatternFC.end());
+        t.cepCurveFC.assign(_cepCurveFC.begin(), _cepCurveFC.end());
+        t.powerPatternPollutants.assign(_powerPatternPollutants.begin(), _powerPatternPollutants.end());
+        t.cepTablePollutants.assign(_cepTablePollutants.begin(), _cepTablePollutants.end());
+        t.idlingValuesPollutants.assign(_idlingValuesPollutants.begin(), _idlingValuesPollutants.end());
+        t.gridRotational.assign(_gridRotational.getValues().begin(), _gridRotational.getValues().end());
+        t.gridDrag.assign(_gridDrag.getValues().begin(), _gridDrag.getValues().end());
+        t.gridFC.assign(_gridFC.getValues().begin(), _gridFC.getValues().end());
+        t.gridPollutants.assign(_gridPollutants.getValues().begin(), _gridPollutants.getValues().end());
+        t.gridMaxAccel.assign(_gridMaxAccel.getValues().begin(), _gridMaxAccel.getValues().end());
+        t.gridDecelCoast.assign(_gridDecelCoast.getValues().begin(), _gridDecelCoast.getValues().end());
     }
 }
@@ -31,9 +31,12 @@
 #include <vector>
 #include <cmath>
 #include <utility>
+#include "UniformGrid.h"
+#include "CEPBatch.h"
 
 //C# TO C++ CONVERTER NOTE: Forward class declarations:
 namespace PHEMlightdll { class Helpers; }
+namespace PHEMlightdll { class CEPCache; }
 
 
 namespace PHEMlightdll {
@@ -43,7 +46,12 @@ namespace PHEMlightdll {
         //--------------------------------------------------------------------------------------------------      
 
     public:
-        CEP(bool heavyVehicle, double vehicleMass, double vehicleLoading, double vehicleMassRot, double crossArea, double cWValue, double f0, double f1, double f2, double f3, double f4, double axleRatio, std::vector<double>& transmissionGearRatios, double auxPower, double ratedPower, double engineIdlingSpeed, double engineRatedSpeed, double effictiveWheelDiameter, double pNormV0, double pNormP0, double pNormV1, double pNormP1, const std::string& vehicelFuelType, std::vector<std::vector<double> >& matrixFC, std::vector<std::string>& headerLinePollutants, std::vector<std::vector<double> >& matrixPollutants, std::vector<std::vector<double> >& matrixSpeedRotational, std::vector<std::vector<double> >& normedDragTable, double idlingFC, std::vector<double>& idlingPollutants);
+        CEP(bool heavyVehicle, double vehicleMass, double vehicleLoading, double vehicleMassRot, double crossArea, double cWValue, double f0, double f1, double f2, double f3, double f4, double axleRatio, std::vector<double>& transmissionGearRatios, double auxPower, double ratedPower, double engineIdlingSpeed, double engineRatedSpeed, double effictiveWheelDiameter, double pNormV0, double pNormP0, double pNormV1, double pNormP1, const std::string& vehicelFuelType, std::vector<std::vector<double> >& matrixFC, std::vector<std::string>& headerLinePollutants, std::vector<std::vector<double> >& matrixPollutants, std::vector<std::vector<double> >& matrixSpeedRotational, std::vector<std::vector<double> >& normedDragTable, double idlingFC, std::vector<double>& idlingPollutants, double driveTrainEfficiency);
+
+    private:
+        // empty cep filled by the cache
+        CEP();
+        friend class CEPCache;
 
 
         //--------------------------------------------------------------------------------------------------
@@ -60,6 +68,16 @@ namespace PHEMlightdll {
     public:
         const std::string&  getFuelType() const;
 
+    private:
+        // fuel type dependent values, resolved once in the constructor
+        bool _isBEV;
+        bool _fuelTypeKnown;
+        double _fCBr;
+        double _fCHC;
+    public:
+        const bool&  getIsBEV() const;
+        const bool&  getFuelTypeKnown() const;
+
     public:
         enum NormalizingType {
             NormalizingType_RatedPower,
@@ -87,6 +105,32 @@ namespace PHEMlightdll {
         const double&  getDrivingPower() const;
         void setDrivingPower(const double&  value);
 
+    private:
+        // drive train efficiency of the vehicle class, see Helpers
+        double _driveTrainEfficiency;
+    public:
+        const double&  getDriveTrainEfficiency() const;
+
+    private:
+        // vehicle parameters fused into the power polynomial, see InitializePowerCoefficients
+        Batch::PowerCoefficients _powerCoefficients;
+    public:
+        const Batch::PowerCoefficients&  getPowerCoefficients() const;
+
+    private:
+        // vector extension used by the batch methods, the best one of the CPU by default
+        Batch::InstructionSet _instructionSet;
+    public:
+        const Batch::InstructionSet&  getInstructionSet() const;
+        void setInstructionSet(const Batch::InstructionSet&  value);
+
+    private:
+        // scalar type of the batch methods, single precision works on float copies of the tables
+        Batch::Precision _precision;
+    public:
+        const Batch::Precision&  getPrecision() const;
+        void setPrecision(const Batch::Precision&  value);
+
 
 
     protected:
@@ -121,44 +165,133 @@ namespace PHEMlightdll {
         std::vector<double> _normedCepCurveFC;
         std::vector<double> _gearTransmissionCurve;
         std::vector<double> _speedCurveRotational;
-        std::map<std::string, std::vector<double> > _cepCurvePollutants;
         std::map<std::string, std::vector<double> > _cepNormalizedCurvePollutants;
         double _idlingValueFC;
-        std::map<std::string, double> _idlingValuesPollutants;
+
+        // pollutant curves and idling values by column index of the pollutant file,
+        // the curves are interleaved: all pollutant values of one power pattern entry are adjacent
+        std::vector<std::string> _pollutantIdentifiers;
+        std::map<std::string, int> _pollutantIndices;
+        int _pollutantCount;
+        std::vector<double> _cepTablePollutants;
+        std::vector<double> _idlingValuesPollutants;
 
         std::vector<double> _nNormTable;
         std::vector<double> _dragNormTable;
 
+        // optional uniform grid resampling of the tables above, used instead of the bisection when valid
+        UniformGrid _gridRotational;
+        UniformGrid _gridDrag;
+        UniformGrid _gridFC;
+        UniformGrid _gridPollutants;
+
+        // derived curves over speed, the gradient enters linearly: column 0 at a level road and
+        // column 1 per % gradient. The maximum acceleration is stored times speed, see GetMaxAccel
+        UniformGrid _gridMaxAccel;
+        UniformGrid _gridDecelCoast;
+
+        // float copies of the tables and grids above for the single precision batch methods,
+        // empty unless the precision is single
+        struct SingleTables {
+            std::vector<float> speedPatternRotational;
+            std::vector<float> speedCurveRotational;
+            std::vector<float> gearTransmissionCurve;
+            std::vector<float> nNormTable;
+            std::vector<float> dragNormTable;
+            std::vector<float> powerPatternFC;
+            std::vector<float> cepCurveFC;
+            std::vector<float> powerPatternPollutants;
+            std::vector<float> cepTablePollutants;
+            std::vector<float> idlingValuesPollutants;
+            std::vector<float> gridRotational;
+            std::vector<float> gridDrag;
+            std::vector<float> gridFC;
+            std::vector<float> gridPollutants;
+            std::vector<float> gridMaxAccel;
+            std::vector<float> gridDecelCoast;
+        };
+        SingleTables _singleTables;
+
 
         //--------------------------------------------------------------------------------------------------
         // Methods 
         //--------------------------------------------------------------------------------------------------
 
     public:
-        double CalcPower(double speed, double acc, double gradient);
+        // pollutant handles for GetEmission, resolved once by GetPollutantIndex
+        static const int PollutantIndexFC = -1;
+        static const int PollutantIndexUnknown = -2;
+
+        int GetPollutantIndex(const std::string& pollutant) const;
+
+        int GetPollutantCount() const;
 
-        double CalcEngPower(double power);
+        const std::string& GetPollutantIdentifier(int pollutantIndex) const;
 
-        double GetEmission(const std::string& pollutant, double power, double speed, Helpers* VehicleClass);
+        double CalcPower(double speed, double acc, double gradient) const;
 
+        double CalcEngPower(double power) const;
 
-        double GetCO2Emission(double _FC, double _CO, double _HC, Helpers* VehicleClass);
+        double GetEmission(const std::string& pollutant, double power, double speed, Helpers* VehicleClass) const;
 
-        double GetDecelCoast(double speed, double acc, double gradient);
+        double GetEmission(int pollutantIndex, double power, double speed, Helpers* VehicleClass) const;
 
-        double GetRotationalCoeffecient(double speed);
+        // evaluates several pollutants with a single search in the power pattern
+        void GetEmissions(const int* pollutantIndices, int count, double power, double speed, double* values, Helpers* VehicleClass) const;
+
+
+        double GetCO2Emission(double _FC, double _CO, double _HC, Helpers* VehicleClass) const;
+
+        double GetDecelCoast(double speed, double acc, double gradient) const;
+
+        double GetRotationalCoeffecient(double speed) const;
 
 
     private:
-        void FindLowerUpperInPattern(int& lowerIndex, int& upperIndex, std::vector<double>& pattern, double value);
+        void FindLowerUpperInPattern(int& lowerIndex, int& upperIndex, const std::vector<double>& pattern, double value) const;
 
-        double Interpolate(double px, double p1, double p2, double e1, double e2);
+        double Interpolate(double px, double p1, double p2, double e1, double e2) const;
 
     public:
-        double GetMaxAccel(double speed, double gradient);
+        double GetMaxAccel(double speed, double gradient) const;
+
+        // resamples all tables onto uniform grids meeting the given relative error, tables that are not
+        // strictly monotonic or can't meet the error within maxSize grid points keep the bisection.
+        // The maximum acceleration and the coasting deceleration are tabulated over speed the same way
+        void InitializeUniformGrids(double maxRelativeError, int maxSize);
+
+        std::vector<const UniformGrid*> GetUniformGrids() const;
+
+        // batch versions of CalcPower, GetMaxAccel, GetDecelCoast and GetEmissions for arrays of
+        // vehicles, vectorized with the instruction set of the CEP and identical to the single calls.
+        // Emission values of vehicle i are written to values[i * count ... i * count + count - 1]
+        void CalcPowerBatch(int vehicleCount, const double* speed, const double* acc, const double* gradient, double* power) const;
+
+        void GetMaxAccelBatch(int vehicleCount, const double* speed, const double* gradient, double* maxAccel) const;
+
+        void GetDecelCoastBatch(int vehicleCount, const double* speed, const double* acc, const double* gradient, double* decelCoast) const;
+
+        void GetEmissionsBatch(const int* pollutantIndices, int count, int vehicleCount, const double* power, const double* speed, double* values, Helpers* VehicleClass) const;
 
     private:
-        double GetPMaxNorm(double speed);
+        double GetPMaxNorm(double speed) const;
+
+        // UniformGrid::Function of the derived curves, context is the CEP
+        static void SampleMaxAccel(const void* context, double speed, double* values);
+
+        static void SampleDecelCoast(const void* context, double speed, double* values);
+
+        void GetBatchModel(Batch::Model& model) const;
+
+        void GetBatchModel(Batch::SingleModel& model) const;
+
+        static void GetBatchTable(Batch::Table& table, const std::vector<double>& pattern, const std::vector<double>& values, int columns);
+
+        static void GetBatchTable(Batch::BasicTable<float>& table, const std::vector<float>& pattern, const std::vector<float>& values, int columns);
+
+        static void GetBatchGrid(Batch::Grid& grid, const UniformGrid& uniformGrid);
+
+        static void GetBatchGrid(Batch::BasicGrid<float>& grid, const UniformGrid& uniformGrid, const std::vector<float>& values);
 
         //--------------------------------------------------------------------------------------------------
         // Operators for fleetmix
@@ -167,6 +300,12 @@ namespace PHEMlightdll {
 
     private:
         void InitializeInstanceFields();
+
+        void InitializeFuelType();
+
+        void InitializePowerCoefficients();
+
+        void InitializeSingleTables();
     };
 }
 
@@ -0,0 +1,135 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    CEPBatch.cpp
+/// @author  agent
+/// @date    2026/10/17
+///
+/// Runtime selection of the instruction set.
+//
+/****************************************************************************/
+
+
+#include "CEPBatch.h"
+#include "CEPBatchKernels.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PHEMLIGHT_BATCH_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+
+namespace PHEMlightdll {
+    namespace Batch {
+        namespace {
+#ifdef PHEMLIGHT_BATCH_X86
+            void CpuId(int info[4], int leaf) {
+#if defined(_MSC_VER)
+                __cpuidex(info, leaf, 0);
+#else
+                __cpuid_count(leaf, 0, info[0], info[1], info[2], info[3]);
+#endif
+            }
+
+            // register state enabled by the operating system
+            unsigned long long GetEnabledState() {
+#if defined(_MSC_VER)
+                return _xgetbv(0);
+#else
+                unsigned int eax, edx;
+                __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+                return ((unsigned long long)edx << 32) | eax;
+#endif
+            }
+#endif
+
+            InstructionSet DetectInstructionSet() {
+#ifdef PHEMLIGHT_BATCH_X86
+                int info[4];
+                CpuId(info, 0);
+                if (info[0] < 7) {
+                    return InstructionSet_Scalar;
+                }
+
+                // AVX and XSAVE enabled by the operating system
+                CpuId(info, 1);
+                if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) {
+                    return InstructionSet_Scalar;
+                }
+                unsigned long long state = GetEnabledState();
+                if ((state & 0x6) != 0x6) {
+                    return InstructionSet_Scalar;
+                }
+
+                // AVX2 and AVX-512F, the latter with the opmask and ZMM state enabled
+                CpuId(info, 7);
+                bool avx2 = (info[1] & (1 << 5)) != 0;
+                bool avx512 = (info[1] & (1 << 16)) != 0 && (state & 0xE0) == 0xE0;
+                if (avx512 && GetAVX512Kernels() != NULL) {
+                    return InstructionSet_AVX512;
+                }
+                if (avx2 && GetAVX2Kernels() != NULL) {
+                    return InstructionSet_AVX2;
+                }
+#endif
+                return InstructionSet_Scalar;
+            }
+        }
+
+        InstructionSet GetSupportedInstructionSet() {
+            static const InstructionSet supported = DetectInstructionSet();
+            return supported;
+        }
+
+        const char* GetInstructionSetName(InstructionSet instructionSet) {
+            switch (instructionSet) {
+            case InstructionSet_AVX2:
+                return "AVX2";
+            case InstructionSet_AVX512:
+                return "AVX512";
+            default:
+                return "SCALAR";
+            }
+        }
+
+        const char* GetPrecisionName(Precision precision) {
+            return precision == Precision_Single ? "SINGLE" : "DOUBLE";
+        }
+
+        const Kernels* GetKernels(InstructionSet instructionSet) {
+            if (instructionSet > GetSupportedInstructionSet()) {
+                instructionSet = GetSupportedInstructionSet();
+            }
+            if (instructionSet == InstructionSet_AVX512) {
+                return GetAVX512Kernels();
+            }
+            if (instructionSet == InstructionSet_AVX2) {
+                return GetAVX2Kernels();
+            }
+            return NULL;
+        }
+
+        const SingleKernels* GetSingleKernels(InstructionSet instructionSet) {
+            if (instructionSet > GetSupportedInstructionSet()) {
+                instructionSet = GetSupportedInstructionSet();
+            }
+            if (instructionSet == InstructionSet_AVX512) {
+                return GetAVX512SingleKernels();
+            }
+            if (instructionSet == InstructionSet_AVX2) {
+                return GetAVX2SingleKernels();
+            }
+            return &KernelSet<ScalarVector<float> >::Get();
+        }
+    }
+}
@@ -0,0 +1,169 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    CEPBatch.h
+/// @author  agent
+/// @date    2026/10/17
+///
+/// Vectorized kernels evaluating a CEP for arrays of vehicles.
+//
+/****************************************************************************/
+
+
+#ifndef PHEMlightCEPBATCH
+#define PHEMlightCEPBATCH
+
+#include <cstddef>
+
+
+namespace PHEMlightdll {
+    namespace Batch {
+        enum InstructionSet {
+            InstructionSet_Scalar,
+            InstructionSet_AVX2,
+            InstructionSet_AVX512
+        };
+
+        // scalar type of the kernels, single precision halves the table memory and doubles the
+        // vector width at the cost of accuracy, see the precision report of the handler
+        enum Precision {
+            Precision_Double,
+            Precision_Single
+        };
+
+        // piecewise linear table, all columns of one breakpoint are adjacent
+        template<class T>
+        struct BasicTable {
+            const T* pattern;
+            const T* values;
+            int rows;
+            int columns;
+        };
+
+        // uniform grid resampling of a table, see UniformGrid
+        template<class T>
+        struct BasicGrid {
+            bool valid;
+            const T* values;
+            int columns;
+            int size;
+            T start;
+            T end;
+            T inverseStep;
+            T lastCell;
+        };
+
+        // CalcPower terms of a CEP fused at load, scaled by 1 / (1000 * drive train efficiency):
+        // power = speed * (speed1 + gradient * gradient + (inertiaMass * rotFactor + inertiaOffset) * acc
+        //                  + speed * (speed2 + speed * (speed3 + speed * speed * speed5))) + aux
+        template<class T>
+        struct BasicPowerCoefficients {
+            T speed1;
+            T speed2;
+            T speed3;
+            T speed5;
+            T gradient;
+            T inertiaMass;
+            T inertiaOffset;
+            T aux;
+        };
+
+        // plain copy of the CEP parameters, so the kernels don't depend on the CEP class
+        template<class T>
+        struct BasicModel {
+            T massVehicle;
+            T vehicleLoading;
+            T vehicleMassRot;
+            T crossSectionalArea;
+            T cWValue;
+            T resistanceF0;
+            T resistanceF1;
+            T resistanceF2;
+            T resistanceF3;
+            T resistanceF4;
+            T axleRatio;
+            T auxPower;
+            T ratedPower;
+            T pNormV0;
+            T pNormP0;
+            T pNormV1;
+            T pNormP1;
+            T engineRatedSpeed;
+            T engineIdlingSpeed;
+            // (effectiveWheelDiameter / 2) * M_PI
+            T wheelRadiusPi;
+            BasicPowerCoefficients<T> power;
+
+            bool isBEV;
+            T idlingValueFC;
+            const T* idlingValuesPollutants;
+
+            BasicTable<T> speedRotational;
+            BasicTable<T> gearTransmission;
+            BasicTable<T> dragNorm;
+            BasicTable<T> fc;
+            BasicTable<T> pollutants;
+
+            // grid columns: rotational coefficient, gear transmission
+            BasicGrid<T> gridRotational;
+            BasicGrid<T> gridDrag;
+            BasicGrid<T> gridFC;
+            BasicGrid<T> gridPollutants;
+            // derived curves of CEP::InitializeUniformGrids, both with a level road and a gradient column
+            BasicGrid<T> gridMaxAccel;
+            BasicGrid<T> gridDecelCoast;
+        };
+
+        // kernels of one instruction set and precision, inputs and results are double for both.
+        // Double results are identical for all instruction sets
+        template<class T>
+        struct BasicKernels {
+            void (*calcPower)(const BasicModel<T>& model, int count, const double* speed, const double* acc, const double* gradient, double* power);
+            void (*getMaxAccel)(const BasicModel<T>& model, int count, const double* speed, const double* gradient, double* maxAccel);
+            void (*getDecelCoast)(const BasicModel<T>& model, int count, const double* speed, const double* acc, const double* gradient, double* decelCoast);
+            // values of vehicle i are written to values[i * columnCount ...], columns are pollutant
+            // indices of the CEP or -1 for FC, columns without a curve are left untouched
+            void (*getEmissions)(const BasicModel<T>& model, const int* columns, int columnCount, int count, const double* power, const double* speed, double* values);
+        };
+
+        typedef BasicTable<double> Table;
+        typedef BasicGrid<double> Grid;
+        typedef BasicPowerCoefficients<double> PowerCoefficients;
+        typedef BasicModel<double> Model;
+        typedef BasicKernels<double> Kernels;
+
+        typedef BasicModel<float> SingleModel;
+        typedef BasicKernels<float> SingleKernels;
+
+        // best instruction set of this CPU, detected once
+        InstructionSet GetSupportedInstructionSet();
+
+        const char* GetInstructionSetName(InstructionSet instructionSet);
+
+        const char* GetPrecisionName(Precision precision);
+
+        // kernels of the given instruction set limited to the supported one,
+        // NULL for the scalar fallback which uses the single vehicle methods
+        const Kernels* GetKernels(InstructionSet instructionSet);
+
+        // single precision kernels of the given instruction set limited to the supported one,
+        // the scalar ones are portable and never NULL
+        const SingleKernels* GetSingleKernels(InstructionSet instructionSet);
+
+        // implemented in separate translation units compiled for the instruction set,
+        // NULL if the instruction set isn't available for the target platform
+        const Kernels* GetAVX2Kernels();
+        const Kernels* GetAVX512Kernels();
+        const SingleKernels* GetAVX2SingleKernels();
+        const SingleKernels* GetAVX512SingleKernels();
+    }
+}
+
+
+#endif	//#ifndef PHEMlightCEPBATCH
@@ -0,0 +1,122 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    CEPBatchAVX2.cpp
+/// @author  agent
+/// @date    2026/10/17
+///
+/// AVX2 kernels, four vehicles per vector. Compiled with AVX2 enabled and
+/// only called after the runtime check in CEPBatch.cpp.
+//
+/****************************************************************************/
+
+
+#include "CEPBatchKernels.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+
+namespace PHEMlightdll {
+    namespace Batch {
+        namespace {
+            struct AVX2Vector {
+                typedef double T;
+                typedef __m256d D;
+                typedef __m256d M;
+                enum { Width = 4 };
+
+                static inline D Set(double value) { return _mm256_set1_pd(value); }
+                static inline D Load(const double* source) { return _mm256_loadu_pd(source); }
+                static inline void Store(double* target, D value) { _mm256_storeu_pd(target, value); }
+                static inline D LoadDouble(const double* source) { return _mm256_loadu_pd(source); }
+                static inline void StoreDouble(double* target, D value) { _mm256_storeu_pd(target, value); }
+                static inline D Add(D a, D b) { return _mm256_add_pd(a, b); }
+                static inline D Sub(D a, D b) { return _mm256_sub_pd(a, b); }
+                static inline D Mul(D a, D b) { return _mm256_mul_pd(a, b); }
+                static inline D Div(D a, D b) { return _mm256_div_pd(a, b); }
+                static inline D Neg(D a) { return _mm256_xor_pd(a, _mm256_set1_pd(-0.0)); }
+                static inline D Abs(D a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+                static inline D Floor(D a) { return _mm256_floor_pd(a); }
+                static inline M Lt(D a, D b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+                static inline M Le(D a, D b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+                static inline M Gt(D a, D b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+                static inline M Ge(D a, D b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+                static inline M Eq(D a, D b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+                static inline M False() { return _mm256_setzero_pd(); }
+                static inline M And(M a, M b) { return _mm256_and_pd(a, b); }
+                static inline M Or(M a, M b) { return _mm256_or_pd(a, b); }
+                static inline M Not(M a) { return _mm256_xor_pd(a, _mm256_castsi256_pd(_mm256_set1_epi64x(-1))); }
+                static inline bool Any(M a) { return _mm256_movemask_pd(a) != 0; }
+                static inline D Select(M mask, D ifTrue, D ifFalse) { return _mm256_blendv_pd(ifFalse, ifTrue, mask); }
+                // masked with a zeroed source, the unmasked gather leaves its source undefined and GCC warns about it
+                static inline D Gather(const double* base, D index) { return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, _mm256_cvttpd_epi32(index), _mm256_castsi256_pd(_mm256_set1_epi64x(-1)), 8); }
+            };
+
+            struct AVX2SingleVector {
+                typedef float T;
+                typedef __m256 D;
+                typedef __m256 M;
+                enum { Width = 8 };
+
+                static inline D Set(double value) { return _mm256_set1_ps((float)value); }
+                static inline D Load(const float* source) { return _mm256_loadu_ps(source); }
+                static inline void Store(float* target, D value) { _mm256_storeu_ps(target, value); }
+                static inline D LoadDouble(const double* source) { return _mm256_set_m128(_mm256_cvtpd_ps(_mm256_loadu_pd(source + 4)), _mm256_cvtpd_ps(_mm256_loadu_pd(source))); }
+                static inline void StoreDouble(double* target, D value) {
+                    _mm256_storeu_pd(target, _mm256_cvtps_pd(_mm256_castps256_ps128(value)));
+                    _mm256_storeu_pd(target + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(value, 1)));
+                }
+                static inline D Add(D a, D b) { return _mm256_add_ps(a, b); }
+                static inline D Sub(D a, D b) { return _mm256_sub_ps(a, b); }
+                static inline D Mul(D a, D b) { return _mm256_mul_ps(a, b); }
+                static inline D Div(D a, D b) { return _mm256_div_ps(a, b); }
+                static inline D Neg(D a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+                static inline D Abs(D a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+                static inline D Floor(D a) { return _mm256_floor_ps(a); }
+                static inline M Lt(D a, D b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+                static inline M Le(D a, D b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+                static inline M Gt(D a, D b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+                static inline M Ge(D a, D b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+                static inline M Eq(D a, D b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+                static inline M False() { return _mm256_setzero_ps(); }
+                static inline M And(M a, M b) { return _mm256_and_ps(a, b); }
+                static inline M Or(M a, M b) { return _mm256_or_ps(a, b); }
+                static inline M Not(M a) { return _mm256_xor_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(-1))); }
+                static inline bool Any(M a) { return _mm256_movemask_ps(a) != 0; }
+                static inline D Select(M mask, D ifTrue, D ifFalse) { return _mm256_blendv_ps(ifFalse, ifTrue, mask); }
+                static inline D Gather(const float* base, D index) { return _mm256_mask_i32gather_ps(_mm256_setzero_ps(), base, _mm256_cvttps_epi32(index), _mm256_castsi256_ps(_mm256_set1_epi32(-1)), 4); }
+            };
+        }
+
+        const Kernels* GetAVX2Kernels() {
+            return &KernelSet<AVX2Vector>::Get();
+        }
+
+        const SingleKernels* GetAVX2SingleKernels() {
+            return &KernelSet<AVX2SingleVector>::Get();
+        }
+    }
+}
+
+#else
+
+namespace PHEMlightdll {
+    namespace Batch {
+        const Kernels* GetAVX2Kernels() {
+            return NULL;
+        }
+
+        const SingleKernels* GetAVX2SingleKernels() {
+            return NULL;
+        }
+    }
+}
+
+#endif
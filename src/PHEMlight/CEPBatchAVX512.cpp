@@ -0,0 +1,127 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    CEPBatchAVX512.cpp
+/// @author  agent
+/// @date    2026/10/17
+///
+/// AVX-512 kernels, eight vehicles per vector. Compiled with AVX-512F enabled
+/// and only called after the runtime check in CEPBatch.cpp.
+//
+/****************************************************************************/
+
+
+#include "CEPBatchKernels.h"
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+
+
+namespace PHEMlightdll {
+    namespace Batch {
+        namespace {
+            struct AVX512Vector {
+                typedef double T;
+                typedef __m512d D;
+                typedef __mmask8 M;
+                enum { Width = 8 };
+                static constexpr M AllLanes = 0xFF;
+
+                static inline D Set(double value) { return _mm512_set1_pd(value); }
+                static inline D Load(const double* source) { return _mm512_loadu_pd(source); }
+                static inline void Store(double* target, D value) { _mm512_storeu_pd(target, value); }
+                static inline D LoadDouble(const double* source) { return _mm512_loadu_pd(source); }
+                static inline void StoreDouble(double* target, D value) { _mm512_storeu_pd(target, value); }
+                static inline D Add(D a, D b) { return _mm512_add_pd(a, b); }
+                static inline D Sub(D a, D b) { return _mm512_sub_pd(a, b); }
+                static inline D Mul(D a, D b) { return _mm512_mul_pd(a, b); }
+                static inline D Div(D a, D b) { return _mm512_div_pd(a, b); }
+                static inline D Neg(D a) { return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(a), _mm512_set1_epi64((long long)0x8000000000000000ULL))); }
+                static inline D Abs(D a) { return _mm512_abs_pd(a); }
+                // the zero masked forms with all lanes set, the unmasked ones pass an undefined source and GCC warns about it
+                static inline D Floor(D a) { return _mm512_maskz_roundscale_pd(AllLanes, a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+                static inline M Lt(D a, D b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+                static inline M Le(D a, D b) { return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ); }
+                static inline M Gt(D a, D b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+                static inline M Ge(D a, D b) { return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ); }
+                static inline M Eq(D a, D b) { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+                static inline M False() { return 0; }
+                static inline M And(M a, M b) { return (M)(a & b); }
+                static inline M Or(M a, M b) { return (M)(a | b); }
+                static inline M Not(M a) { return (M)~a; }
+                static inline bool Any(M a) { return a != 0; }
+                static inline D Select(M mask, D ifTrue, D ifFalse) { return _mm512_mask_blend_pd(mask, ifFalse, ifTrue); }
+                static inline D Gather(const double* base, D index) { return _mm512_mask_i32gather_pd(_mm512_setzero_pd(), AllLanes, _mm512_maskz_cvttpd_epi32(AllLanes, index), base, 8); }
+            };
+
+            struct AVX512SingleVector {
+                typedef float T;
+                typedef __m512 D;
+                typedef __mmask16 M;
+                enum { Width = 16 };
+                static constexpr M AllLanes = 0xFFFF;
+
+                static inline D Set(double value) { return _mm512_set1_ps((float)value); }
+                static inline D Load(const float* source) { return _mm512_loadu_ps(source); }
+                static inline void Store(float* target, D value) { _mm512_storeu_ps(target, value); }
+                static inline D LoadDouble(const double* source) {
+                    __m512d lower = _mm512_castpd256_pd512(_mm256_castps_pd(_mm512_maskz_cvtpd_ps(0xFF, _mm512_loadu_pd(source))));
+                    return _mm512_castpd_ps(_mm512_maskz_insertf64x4(0xFF, lower, _mm256_castps_pd(_mm512_maskz_cvtpd_ps(0xFF, _mm512_loadu_pd(source + 8))), 1));
+                }
+                static inline void StoreDouble(double* target, D value) {
+                    _mm512_storeu_pd(target, _mm512_maskz_cvtps_pd(0xFF, _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0x0F, _mm512_castps_pd(value), 0))));
+                    _mm512_storeu_pd(target + 8, _mm512_maskz_cvtps_pd(0xFF, _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0x0F, _mm512_castps_pd(value), 1))));
+                }
+                static inline D Add(D a, D b) { return _mm512_add_ps(a, b); }
+                static inline D Sub(D a, D b) { return _mm512_sub_ps(a, b); }
+                static inline D Mul(D a, D b) { return _mm512_mul_ps(a, b); }
+                static inline D Div(D a, D b) { return _mm512_div_ps(a, b); }
+                static inline D Neg(D a) { return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), _mm512_set1_epi32((int)0x80000000u))); }
+                static inline D Abs(D a) { return _mm512_abs_ps(a); }
+                static inline D Floor(D a) { return _mm512_maskz_roundscale_ps(AllLanes, a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+                static inline M Lt(D a, D b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+                static inline M Le(D a, D b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+                static inline M Gt(D a, D b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+                static inline M Ge(D a, D b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+                static inline M Eq(D a, D b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+                static inline M False() { return 0; }
+                static inline M And(M a, M b) { return (M)(a & b); }
+                static inline M Or(M a, M b) { return (M)(a | b); }
+                static inline M Not(M a) { return (M)~a; }
+                static inline bool Any(M a) { return a != 0; }
+                static inline D Select(M mask, D ifTrue, D ifFalse) { return _mm512_mask_blend_ps(mask, ifFalse, ifTrue); }
+                static inline D Gather(const float* base, D index) { return _mm512_mask_i32gather_ps(_mm512_setzero_ps(), AllLanes, _mm512_maskz_cvttps_epi32(AllLanes, index), base, 4); }
+            };
+        }
+
+        const Kernels* GetAVX512Kernels() {
+            return &KernelSet<AVX512Vector>::Get();
+        }
+
+        const SingleKernels* GetAVX512SingleKernels() {
+            return &KernelSet<AVX512SingleVector>::Get();
+        }
+    }
+}
+
+#else
+
+namespace PHEMlightdll {
+    namespace Batch {
+        const Kernels* GetAVX512Kernels() {
+            return NULL;
+        }
+
+        const SingleKernels* GetAVX512SingleKernels() {
+            return NULL;
+        }
+    }
+}
+
+#endif
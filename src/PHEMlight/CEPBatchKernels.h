@@ -0,0 +1,420 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    CEPBatchKernels.h
+/// @author  agent
+/// @date    2026/10/17
+///
+/// CEP kernels written once against a vector abstraction, included by the
+/// translation units of each instruction set. The operations mirror the
+/// scalar CEP methods step by step, so all instruction sets round the same.
+//
+/****************************************************************************/
+
+
+#ifndef PHEMlightCEPBATCHKERNELS
+#define PHEMlightCEPBATCHKERNELS
+
+#include <cmath>
+#include "CEPBatch.h"
+#include "Constants.h"
+
+// fused multiply-add would round differently than the scalar methods
+#if defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+
+namespace PHEMlightdll {
+    namespace Batch {
+        // V provides the scalar type T, the vector type D of Width scalars, the mask type M and the
+        // operations Set, Load, Store, LoadDouble, StoreDouble, Add, Sub, Mul, Div, Neg, Abs, Floor,
+        // Lt, Le, Gt, Ge, Eq, False, And, Or, Not, Any, Select(mask, ifTrue, ifFalse) and
+        // Gather(base, index). The arrays are double for both precisions
+        template<class V>
+        class KernelSet {
+        public:
+            typedef typename V::T T;
+            typedef typename V::D D;
+            typedef typename V::M M;
+            typedef BasicTable<T> Table;
+            typedef BasicGrid<T> Grid;
+            typedef BasicPowerCoefficients<T> PowerCoefficients;
+            typedef BasicModel<T> Model;
+
+            //--------------------------------------------------------------------------------------------------
+            // Interpolation
+            //--------------------------------------------------------------------------------------------------
+
+            static inline D Interpolate(D px, D p1, D p2, D e1, D e2) {
+                D value = V::Add(e1, V::Mul(V::Div(V::Sub(px, p1), V::Sub(p2, p1)), V::Sub(e2, e1)));
+                return V::Select(V::Eq(p2, p1), e1, value);
+            }
+
+            // CEP::FindLowerUpperInPattern, each lane follows the same bisection steps, indices as scalars
+            static inline void FindLowerUpper(const Table& table, D value, D& lowerIndex, D& upperIndex) {
+                const D one = V::Set(1);
+                const D half = V::Set(0.5);
+                const D last = V::Set(table.rows - 1);
+                M front = V::Le(value, V::Set(table.pattern[0]));
+                M back = V::Ge(value, V::Set(table.pattern[table.rows - 1]));
+
+                D middle = V::Set((table.rows - 1) / 2);
+                upperIndex = last;
+                lowerIndex = V::Set(0);
+
+                M run = V::And(V::Not(V::Or(front, back)), V::Gt(V::Sub(upperIndex, lowerIndex), one));
+                while (V::Any(run)) {
+                    D middleValue = V::Gather(table.pattern, middle);
+                    M equal = V::And(run, V::Eq(middleValue, value));
+                    M less = V::And(run, V::Lt(middleValue, value));
+                    M greater = V::And(run, V::Not(V::Or(equal, less)));
+                    lowerIndex = V::Select(V::Or(equal, less), middle, lowerIndex);
+                    upperIndex = V::Select(V::Or(equal, greater), middle, upperIndex);
+                    D next = V::Add(V::Floor(V::Mul(V::Sub(upperIndex, lowerIndex), half)), lowerIndex);
+                    middle = V::Select(V::Or(less, greater), next, middle);
+                    run = V::And(run, V::Gt(V::Sub(upperIndex, lowerIndex), one));
+                }
+
+                lowerIndex = V::Select(front, V::Set(0), V::Select(back, last, lowerIndex));
+                upperIndex = V::Select(front, V::Set(0), V::Select(back, last, upperIndex));
+            }
+
+            static inline D Lookup(const Table& table, int column, D lowerIndex, D upperIndex, D value) {
+                const D columns = V::Set(table.columns);
+                D p1 = V::Gather(table.pattern, lowerIndex);
+                D p2 = V::Gather(table.pattern, upperIndex);
+                D e1 = V::Gather(table.values + column, V::Mul(lowerIndex, columns));
+                D e2 = V::Gather(table.values + column, V::Mul(upperIndex, columns));
+                return Interpolate(value, p1, p2, e1, e2);
+            }
+
+            static inline D Lookup(const Table& table, D value) {
+                D lowerIndex, upperIndex;
+                FindLowerUpper(table, value, lowerIndex, upperIndex);
+                return Lookup(table, 0, lowerIndex, upperIndex, value);
+            }
+
+            // UniformGrid::Locate
+            static inline void Locate(const Grid& grid, D x, D& index, D& fraction) {
+                const D lastCell = V::Set(grid.lastCell);
+                const D lastIndex = V::Set(grid.size - 2);
+                D t = V::Mul(V::Sub(x, V::Set(grid.start)), V::Set(grid.inverseStep));
+                t = V::Select(V::Not(V::Gt(t, V::Set(0))), V::Set(0), V::Select(V::Gt(t, lastCell), lastCell, t));
+                index = V::Floor(t);
+                index = V::Select(V::Gt(index, lastIndex), lastIndex, index);
+                fraction = V::Sub(t, index);
+            }
+
+            // UniformGrid::Evaluate
+            static inline D Evaluate(const Grid& grid, int column, D index, D fraction) {
+                D offset = V::Mul(index, V::Set(grid.columns));
+                D lower = V::Gather(grid.values + column, offset);
+                D upper = V::Gather(grid.values + column + grid.columns, offset);
+                return V::Add(lower, V::Mul(fraction, V::Sub(upper, lower)));
+            }
+
+            static inline D Evaluate(const Grid& grid, int column, D x) {
+                D index, fraction;
+                Locate(grid, x, index, fraction);
+                return Evaluate(grid, column, index, fraction);
+            }
+
+
+            //--------------------------------------------------------------------------------------------------
+            // CEP methods
+            //--------------------------------------------------------------------------------------------------
+
+            static inline D GetRotationalCoeffecient(const Model& model, D speed) {
+                if (model.gridRotational.valid) {
+                    return Evaluate(model.gridRotational, 0, speed);
+                }
+                return Lookup(model.speedRotational, speed);
+            }
+
+            static inline D CalcPower(const Model& model, D speed, D acc, D gradient) {
+                const PowerCoefficients& c = model.power;
+                D rotFactor = GetRotationalCoeffecient(model, speed);
+
+                // same order as CEP::CalcPower
+                D polynomial = V::Add(V::Set(c.speed3), V::Mul(V::Mul(speed, speed), V::Set(c.speed5)));
+                polynomial = V::Add(V::Set(c.speed2), V::Mul(speed, polynomial));
+                D inertia = V::Add(V::Mul(V::Set(c.inertiaMass), rotFactor), V::Set(c.inertiaOffset));
+                D power = V::Add(V::Set(c.speed1), V::Mul(V::Set(c.gradient), gradient));
+                power = V::Add(power, V::Mul(inertia, acc));
+                power = V::Add(power, V::Mul(speed, polynomial));
+                return V::Add(V::Mul(speed, power), V::Set(c.aux));
+            }
+
+            static inline D GetPMaxNorm(const Model& model, D speed) {
+                D linear = Interpolate(speed, V::Set(model.pNormV0), V::Set(model.pNormV1), V::Set(model.pNormP0), V::Set(model.pNormP1));
+                return V::Select(V::Le(speed, V::Set(model.pNormV0)), V::Set(model.pNormP0), V::Select(V::Ge(speed, V::Set(model.pNormV1)), V::Set(model.pNormP1), linear));
+            }
+
+            static inline D GetMaxAccel(const Model& model, D speed, D gradient) {
+                if (!model.gridMaxAccel.valid) {
+                    return GetMaxAccelCurves(model, speed, gradient);
+                }
+
+                // CEP::GetMaxAccel, lanes outside of the grid fall back to the curves
+                const Grid& grid = model.gridMaxAccel;
+                M inside = V::And(V::Gt(speed, V::Set(0)), V::Le(speed, V::Set(grid.end)));
+                D index, fraction;
+                Locate(grid, speed, index, fraction);
+                D value = V::Add(V::Div(Evaluate(grid, 0, index, fraction), speed), V::Mul(Evaluate(grid, 1, index, fraction), gradient));
+                if (!V::Any(V::Not(inside))) {
+                    return value;
+                }
+                return V::Select(inside, value, GetMaxAccelCurves(model, speed, gradient));
+            }
+
+            static inline D GetMaxAccelCurves(const Model& model, D speed, D gradient) {
+                D rotFactor = GetRotationalCoeffecient(model, speed);
+                D pMaxForAcc = V::Sub(V::Mul(GetPMaxNorm(model, speed), V::Set(model.ratedPower)), CalcPower(model, speed, V::Set(0), gradient));
+                D massRot = V::Add(V::Add(V::Mul(V::Set(model.massVehicle), rotFactor), V::Set(model.vehicleMassRot)), V::Set(model.vehicleLoading));
+                return V::Div(V::Mul(pMaxForAcc, V::Set(1000)), V::Mul(massRot, speed));
+            }
+
+            static inline D GetDecelCoast(const Model& model, D speed, D acc, D gradient) {
+                if (!model.gridDecelCoast.valid) {
+                    return GetDecelCoastCurves(model, speed, acc, gradient);
+                }
+
+                const Grid& grid = model.gridDecelCoast;
+                M inside = V::And(V::Ge(speed, V::Set(0)), V::Le(speed, V::Set(grid.end)));
+                D index, fraction;
+                Locate(grid, speed, index, fraction);
+                D value = V::Add(Evaluate(grid, 0, index, fraction), V::Mul(Evaluate(grid, 1, index, fraction), gradient));
+                if (!V::Any(V::Not(inside))) {
+                    return value;
+                }
+                return V::Select(inside, value, GetDecelCoastCurves(model, speed, acc, gradient));
+            }
+
+            static inline D GetDecelCoastCurves(const Model& model, D speed, D acc, D gradient) {
+                // below SPEED_DCEL_MIN the deceleration at SPEED_DCEL_MIN is scaled down
+                M slow = V::Lt(speed, V::Set(Constants::SPEED_DCEL_MIN));
+                D decelSpeed = V::Select(slow, V::Set(Constants::SPEED_DCEL_MIN), speed);
+                D decel = GetDecelCoastAbove(model, decelSpeed, acc, gradient);
+                return V::Select(slow, V::Mul(V::Div(speed, V::Set(Constants::SPEED_DCEL_MIN)), decel), decel);
+            }
+
+            static inline D GetDecelCoastAbove(const Model& model, D speed, D acc, D gradient) {
+                (void)acc;
+                const T mass = model.massVehicle + model.vehicleLoading;
+                D rotCoeff = GetRotationalCoeffecient(model, speed);
+                D iGear;
+                if (model.gridRotational.valid) {
+                    iGear = Evaluate(model.gridRotational, 1, speed);
+                }
+                else {
+                    iGear = Lookup(model.gearTransmission, speed);
+                }
+
+                D iTot = V::Mul(iGear, V::Set(model.axleRatio));
+
+                D n = V::Div(V::Mul(V::Mul(V::Set(30), speed), iTot), V::Set(model.wheelRadiusPi));
+                D nNorm = V::Div(V::Sub(n, V::Set(model.engineIdlingSpeed)), V::Set(model.engineRatedSpeed - model.engineIdlingSpeed));
+
+                D dragNorm;
+                if (model.gridDrag.valid) {
+                    dragNorm = Evaluate(model.gridDrag, 0, nNorm);
+                }
+                else {
+                    dragNorm = Lookup(model.dragNorm, nNorm);
+                }
+                D fMot = V::Div(V::Div(V::Mul(V::Mul(V::Neg(dragNorm), V::Set(model.ratedPower)), V::Set(1000)), speed), V::Set(0.9));
+                fMot = V::Select(V::Ge(speed, V::Set(10e-2)), fMot, V::Set(0));
+
+                D f2 = V::Mul(V::Set(model.resistanceF2), speed);
+                D f3 = V::Mul(V::Set(model.resistanceF3), speed);
+                D f4 = V::Mul(V::Set(model.resistanceF4), speed);
+                D fRoll = V::Add(V::Add(V::Set(model.resistanceF0), V::Mul(V::Set(model.resistanceF1), speed)), V::Mul(f2, f2));
+                fRoll = V::Add(fRoll, V::Mul(V::Mul(f3, f3), f3));
+                fRoll = V::Add(fRoll, V::Mul(V::Mul(V::Mul(f4, f4), f4), f4));
+                fRoll = V::Mul(V::Mul(fRoll, V::Set(mass)), V::Set(Constants::GRAVITY_CONST));
+
+                D fAir = V::Mul(V::Set(model.cWValue * model.crossSectionalArea * 1.2 * 0.5), V::Mul(speed, speed));
+
+                D fGrad = V::Div(V::Mul(V::Set(mass * Constants::GRAVITY_CONST), gradient), V::Set(100));
+
+                D forces = V::Add(V::Add(V::Add(fMot, fRoll), fAir), fGrad);
+                return V::Div(V::Neg(forces), V::Mul(V::Set(mass), rotCoeff));
+            }
+
+            // CEP::GetEmission and CEP::GetEmissions for valid pollutant indices
+            static inline void GetEmissions(const Model& model, const int* columns, int columnCount, D power, D speed, D* values, bool* written) {
+                M idling = model.isBEV ? V::False() : V::Le(V::Abs(speed), V::Set(Constants::ZERO_SPEED_ACCURACY));
+
+                const Table& pollutants = model.pollutants;
+                bool searched = false;
+                D lowerIndex, upperIndex, index, fraction;
+                for (int i = 0; i < columnCount; i++) {
+                    int column = columns[i];
+                    written[i] = false;
+                    if (column == -1 && model.fc.rows > 0) {
+                        const Table& fc = model.fc;
+                        D first = V::Set(fc.values[0]);
+                        D last = V::Set(fc.values[fc.rows - 1]);
+                        D value;
+                        if (fc.rows == 1) {
+                            value = first;
+                        }
+                        else if (model.gridFC.valid) {
+                            value = Evaluate(model.gridFC, 0, power);
+                            value = V::Select(V::Le(power, V::Set(fc.pattern[0])), first, V::Select(V::Ge(power, V::Set(fc.pattern[fc.rows - 1])), last, value));
+                        }
+                        else {
+                            value = Lookup(fc, power);
+                        }
+                        values[i] = V::Select(idling, V::Set(model.idlingValueFC), value);
+                        written[i] = true;
+                    }
+                    else if (column >= 0 && column < pollutants.columns && pollutants.rows > 0) {
+                        D value;
+                        if (model.gridPollutants.valid) {
+                            if (!searched) {
+                                Locate(model.gridPollutants, power, index, fraction);
+                                searched = true;
+                            }
+                            value = Evaluate(model.gridPollutants, column, index, fraction);
+                        }
+                        else {
+                            // one search in the shared power pattern for all pollutant columns
+                            if (!searched) {
+                                FindLowerUpper(pollutants, power, lowerIndex, upperIndex);
+                                searched = true;
+                            }
+                            value = Lookup(pollutants, column, lowerIndex, upperIndex, power);
+                        }
+                        values[i] = V::Select(idling, V::Set(model.idlingValuesPollutants[column]), value);
+                        written[i] = true;
+                    }
+                }
+            }
+
+
+            //--------------------------------------------------------------------------------------------------
+            // Array loops, the tail is padded with the last element
+            //--------------------------------------------------------------------------------------------------
+
+            static inline D LoadPartial(const double* source, int count) {
+                if (count == V::Width) {
+                    return V::LoadDouble(source);
+                }
+                T buffer[V::Width];
+                for (int i = 0; i < V::Width; i++) {
+                    buffer[i] = (T)source[i < count ? i : count - 1];
+                }
+                return V::Load(buffer);
+            }
+
+            static inline void StorePartial(double* target, int count, D value) {
+                if (count == V::Width) {
+                    V::StoreDouble(target, value);
+                    return;
+                }
+                T buffer[V::Width];
+                V::Store(buffer, value);
+                for (int i = 0; i < count; i++) {
+                    target[i] = buffer[i];
+                }
+            }
+
+            static void CalcPowerArray(const Model& model, int count, const double* speed, const double* acc, const double* gradient, double* power) {
+                for (int i = 0; i < count; i += V::Width) {
+                    int n = count - i < V::Width ? count - i : V::Width;
+                    StorePartial(power + i, n, CalcPower(model, LoadPartial(speed + i, n), LoadPartial(acc + i, n), LoadPartial(gradient + i, n)));
+                }
+            }
+
+            static void GetMaxAccelArray(const Model& model, int count, const double* speed, const double* gradient, double* maxAccel) {
+                for (int i = 0; i < count; i += V::Width) {
+                    int n = count - i < V::Width ? count - i : V::Width;
+                    StorePartial(maxAccel + i, n, GetMaxAccel(model, LoadPartial(speed + i, n), LoadPartial(gradient + i, n)));
+                }
+            }
+
+            static void GetDecelCoastArray(const Model& model, int count, const double* speed, const double* acc, const double* gradient, double* decelCoast) {
+                for (int i = 0; i < count; i += V::Width) {
+                    int n = count - i < V::Width ? count - i : V::Width;
+                    StorePartial(decelCoast + i, n, GetDecelCoast(model, LoadPartial(speed + i, n), LoadPartial(acc + i, n), LoadPartial(gradient + i, n)));
+                }
+            }
+
+            static void GetEmissionsArray(const Model& model, const int* columns, int columnCount, int count, const double* power, const double* speed, double* values) {
+                // columns are processed in blocks to keep the per lane results on the stack
+                const int BLOCK = 8;
+                D blockValues[BLOCK];
+                bool written[BLOCK];
+                T lanes[V::Width];
+                for (int i = 0; i < count; i += V::Width) {
+                    int n = count - i < V::Width ? count - i : V::Width;
+                    D vehiclePower = LoadPartial(power + i, n);
+                    D vehicleSpeed = LoadPartial(speed + i, n);
+                    for (int block = 0; block < columnCount; block += BLOCK) {
+                        int blockCount = columnCount - block < BLOCK ? columnCount - block : BLOCK;
+                        GetEmissions(model, columns + block, blockCount, vehiclePower, vehicleSpeed, blockValues, written);
+                        for (int j = 0; j < blockCount; j++) {
+                            if (!written[j]) {
+                                continue;
+                            }
+                            V::Store(lanes, blockValues[j]);
+                            for (int k = 0; k < n; k++) {
+                                values[(i + k) * columnCount + block + j] = lanes[k];
+                            }
+                        }
+                    }
+                }
+            }
+
+            static const BasicKernels<T>& Get() {
+                static const BasicKernels<T> kernels = { &CalcPowerArray, &GetMaxAccelArray, &GetDecelCoastArray, &GetEmissionsArray };
+                return kernels;
+            }
+        };
+
+        // one lane of the portable single precision kernels, the double scalar path is the CEP itself
+        template<class Scalar>
+        struct ScalarVector {
+            typedef Scalar T;
+            typedef Scalar D;
+            typedef bool M;
+            enum { Width = 1 };
+
+            static inline D Set(double value) { return (T)value; }
+            static inline D Load(const T* source) { return source[0]; }
+            static inline void Store(T* target, D value) { target[0] = value; }
+            static inline D LoadDouble(const double* source) { return (T)source[0]; }
+            static inline void StoreDouble(double* target, D value) { target[0] = value; }
+            static inline D Add(D a, D b) { return a + b; }
+            static inline D Sub(D a, D b) { return a - b; }
+            static inline D Mul(D a, D b) { return a * b; }
+            static inline D Div(D a, D b) { return a / b; }
+            static inline D Neg(D a) { return -a; }
+            static inline D Abs(D a) { return std::abs(a); }
+            static inline D Floor(D a) { return std::floor(a); }
+            static inline M Lt(D a, D b) { return a < b; }
+            static inline M Le(D a, D b) { return a <= b; }
+            static inline M Gt(D a, D b) { return a > b; }
+            static inline M Ge(D a, D b) { return a >= b; }
+            static inline M Eq(D a, D b) { return a == b; }
+            static inline M False() { return false; }
+            static inline M And(M a, M b) { return a && b; }
+            static inline M Or(M a, M b) { return a || b; }
+            static inline M Not(M a) { return !a; }
+            static inline bool Any(M a) { return a; }
+            static inline D Select(M mask, D ifTrue, D ifFalse) { return mask ? ifTrue : ifFalse; }
+            static inline D Gather(const T* base, D index) { return base[(int)index]; }
+        };
+    }
+}
+
+
+#endif	//#ifndef PHEMlightCEPBATCHKERNELS
@@ -0,0 +1,396 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    CEPCache.cpp
+/// @author  agent
+/// @date    2026/10/17
+///
+//
+/****************************************************************************/
+
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <system_error>
+#include <thread>
+#include "CEPCache.h"
+#include "CEP.h"
+#include "CEPReader.h"
+#include "Constants.h"
+#include "Helpers.h"
+
+
+namespace PHEMlightdll {
+
+    // layout of the cache files: magic, version, byte order mark, source stamp, cep fields in the
+    // order of WriteCEP. The version has to be increased whenever the fields or their meaning change
+    static const char CacheMagic[8] = { 'P', 'H', 'E', 'M', 'L', 'C', 'E', 'P' };
+    static const unsigned int CacheVersion = 1;
+    static const unsigned int CacheByteOrder = 0x01020304;
+
+    template <typename T>
+    static void WriteValue(std::string& buffer, const T& value) {
+        buffer.append((const char*)&value, sizeof(T));
+    }
+
+    static void WriteString(std::string& buffer, const std::string& value) {
+        WriteValue(buffer, (unsigned long long)value.size());
+        buffer.append(value);
+    }
+
+    static void WriteVector(std::string& buffer, const std::vector<double>& values) {
+        WriteValue(buffer, (unsigned long long)values.size());
+        if (!values.empty()) {
+            buffer.append((const char*)values.data(), values.size() * sizeof(double));
+        }
+    }
+
+    template <typename T>
+    static bool ReadValue(const char*& position, const char* end, T& value) {
+        if ((size_t)(end - position) < sizeof(T)) {
+            return false;
+        }
+        memcpy(&value, position, sizeof(T));
+        position += sizeof(T);
+        return true;
+    }
+
+    static bool ReadString(const char*& position, const char* end, std::string& value) {
+        unsigned long long size;
+        if (!ReadValue(position, end, size) || (size_t)(end - position) < size) {
+            return false;
+        }
+        value.assign(position, (size_t)size);
+        position += size;
+        return true;
+    }
+
+    static bool ReadVector(const char*& position, const char* end, std::vector<double>& values) {
+        unsigned long long size;
+        if (!ReadValue(position, end, size) || (size_t)(end - position) / sizeof(double) < size) {
+            return false;
+        }
+        values.resize((size_t)size);
+        if (size > 0) {
+            memcpy(values.data(), position, (size_t)size * sizeof(double));
+        }
+        position += size * sizeof(double);
+        return true;
+    }
+
+    CEPCache::CEPCache() {
+    }
+
+    const std::string& CEPCache::getCachePath() const {
+        return _cachePath;
+    }
+
+    void CEPCache::setCachePath(const std::string& value) {
+        _cachePath = value;
+    }
+
+    CEP* CEPCache::Read(const std::vector<std::string>& DataPath, Helpers* Helper) {
+        std::string stamp;
+        if (_cachePath.empty() || !GetSourceStamp(DataPath, Helper, stamp)) {
+            return NULL;
+        }
+
+        CEPReader reader;
+        if (!reader.Open(std::vector<std::string>(1, _cachePath), GetFileName(DataPath, Helper->getgClass()))) {
+            return NULL;
+        }
+        const char* position = reader.getData();
+        const char* end = position + reader.getSize();
+
+        // written by another version or for other sources
+        char magic[sizeof(CacheMagic)];
+        unsigned int version;
+        unsigned int byteOrder;
+        std::string cachedStamp;
+        if (!ReadValue(position, end, magic) || memcmp(magic, CacheMagic, sizeof(CacheMagic)) != 0
+                || !ReadValue(position, end, version) || version != CacheVersion
+                || !ReadValue(position, end, byteOrder) || byteOrder != CacheByteOrder
+                || !ReadString(position, end, cachedStamp) || cachedStamp != stamp) {
+            return NULL;
+        }
+
+        CEP* cep = new CEP();
+        if (!ReadCEP(position, end, *cep) || position != end) {
+            // truncated file
+            delete cep;
+            return NULL;
+        }
+        return cep;
+    }
+
+    bool CEPCache::Write(const std::vector<std::string>& DataPath, Helpers* Helper, const CEP& cep) {
+        std::string stamp;
+        if (_cachePath.empty() || !GetSourceStamp(DataPath, Helper, stamp)) {
+            return false;
+        }
+
+        std::string buffer;
+        buffer.append(CacheMagic, sizeof(CacheMagic));
+        WriteValue(buffer, CacheVersion);
+        WriteValue(buffer, CacheByteOrder);
+        WriteString(buffer, stamp);
+        WriteCEP(buffer, cep);
+
+        // written under a unique name and renamed, so concurrent readers never see a partial file
+        std::string fileName = _cachePath + GetFileName(DataPath, Helper->getgClass());
+        std::string temporaryName = fileName + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()))
+                                    + "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+        std::ofstream file(temporaryName.c_str(), std::ios::binary | std::ios::trunc);
+        file.write(buffer.data(), (std::streamsize)buffer.size());
+        file.close();
+
+        std::error_code error;
+        if (!file) {
+            std::filesystem::remove(temporaryName, error);
+            return false;
+        }
+        std::filesystem::rename(temporaryName, fileName, error);
+        if (error) {
+            // e.g. the old file is still mapped by another process
+            std::filesystem::remove(temporaryName, error);
+            return false;
+        }
+        return true;
+    }
+
+    bool CEPCache::GetSourceStamp(const std::vector<std::string>& DataPath, Helpers* Helper, std::string& stamp) {
+        // same file lookup as CEPHandler, the first data path containing the file wins
+        const std::string extensions[] = { ".PHEMLight.veh", "_FC.csv", ".csv" };
+        stamp.clear();
+        for (int i = 0; i < 3; i++) {
+            bool found = false;
+            for (std::vector<std::string>::const_iterator path = DataPath.begin(); path != DataPath.end() && !found; path++) {
+                std::string fileName = (*path) + Helper->getgClass() + extensions[i];
+                std::error_code error;
+                unsigned long long size = (unsigned long long)std::filesystem::file_size(fileName, error);
+                if (error) {
+                    continue;
+                }
+                long long time = (long long)std::filesystem::last_write_time(fileName, error).time_since_epoch().count();
+                if (error) {
+                    continue;
+                }
+                WriteString(stamp, fileName);
+                WriteValue(stamp, size);
+                WriteValue(stamp, time);
+                found = true;
+            }
+            if (!found) {
+                return false;
+            }
+        }
+
+        // settings and constants used by the constructor
+        WriteString(stamp, Helper->getCommentPrefix());
+        WriteValue(stamp, Helper->getDriveTrainEfficiency());
+        WriteValue(stamp, Constants::GRAVITY_CONST);
+        WriteValue(stamp, Constants::AIR_DENSITY_CONST);
+        WriteValue(stamp, Constants::NORMALIZING_SPEED);
+        WriteValue(stamp, Constants::NORMALIZING_ACCELARATION);
+        return true;
+    }
+
+    std::string CEPCache::GetFileName(const std::vector<std::string>& DataPath, const std::string& emissionClass) {
+        // classes of different data paths may share one cache directory
+        unsigned int hash = 2166136261u;
+        for (std::vector<std::string>::const_iterator path = DataPath.begin(); path != DataPath.end(); path++) {
+            for (size_t i = 0; i < path->size(); i++) {
+                hash = (hash ^ (unsigned char)(*path)[i]) * 16777619u;
+            }
+            hash = (hash ^ (unsigned char)';') * 16777619u;
+        }
+        char hex[9];
+        snprintf(hex, sizeof(hex), "%08x", hash);
+        return emissionClass + "_" + hex + ".PHEMLight.cep";
+    }
+
+    void CEPCache::WriteCEP(std::string& buffer, const CEP& cep) {
+        WriteValue(buffer, (unsigned char)cep._heavyVehicle);
+        WriteString(buffer, cep._fuelType);
+        WriteValue(buffer, (int)cep._normalizingType);
+        WriteValue(buffer, cep._ratedPower);
+        WriteValue(buffer, cep._normalizingPower);
+        WriteValue(buffer, cep._drivingPower);
+        WriteValue(buffer, cep._driveTrainEfficiency);
+
+        WriteValue(buffer, cep._massVehicle);
+        WriteValue(buffer, cep._vehicleLoading);
+        WriteValue(buffer, cep._vehicleMassRot);
+        WriteValue(buffer, cep._crossSectionalArea);
+        WriteValue(buffer, cep._cWValue);
+        WriteValue(buffer, cep._resistanceF0);
+        WriteValue(buffer, cep._resistanceF1);
+        WriteValue(buffer, cep._resistanceF2);
+        WriteValue(buffer, cep._resistanceF3);
+        WriteValue(buffer, cep._resistanceF4);
+        WriteValue(buffer, cep._axleRatio);
+        WriteValue(buffer, cep._auxPower);
+        WriteValue(buffer, cep._pNormV0);
+        WriteValue(buffer, cep._pNormP0);
+        WriteValue(buffer, cep._pNormV1);
+        WriteValue(buffer, cep._pNormP1);
+        WriteValue(buffer, cep._engineRatedSpeed);
+        WriteValue(buffer, cep._engineIdlingSpeed);
+        WriteValue(buffer, cep._effectiveWheelDiameter);
+
+        WriteVector(buffer, cep._speedPatternRotational);
+        WriteVector(buffer, cep._powerPatternFC);
+        WriteVector(buffer, cep._normalizedPowerPatternFC);
+        WriteVector(buffer, cep._normailzedPowerPatternPollutants);
+        WriteVector(buffer, cep._powerPatternPollutants);
+        WriteVector(buffer, cep._cepCurveFC);
+        WriteVector(buffer, cep._normedCepCurveFC);
+        WriteVector(buffer, cep._gearTransmissionCurve);
+        WriteVector(buffer, cep._speedCurveRotational);
+
+        WriteValue(buffer, (unsigned long long)cep._cepNormalizedCurvePollutants.size());
+        for (std::map<std::string, std::vector<double> >::const_iterator i = cep._cepNormalizedCurvePollutants.begin(); i != cep._cepNormalizedCurvePollutants.end(); ++i) {
+            WriteString(buffer, i->first);
+            WriteVector(buffer, i->second);
+        }
+        WriteValue(buffer, cep._idlingValueFC);
+
+        WriteValue(buffer, (unsigned long long)cep._pollutantIdentifiers.size());
+        for (int i = 0; i < (int)cep._pollutantIdentifiers.size(); i++) {
+            WriteString(buffer, cep._pollutantIdentifiers[i]);
+        }
+        WriteValue(buffer, (unsigned long long)cep._pollutantIndices.size());
+        for (std::map<std::string, int>::const_iterator i = cep._pollutantIndices.begin(); i != cep._pollutantIndices.end(); ++i) {
+            WriteString(buffer, i->first);
+            WriteValue(buffer, i->second);
+        }
+        WriteValue(buffer, cep._pollutantCount);
+        WriteVector(buffer, cep._cepTablePollutants);
+        WriteVector(buffer, cep._idlingValuesPollutants);
+
+        WriteVector(buffer, cep._nNormTable);
+        WriteVector(buffer, cep._dragNormTable);
+    }
+
+    bool CEPCache::ReadCEP(const char*& position, const char* end, CEP& cep) {
+        unsigned char heavyVehicle;
+        int normalizingType;
+        if (!ReadValue(position, end, heavyVehicle)
+                || !ReadString(position, end, cep._fuelType)
+                || !ReadValue(position, end, normalizingType)
+                || !ReadValue(position, end, cep._ratedPower)
+                || !ReadValue(position, end, cep._normalizingPower)
+                || !ReadValue(position, end, cep._drivingPower)
+                || !ReadValue(position, end, cep._driveTrainEfficiency)) {
+            return false;
+        }
+        cep._heavyVehicle = heavyVehicle != 0;
+        cep._normalizingType = static_cast<CEP::NormalizingType>(normalizingType);
+
+        if (!ReadValue(position, end, cep._massVehicle)
+                || !ReadValue(position, end, cep._vehicleLoading)
+                || !ReadValue(position, end, cep._vehicleMassRot)
+                || !ReadValue(position, end, cep._crossSectionalArea)
+                || !ReadValue(position, end, cep._cWValue)
+                || !ReadValue(position, end, cep._resistanceF0)
+                || !ReadValue(position, end, cep._resistanceF1)
+                || !ReadValue(position, end, cep._resistanceF2)
+                || !ReadValue(position, end, cep._resistanceF3)
+                || !ReadValue(position, end, cep._resistanceF4)
+                || !ReadValue(position, end, cep._axleRatio)
+                || !ReadValue(position, end, cep._auxPower)
+                || !ReadValue(position, end, cep._pNormV0)
+                || !ReadValue(position, end, cep._pNormP0)
+                || !ReadValue(position, end, cep._pNormV1)
+                || !ReadValue(position, end, cep._pNormP1)
+                || !ReadValue(position, end, cep._engineRatedSpeed)
+                || !ReadValue(position, end, cep._engineIdlingSpeed)
+                || !ReadValue(position, end, cep._effectiveWheelDiameter)) {
+            return false;
+        }
+
+        if (!ReadVector(position, end, cep._speedPatternRotational)
+                || !ReadVector(position, end, cep._powerPatternFC)
+                || !ReadVector(position, end, cep._normalizedPowerPatternFC)
+                || !ReadVector(position, end, cep._normailzedPowerPatternPollutants)
+                || !ReadVector(position, end, cep._powerPatternPollutants)
+                || !ReadVector(position, end, cep._cepCurveFC)
+                || !ReadVector(position, end, cep._normedCepCurveFC)
+                || !ReadVector(position, end, cep._gearTransmissionCurve)
+                || !ReadVector(position, end, cep._speedCurveRotational)) {
+            return false;
+        }
+
+        unsigned long long count;
+        if (!ReadValue(position, end, count)) {
+            return false;
+        }
+        for (unsigned long long i = 0; i < count; i++) {
+            std::string identifier;
+            std::vector<double> curve;
+            if (!ReadString(position, end, identifier) || !ReadVector(position, end, curve)) {
+                return false;
+            }
+            cep._cepNormalizedCurvePollutants.insert(std::make_pair(identifier, curve));
+        }
+        if (!ReadValue(position, end, cep._idlingValueFC)) {
+            return false;
+        }
+
+        if (!ReadValue(position, end, count)) {
+            return false;
+        }
+        for (unsigned long long i = 0; i < count; i++) {
+            std::string identifier;
+            if (!ReadString(position, end, identifier)) {
+                return false;
+            }
+            cep._pollutantIdentifiers.push_back(identifier);
+        }
+        if (!ReadValue(position, end, count)) {
+            return false;
+        }
+        for (unsigned long long i = 0; i < count; i++) {
+            std::string identifier;
+            int index;
+            if (!ReadString(position, end, identifier) || !ReadValue(position, end, index)) {
+                return false;
+            }
+            cep._pollutantIndices.insert(std::make_pair(identifier, index));
+        }
+        if (!ReadValue(position, end, cep._pollutantCount)
+                || !ReadVector(position, end, cep._cepTablePollutants)
+                || !ReadVector(position, end, cep._idlingValuesPollutants)
+                || !ReadVector(position, end, cep._nNormTable)
+                || !ReadVector(position, end, cep._dragNormTable)) {
+            return false;
+        }
+
+        // sizes the evaluation relies on
+        if (cep._pollutantCount != (int)cep._pollutantIdentifiers.size()
+                || cep._pollutantCount != (int)cep._idlingValuesPollutants.size()
+                || cep._cepTablePollutants.size() != cep._powerPatternPollutants.size() * cep._pollutantCount) {
+            return false;
+        }
+        for (std::map<std::string, int>::const_iterator i = cep._pollutantIndices.begin(); i != cep._pollutantIndices.end(); ++i) {
+            if (i->second < 0 || i->second >= cep._pollutantCount) {
+                return false;
+            }
+        }
+
+        // values derived from the fields above
+        cep.InitializeFuelType();
+        cep.InitializePowerCoefficients();
+        return true;
+    }
+}
@@ -0,0 +1,76 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    CEPCache.h
+/// @author  agent
+/// @date    2026/10/17
+///
+/// Binary image of constructed CEPs, replaces parsing and normalization on later loads.
+//
+/****************************************************************************/
+
+
+#ifndef PHEMlightCEPCACHE
+#define PHEMlightCEPCACHE
+
+#include <string>
+#include <vector>
+
+namespace PHEMlightdll { class CEP; }
+namespace PHEMlightdll { class Helpers; }
+
+
+namespace PHEMlightdll {
+    class CEPCache {
+        //--------------------------------------------------------------------------------------------------
+        // Constructors
+        //--------------------------------------------------------------------------------------------------
+
+    public:
+        CEPCache();
+
+
+        //--------------------------------------------------------------------------------------------------
+        // Members
+        //--------------------------------------------------------------------------------------------------
+
+    private:
+        // directory of the cache files including the trailing separator, empty disables the cache
+        std::string _cachePath;
+    public:
+        const std::string& getCachePath() const;
+        void setCachePath(const std::string& value);
+
+
+        //--------------------------------------------------------------------------------------------------
+        // Methods
+        //--------------------------------------------------------------------------------------------------
+
+    public:
+        // Cached cep of the class, NULL if there is none or a source file, the format or the class
+        // settings changed since it was written
+        CEP* Read(const std::vector<std::string>& DataPath, Helpers* Helper);
+
+        // Stores the cep of the class, a failed write only disables the cache for this class
+        bool Write(const std::vector<std::string>& DataPath, Helpers* Helper, const CEP& cep);
+
+    private:
+        // Paths, sizes and modification times of the source files and the settings the cep depends on
+        bool GetSourceStamp(const std::vector<std::string>& DataPath, Helpers* Helper, std::string& stamp);
+
+        std::string GetFileName(const std::vector<std::string>& DataPath, const std::string& emissionClass);
+
+        void WriteCEP(std::string& buffer, const CEP& cep);
+
+        bool ReadCEP(const char*& position, const char* end, CEP& cep);
+    };
+}
+
+
+#endif	//#ifndef PHEMlightCEPCACHE
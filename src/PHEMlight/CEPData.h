@@ -0,0 +1,117 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    CEPData.h
+/// @author  agent
+/// @date    2026/10/17
+///
+/// Contents of the files of one PHEMlight class, read from disk or compiled in by CEPEmbed.
+//
+/****************************************************************************/
+
+
+#ifndef PHEMlightCEPDATA
+#define PHEMlightCEPDATA
+
+#include <string>
+#include <vector>
+
+
+namespace PHEMlightdll {
+
+    // values of the .PHEMLight.veh, _FC.csv and .csv files as used by the CEP constructor
+    struct CEPData {
+        double vehicleMass;
+        double vehicleLoading;
+        double vehicleMassRot;
+        double crossArea;
+        double cWValue;
+        double f0;
+        double f1;
+        double f2;
+        double f3;
+        double f4;
+        double axleRatio;
+        double auxPower;
+        double ratedPower;
+        double engineIdlingSpeed;
+        double engineRatedSpeed;
+        double effectiveWheelDiameter;
+        double pNormV0;
+        double pNormP0;
+        double pNormV1;
+        double pNormP1;
+        std::vector<double> transmissionGearRatios;
+        std::string vehicleMassType;
+        std::string vehicleFuelType;
+        std::vector<std::vector<double> > matrixSpeedInertiaTable;
+        std::vector<std::vector<double> > normedDragTable;
+
+        std::vector<std::string> headerFC;
+        std::vector<std::vector<double> > matrixFC;
+        std::vector<double> idlingValuesFC;
+
+        std::vector<std::string> headerPollutants;
+        std::vector<std::vector<double> > matrixPollutants;
+        std::vector<double> idlingValuesPollutants;
+    };
+
+    // row major table of a compiled in class
+    struct EmbeddedTable {
+        const double* values;
+        int rows;
+        int columns;
+    };
+
+    // compiled in class, generated as constexpr data by the CEPEmbed tool
+    struct EmbeddedCEP {
+        const char* emissionClass;
+
+        // vehicle file values in the order of CEPData
+        double vehicleMass;
+        double vehicleLoading;
+        double vehicleMassRot;
+        double crossArea;
+        double cWValue;
+        double f0;
+        double f1;
+        double f2;
+        double f3;
+        double f4;
+        double axleRatio;
+        double auxPower;
+        double ratedPower;
+        double engineIdlingSpeed;
+        double engineRatedSpeed;
+        double effectiveWheelDiameter;
+        double pNormV0;
+        double pNormP0;
+        double pNormV1;
+        double pNormP1;
+        EmbeddedTable transmissionGearRatios;
+        const char* vehicleMassType;
+        const char* vehicleFuelType;
+        EmbeddedTable matrixSpeedInertiaTable;
+        EmbeddedTable normedDragTable;
+
+        const char* const* headerFC;
+        EmbeddedTable matrixFC;
+        EmbeddedTable idlingValuesFC;
+
+        const char* const* headerPollutants;
+        EmbeddedTable matrixPollutants;
+        EmbeddedTable idlingValuesPollutants;
+    };
+
+    // class compiled into the library, NULL if it isn't embedded
+    const EmbeddedCEP* FindEmbeddedCEP(const std::string& emissionClass);
+}
+
+
+#endif	//#ifndef PHEMlightCEPDATA
@@ -0,0 +1,40 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    CEPEmbedded.cpp
+/// @author  agent
+/// @date    2026/10/17
+///
+//
+/****************************************************************************/
+
+
+#include "CEPData.h"
+
+// EmbeddedCEPData.h is generated by tools/CEPEmbed.cpp and defines EmbeddedCEPList and EmbeddedCEPCount
+#if defined(PHEMLIGHT_EMBEDDED_CEPS)
+#include "EmbeddedCEPData.h"
+#endif
+
+
+namespace PHEMlightdll {
+
+    const EmbeddedCEP* FindEmbeddedCEP(const std::string& emissionClass) {
+#if defined(PHEMLIGHT_EMBEDDED_CEPS)
+        for (int i = 0; i < EmbeddedData::EmbeddedCEPCount; i++) {
+            if (emissionClass == EmbeddedData::EmbeddedCEPList[i]->emissionClass) {
+                return EmbeddedData::EmbeddedCEPList[i];
+            }
+        }
+#else
+        (void)emissionClass;
+#endif
+        return NULL;
+    }
+}
@@ -22,10 +22,9 @@
 /****************************************************************************/
 
 
-#include <fstream>
-#include <sstream>
 #include "CEPHandler.h"
 #include "CEP.h"
+#include "CEPReader.h"
 #include "Helpers.h"
 #include "Constants.h"
 
@@ -34,12 +33,39 @@ namespace PHEMlightdll {
 
     CEPHandler::CEPHandler() {
         _ceps = std::map<std::string, CEP*>();
+        _cacheHits = 0;
+        _useEmbedded = false;
+        _embeddedHits = 0;
     }
 
     const std::map<std::string, CEP*>& CEPHandler::getCEPS() const {
         return _ceps;
     }
 
+    const std::string& CEPHandler::getCachePath() const {
+        return _cache.getCachePath();
+    }
+
+    void CEPHandler::setCachePath(const std::string& value) {
+        _cache.setCachePath(value);
+    }
+
+    const int& CEPHandler::getCacheHits() const {
+        return _cacheHits;
+    }
+
+    const bool& CEPHandler::getUseEmbedded() const {
+        return _useEmbedded;
+    }
+
+    void CEPHandler::setUseEmbedded(const bool& value) {
+        _useEmbedded = value;
+    }
+
+    const int& CEPHandler::getEmbeddedHits() const {
+        return _embeddedHits;
+    }
+
     bool CEPHandler::GetCEP(const std::vector<std::string>& DataPath, Helpers* Helper) {
         if (getCEPS().find(Helper->getgClass()) == getCEPS().end()) {
             if (!Load(DataPath, Helper)) {
@@ -55,57 +81,101 @@ namespace PHEMlightdll {
 //C# TO C++ CONVERTER TODO TASK: There is no native C++ equivalent to 'ToString':
         std::string emissionRep = Helper->getgClass();
 
+        // class compiled into the library, no file access
+        const EmbeddedCEP* embedded = _useEmbedded ? FindEmbeddedCEP(emissionRep) : NULL;
+        if (embedded != NULL) {
+            CEPData embeddedData;
+            GetEmbeddedData(*embedded, embeddedData);
+            _ceps.insert(std::make_pair(Helper->getgClass(), CreateCEP(embeddedData, Helper)));
+            _embeddedHits++;
+            return true;
+        }
+
+        // cep constructed by an earlier load of unchanged files
+        CEP* cachedCEP = _cache.Read(DataPath, Helper);
+        if (cachedCEP != NULL) {
+            _ceps.insert(std::make_pair(Helper->getgClass(), cachedCEP));
+            _cacheHits++;
+            return true;
+        }
+
         // to hold everything.
-        std::vector<std::vector<double> > matrixSpeedInertiaTable;
-        std::vector<std::vector<double> > normedTragTableSpeedInertiaTable;
-        std::vector<std::vector<double> > matrixFC;
-        std::vector<std::vector<double> > matrixPollutants;
-        std::vector<double> idlingValuesFC;
-        std::vector<double> idlingValuesPollutants;
-        std::vector<std::string> headerFC;
-        std::vector<std::string> headerPollutants;
-
-        double vehicleMass;
-        double vehicleLoading;
-        double vehicleMassRot;
-        double crosssectionalArea;
-        double cwValue;
-        double f0;
-        double f1;
-        double f2;
-        double f3;
-        double f4;
-        double axleRatio;
-        std::vector<double> transmissionGearRatios;
-        double auxPower;
-        double ratedPower;
-        double engineIdlingSpeed;
-        double engineRatedSpeed;
-        double effectiveWhellDiameter;
-        std::string vehicleMassType;
-        std::string vehicleFuelType;
-        double pNormV0;
-        double pNormP0;
-        double pNormV1;
-        double pNormP1;
-
-        if (!ReadVehicleFile(DataPath, emissionRep, Helper, vehicleMass, vehicleLoading, vehicleMassRot, crosssectionalArea, cwValue, f0, f1, f2, f3, f4, axleRatio, auxPower, ratedPower, engineIdlingSpeed, engineRatedSpeed, effectiveWhellDiameter, transmissionGearRatios, vehicleMassType, vehicleFuelType, pNormV0, pNormP0, pNormV1, pNormP1, matrixSpeedInertiaTable, normedTragTableSpeedInertiaTable)) {
+        CEPData data;
+        if (!ReadCEPData(DataPath, Helper, data)) {
             return false;
         }
 
-        if (!ReadEmissionData(true, DataPath, emissionRep, Helper, headerFC, matrixFC, idlingValuesFC)) {
+        CEP* cep = CreateCEP(data, Helper);
+        _ceps.insert(std::make_pair(Helper->getgClass(), cep));
+        _cache.Write(DataPath, Helper, *cep);
+
+        return true;
+    }
+
+    bool CEPHandler::ReadCEPData(const std::vector<std::string>& DataPath, Helpers* Helper, CEPData& data) {
+        std::string emissionRep = Helper->getgClass();
+
+        if (!ReadVehicleFile(DataPath, emissionRep, Helper, data.vehicleMass, data.vehicleLoading, data.vehicleMassRot, data.crossArea, data.cWValue, data.f0, data.f1, data.f2, data.f3, data.f4, data.axleRatio, data.auxPower, data.ratedPower, data.engineIdlingSpeed, data.engineRatedSpeed, data.effectiveWheelDiameter, data.transmissionGearRatios, data.vehicleMassType, data.vehicleFuelType, data.pNormV0, data.pNormP0, data.pNormV1, data.pNormP1, data.matrixSpeedInertiaTable, data.normedDragTable)) {
             return false;
         }
 
-        if (!ReadEmissionData(false, DataPath, emissionRep, Helper, headerPollutants, matrixPollutants, idlingValuesPollutants)) {
+        if (!ReadEmissionData(true, DataPath, emissionRep, Helper, data.headerFC, data.matrixFC, data.idlingValuesFC)) {
             return false;
         }
 
-        _ceps.insert(std::make_pair(Helper->getgClass(), new CEP(vehicleMassType == Constants::HeavyVehicle, vehicleMass, vehicleLoading, vehicleMassRot, crosssectionalArea, cwValue, f0, f1, f2, f3, f4, axleRatio, transmissionGearRatios, auxPower, ratedPower, engineIdlingSpeed, engineRatedSpeed, effectiveWhellDiameter, pNormV0, pNormP0, pNormV1, pNormP1, vehicleFuelType, matrixFC, headerPollutants, matrixPollutants, matrixSpeedInertiaTable, normedTragTableSpeedInertiaTable, idlingValuesFC.front(), idlingValuesPollutants)));
-
+        if (!ReadEmissionData(false, DataPath, emissionRep, Helper, data.headerPollutants, data.matrixPollutants, data.idlingValuesPollutants)) {
+            return false;
+        }
         return true;
     }
 
+    CEP* CEPHandler::CreateCEP(CEPData& data, Helpers* Helper) {
+        return new CEP(data.vehicleMassType == Constants::HeavyVehicle, data.vehicleMass, data.vehicleLoading, data.vehicleMassRot, data.crossArea, data.cWValue, data.f0, data.f1, data.f2, data.f3, data.f4, data.axleRatio, data.transmissionGearRatios, data.auxPower, data.ratedPower, data.engineIdlingSpeed, data.engineRatedSpeed, data.effectiveWheelDiameter, data.pNormV0, data.pNormP0, data.pNormV1, data.pNormP1, data.vehicleFuelType, data.matrixFC, data.headerPollutants, data.matrixPollutants, data.matrixSpeedInertiaTable, data.normedDragTable, data.idlingValuesFC.front(), data.idlingValuesPollutants, Helper->getDriveTrainEfficiency());
+    }
+
+    void CEPHandler::GetEmbeddedData(const EmbeddedCEP& embedded, CEPData& data) {
+        data.vehicleMass = embedded.vehicleMass;
+        data.vehicleLoading = embedded.vehicleLoading;
+        data.vehicleMassRot = embedded.vehicleMassRot;
+        data.crossArea = embedded.crossArea;
+        data.cWValue = embedded.cWValue;
+        data.f0 = embedded.f0;
+        data.f1 = embedded.f1;
+        data.f2 = embedded.f2;
+        data.f3 = embedded.f3;
+        data.f4 = embedded.f4;
+        data.axleRatio = embedded.axleRatio;
+        data.auxPower = embedded.auxPower;
+        data.ratedPower = embedded.ratedPower;
+        data.engineIdlingSpeed = embedded.engineIdlingSpeed;
+        data.engineRatedSpeed = embedded.engineRatedSpeed;
+        data.effectiveWheelDiameter = embedded.effectiveWheelDiameter;
+        data.pNormV0 = embedded.pNormV0;
+        data.pNormP0 = embedded.pNormP0;
+        data.pNormV1 = embedded.pNormV1;
+        data.pNormP1 = embedded.pNormP1;
+        data.transmissionGearRatios.assign(embedded.transmissionGearRatios.values, embedded.transmissionGearRatios.values + embedded.transmissionGearRatios.rows);
+        data.vehicleMassType = embedded.vehicleMassType;
+        data.vehicleFuelType = embedded.vehicleFuelType;
+        GetEmbeddedMatrix(embedded.matrixSpeedInertiaTable, data.matrixSpeedInertiaTable);
+        GetEmbeddedMatrix(embedded.normedDragTable, data.normedDragTable);
+
+        data.headerFC.assign(embedded.headerFC, embedded.headerFC + embedded.matrixFC.columns - 1);
+        GetEmbeddedMatrix(embedded.matrixFC, data.matrixFC);
+        data.idlingValuesFC.assign(embedded.idlingValuesFC.values, embedded.idlingValuesFC.values + embedded.idlingValuesFC.rows);
+
+        data.headerPollutants.assign(embedded.headerPollutants, embedded.headerPollutants + embedded.matrixPollutants.columns - 1);
+        GetEmbeddedMatrix(embedded.matrixPollutants, data.matrixPollutants);
+        data.idlingValuesPollutants.assign(embedded.idlingValuesPollutants.values, embedded.idlingValuesPollutants.values + embedded.idlingValuesPollutants.rows);
+    }
+
+    void CEPHandler::GetEmbeddedMatrix(const EmbeddedTable& table, std::vector<std::vector<double> >& matrix) {
+        matrix.resize(table.rows);
+        for (int i = 0; i < table.rows; i++) {
+            matrix[i].assign(table.values + i * table.columns, table.values + (i + 1) * table.columns);
+        }
+    }
+
     bool CEPHandler::ReadVehicleFile(const std::vector<std::string>& DataPath, const std::string& emissionClass, Helpers* Helper, double& vehicleMass, double& vehicleLoading, double& vehicleMassRot, double& crossArea, double& cWValue, double& f0, double& f1, double& f2, double& f3, double& f4, double& axleRatio, double& auxPower, double& ratedPower, double& engineIdlingSpeed, double& engineRatedSpeed, double& effectiveWheelDiameter, std::vector<double>& transmissionGearRatios, std::string& vehicleMassType, std::string& vehicleFuelType, double& pNormV0, double& pNormP0, double& pNormV1, double& pNormP1, std::vector<std::vector<double> >& matrixSpeedInertiaTable, std::vector<std::vector<double> >& normedDragTable) {
         vehicleMass = 0;
         vehicleLoading = 0;
@@ -132,173 +202,180 @@ namespace PHEMlightdll {
         transmissionGearRatios = std::vector<double>();
         matrixSpeedInertiaTable = std::vector<std::vector<double> >();
         normedDragTable = std::vector<std::vector<double> >();
-        std::string line;
-        std::string cell;
+        std::string_view cell;
+        double value;
         int dataCount = 0;
 
         //Open file
-        std::ifstream vehicleReader;
-        for (std::vector<std::string>::const_iterator i = DataPath.begin(); i != DataPath.end(); i++) {
-            vehicleReader.open(((*i) + emissionClass + ".PHEMLight.veh").c_str());
-            if (vehicleReader.good()) {
-                break;
-            }
-        }
-        if (!vehicleReader.good()) {
+        CEPReader vehicleReader;
+        if (!vehicleReader.Open(DataPath, emissionClass + ".PHEMLight.veh")) {
             Helper->setErrMsg("File does not exist! (" + emissionClass + ".PHEMLight.veh)");
             return false;
         }
 
         // skip header
-        ReadLine(vehicleReader);
+        vehicleReader.ReadLine();
 
-        while ((line = ReadLine(vehicleReader)) != "" && dataCount <= 49) {
-            if (line.substr(0, 1) == Helper->getCommentPrefix()) {
+        while (vehicleReader.ReadLine() && dataCount <= 49) {
+            if (vehicleReader.IsComment(Helper->getCommentPrefix())) {
                 continue;
             }
             else {
                 dataCount++;
             }
 
-            cell = split(line, ',')[0];
+            if (!vehicleReader.NextCell(cell)) {
+                cell = std::string_view();
+            }
+
+            // convert the numeric values that are used, mass and fuel type are text
+            value = 0;
+            if (IsVehicleNumber(dataCount) && !vehicleReader.ToDouble(cell, value)) {
+                Helper->setErrMsg(vehicleReader.getError());
+                return false;
+            }
 
             // reading Mass
             if (dataCount == 1) {
-                vehicleMass = todouble(cell);
+                vehicleMass = value;
             }
 
             // reading vehicle loading
             if (dataCount == 2) {
-                vehicleLoading = todouble(cell);
+                vehicleLoading = value;
             }
 
             // reading cWValue
             if (dataCount == 3) {
-                cWValue = todouble(cell);
+                cWValue = value;
             }
 
             // reading crossectional area
             if (dataCount == 4) {
-                crossArea = todouble(cell);
+                crossArea = value;
             }
 
             // reading vehicle mass rotational
             if (dataCount == 7) {
-                vehicleMassRot = todouble(cell);
+                vehicleMassRot = value;
             }
 
             // reading rated power
             if (dataCount == 9) {
-                auxPower = todouble(cell);
+                auxPower = value;
             }
 
             // reading rated power
             if (dataCount == 10) {
-                ratedPower = todouble(cell);
+                ratedPower = value;
             }
 
             // reading engine rated speed
             if (dataCount == 11) {
-                engineRatedSpeed = todouble(cell);
+                engineRatedSpeed = value;
             }
 
             // reading engine idling speed
             if (dataCount == 12) {
-                engineIdlingSpeed = todouble(cell);
+                engineIdlingSpeed = value;
             }
 
             // reading f0
             if (dataCount == 14) {
-                f0 = todouble(cell);
+                f0 = value;
             }
 
             // reading f1
             if (dataCount == 15) {
-                f1 = todouble(cell);
+                f1 = value;
             }
 
             // reading f2
             if (dataCount == 16) {
-                f2 = todouble(cell);
+                f2 = value;
             }
 
             // reading f3
             if (dataCount == 17) {
-                f3 = todouble(cell);
+                f3 = value;
             }
 
             // reading f4
             if (dataCount == 18) {
-                f4 = todouble(cell);
+                f4 = value;
             }
 
             // reading axleRatio
             if (dataCount == 21) {
-                axleRatio = todouble(cell);
+                axleRatio = value;
             }
 
             // reading effective wheel diameter
             if (dataCount == 22) {
-                effectiveWheelDiameter = todouble(cell);
+                effectiveWheelDiameter = value;
             }
 
             if (dataCount >= 23 && dataCount <= 40) {
-                transmissionGearRatios.push_back(todouble(cell));
+                transmissionGearRatios.push_back(value);
             }
 
             // reading vehicleMassType
             if (dataCount == 45) {
-                vehicleMassType = cell;
+                vehicleMassType = std::string(cell);
             }
 
             // reading vehicleFuelType
             if (dataCount == 46) {
-                vehicleFuelType = cell;
+                vehicleFuelType = std::string(cell);
             }
 
             // reading pNormV0
             if (dataCount == 47) {
-                pNormV0 = todouble(cell);
+                pNormV0 = value;
             }
 
             // reading pNormP0
             if (dataCount == 48) {
-                pNormP0 = todouble(cell);
+                pNormP0 = value;
             }
 
             // reading pNormV1
             if (dataCount == 49) {
-                pNormV1 = todouble(cell);
+                pNormV1 = value;
             }
 
             // reading pNormP1
             if (dataCount == 50) {
-                pNormP1 = todouble(cell);
+                pNormP1 = value;
             }
         }
 
-        while ((line = ReadLine(vehicleReader)) != "" && line.substr(0, 1) != Helper->getCommentPrefix()) {
-            if (line.substr(0, 1) == Helper->getCommentPrefix()) {
-                continue;
+        while (vehicleReader.ReadLine() && !vehicleReader.IsComment(Helper->getCommentPrefix())) {
+            matrixSpeedInertiaTable.push_back(std::vector<double>());
+            if (!vehicleReader.ReadDoubleList(matrixSpeedInertiaTable.back())) {
+                Helper->setErrMsg(vehicleReader.getError());
+                return false;
             }
-
-            matrixSpeedInertiaTable.push_back(todoubleList(split(line, ',')));
         }
 
-        while ((line = ReadLine(vehicleReader)) != "") {
-            if (line.substr(0, 1) == Helper->getCommentPrefix()) {
+        while (vehicleReader.ReadLine()) {
+            if (vehicleReader.IsComment(Helper->getCommentPrefix())) {
                 continue;
             }
 
-            normedDragTable.push_back(todoubleList(split(line, ',')));
+            normedDragTable.push_back(std::vector<double>());
+            if (!vehicleReader.ReadDoubleList(normedDragTable.back())) {
+                Helper->setErrMsg(vehicleReader.getError());
+                return false;
+            }
         }
 
         return true;
     }
 
     bool CEPHandler::ReadEmissionData(bool readFC, const std::vector<std::string>& DataPath, const std::string& emissionClass, Helpers* Helper, std::vector<std::string>& header, std::vector<std::vector<double> >& matrix, std::vector<double>& idlingValues) {
-        // declare file stream
-        std::string line;
+        // declare file reader
+        std::string_view cell;
         header = std::vector<std::string>();
         matrix = std::vector<std::vector<double> >();
         idlingValues = std::vector<double>();
@@ -308,76 +385,75 @@ namespace PHEMlightdll {
             pollutantExtension += std::string("_FC");
         }
 
-        std::ifstream fileReader;
-        for (std::vector<std::string>::const_iterator i = DataPath.begin(); i != DataPath.end(); i++) {
-            fileReader.open(((*i) + emissionClass + pollutantExtension + ".csv").c_str());
-            if (fileReader.good()) {
-                break;
-            }
-        }
-        if (!fileReader.good()) {
+        CEPReader fileReader;
+        if (!fileReader.Open(DataPath, emissionClass + pollutantExtension + ".csv")) {
             Helper->setErrMsg("File does not exist! (" + emissionClass + pollutantExtension + ".csv)");
             return false;
         }
 
         // read header line for pollutant identifiers
-        if ((line = ReadLine(fileReader)) != "") {
-            std::vector<std::string> entries = split(line, ',');
+        if (fileReader.ReadLine()) {
             // skip first entry "Pe"
-            for (int i = 1; i < (int)entries.size(); i++) {
-                header.push_back(entries[i]);
+            fileReader.NextCell(cell);
+            while (fileReader.NextCell(cell)) {
+                header.push_back(std::string(cell));
             }
         }
 
         // skip units
-        ReadLine(fileReader);
+        fileReader.ReadLine();
 
         // skip comment
-        ReadLine(fileReader);
+        fileReader.ReadLine();
 
-        //readIdlingValues
-        line = ReadLine(fileReader);
-
-        std::vector<std::string> stringIdlings = split(line, ',');
-        stringIdlings.erase(stringIdlings.begin());
-
-        idlingValues = todoubleList(stringIdlings);
-
-        while ((line = ReadLine(fileReader)) != "") {
-            matrix.push_back(todoubleList(split(line, ',')));
+        //readIdlingValues, skip first entry "idle"
+        fileReader.ReadLine();
+        fileReader.NextCell(cell);
+        if (!fileReader.ReadDoubleList(idlingValues)) {
+            Helper->setErrMsg(fileReader.getError());
+            return false;
         }
-        return true;
-    }
-
-    std::vector<std::string> CEPHandler::split(const std::string& s, char delim) {
-        std::vector<std::string> elems;
-        std::stringstream ss(s);
-        std::string item;
-        while (std::getline(ss, item, delim)) {
-            elems.push_back(item);
+        if (idlingValues.empty()) {
+            Helper->setErrMsg("No idling values in " + fileReader.getFileName() + " at line " + std::to_string(fileReader.getLineNumber()));
+            return false;
         }
-        return elems;
-    }
-
-    double CEPHandler::todouble(const std::string& s) {
-        std::stringstream ss(s);
-        double item;
-        ss >> item;
-        return item;
-    }
 
-    std::vector<double> CEPHandler::todoubleList(const std::vector<std::string>& s) {
-        std::vector<double> result;
-        for (std::vector<std::string>::const_iterator i = s.begin(); i != s.end(); ++i) {
-            result.push_back(todouble(*i));
+        while (fileReader.ReadLine()) {
+            matrix.push_back(std::vector<double>());
+            if (!fileReader.ReadDoubleList(matrix.back())) {
+                Helper->setErrMsg(fileReader.getError());
+                return false;
+            }
         }
-        return result;
+        return true;
     }
 
-    std::string CEPHandler::ReadLine(std::ifstream& s) {
-        std::string line;
-        std::getline(s, line);
-        line.erase(line.find_last_not_of(" \n\r\t") + 1);
-        return line;
+    bool CEPHandler::IsVehicleNumber(int dataCount) {
+        switch (dataCount) {
+            case 1:
+            case 2:
+            case 3:
+            case 4:
+            case 7:
+            case 9:
+            case 10:
+            case 11:
+            case 12:
+            case 14:
+            case 15:
+            case 16:
+            case 17:
+            case 18:
+            case 21:
+            case 22:
+            case 47:
+            case 48:
+            case 49:
+            case 50:
+                return true;
+            default:
+                // transmission gear ratios
+                return dataCount >= 23 && dataCount <= 40;
+        }
     }
 }
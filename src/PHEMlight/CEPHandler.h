@@ -29,6 +29,8 @@
 #include <map>
 #include <vector>
 #include <utility>
+#include "CEPCache.h"
+#include "CEPData.h"
 
 //C# TO C++ CONVERTER NOTE: Forward class declarations:
 namespace PHEMlightdll { class CEP; }
@@ -53,6 +55,30 @@ namespace PHEMlightdll {
     public:
         const std::map<std::string, CEP*>& getCEPS() const;
 
+    private:
+        // binary images of loaded ceps, disabled without cache path
+        CEPCache _cache;
+    public:
+        const std::string& getCachePath() const;
+        void setCachePath(const std::string& value);
+
+    private:
+        int _cacheHits;
+    public:
+        const int& getCacheHits() const;
+
+    private:
+        // classes compiled into the library are used instead of their files
+        bool _useEmbedded;
+    public:
+        const bool& getUseEmbedded() const;
+        void setUseEmbedded(const bool& value);
+
+    private:
+        int _embeddedHits;
+    public:
+        const int& getEmbeddedHits() const;
+
 
         //--------------------------------------------------------------------------------------------------
         // Methods 
@@ -60,6 +86,9 @@ namespace PHEMlightdll {
 
         bool GetCEP(const std::vector<std::string>& DataPath, Helpers* Helper);
 
+        // Reads the files of the class without constructing the cep
+        bool ReadCEPData(const std::vector<std::string>& DataPath, Helpers* Helper, CEPData& data);
+
 
         //--------------------------------------------------------------------------------------------------
         // Methods 
@@ -68,6 +97,12 @@ namespace PHEMlightdll {
     private:
         bool Load(const std::vector<std::string>& DataPath, Helpers* Helper);
 
+        CEP* CreateCEP(CEPData& data, Helpers* Helper);
+
+        void GetEmbeddedData(const EmbeddedCEP& embedded, CEPData& data);
+
+        void GetEmbeddedMatrix(const EmbeddedTable& table, std::vector<std::vector<double> >& matrix);
+
         bool ReadVehicleFile(const std::vector<std::string>& DataPath, const std::string& emissionClass, Helpers* Helper, double& vehicleMass, double& vehicleLoading, double& vehicleMassRot, double& crossArea, double& cWValue, double& f0, double& f1, double& f2, double& f3, double& f4, double& axleRatio, double& auxPower, double& ratedPower, double& engineIdlingSpeed, double& engineRatedSpeed, double& effectiveWheelDiameter, std::vector<double>& transmissionGearRatios, std::string& vehicleMassType, std::string& vehicleFuelType, double& pNormV0, double& pNormP0, double& pNormV1, double& pNormP1, std::vector<std::vector<double> >& matrixSpeedInertiaTable, std::vector<std::vector<double> >& normedDragTable);
 
         bool ReadEmissionData(bool readFC, const std::vector<std::string>& DataPath, const std::string& emissionClass, Helpers* Helper, std::vector<std::string>& header, std::vector<std::vector<double> >& matrix, std::vector<double>& idlingValues);
@@ -77,17 +112,8 @@ namespace PHEMlightdll {
         // Functions 
         //--------------------------------------------------------------------------------------------------
 
-        //Split the string
-        std::vector<std::string> split(const std::string& s, char delim);
-
-        //Convert string to double
-        double todouble(const std::string& s);
-
-        //Convert string to double list
-        std::vector<double> todoubleList(const std::vector<std::string>& s);
-
-        //Read a line from file
-        std::string ReadLine(std::ifstream& s);
+        //Data lines of the vehicle file converted to numbers
+        bool IsVehicleNumber(int dataCount);
     };
 }
 
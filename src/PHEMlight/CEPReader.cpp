@@ -0,0 +1,258 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    CEPReader.cpp
+/// @author  agent
+/// @date    2026/10/17
+///
+//
+/****************************************************************************/
+
+
+#include <charconv>
+#include <cstring>
+#include "CEPReader.h"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace PHEMlightdll {
+
+    CEPReader::CEPReader() {
+        _data = NULL;
+        _size = 0;
+#if defined(_WIN32)
+        _file = INVALID_HANDLE_VALUE;
+        _mapping = NULL;
+#else
+        _file = -1;
+#endif
+        _next = NULL;
+        _lineBegin = NULL;
+        _lineEnd = NULL;
+        _cell = NULL;
+        _lineNumber = 0;
+    }
+
+    CEPReader::~CEPReader() {
+        Close();
+    }
+
+    const std::string& CEPReader::getFileName() const {
+        return _fileName;
+    }
+
+    int CEPReader::getLineNumber() const {
+        return _lineNumber;
+    }
+
+    const char* CEPReader::getData() const {
+        return _data;
+    }
+
+    size_t CEPReader::getSize() const {
+        return _size;
+    }
+
+    const std::string& CEPReader::getError() const {
+        return _error;
+    }
+
+    bool CEPReader::Open(const std::vector<std::string>& DataPath, const std::string& fileName) {
+        Close();
+        for (std::vector<std::string>::const_iterator i = DataPath.begin(); i != DataPath.end(); i++) {
+            std::string path = (*i) + fileName;
+#if defined(_WIN32)
+            HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+            if (file == INVALID_HANDLE_VALUE) {
+                continue;
+            }
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(file, &size)) {
+                CloseHandle(file);
+                continue;
+            }
+            _file = file;
+            _size = (size_t)size.QuadPart;
+            if (_size > 0) {
+                // empty files can't be mapped
+                _mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+                _data = _mapping != NULL ? (const char*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+                if (_data == NULL) {
+                    Close();
+                    continue;
+                }
+            }
+#else
+            int file = open(path.c_str(), O_RDONLY);
+            if (file < 0) {
+                continue;
+            }
+            struct stat info;
+            if (fstat(file, &info) != 0 || !S_ISREG(info.st_mode)) {
+                close(file);
+                continue;
+            }
+            _file = file;
+            _size = (size_t)info.st_size;
+            if (_size > 0) {
+                // empty files can't be mapped
+                void* data = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, file, 0);
+                if (data == MAP_FAILED) {
+                    Close();
+                    continue;
+                }
+                madvise(data, _size, MADV_SEQUENTIAL);
+                _data = (const char*)data;
+            }
+#endif
+            _fileName = fileName;
+            _next = _data;
+            _lineBegin = _data;
+            _lineEnd = _data;
+            _cell = _data;
+            _lineNumber = 0;
+            return true;
+        }
+        return false;
+    }
+
+    void CEPReader::Close() {
+#if defined(_WIN32)
+        if (_data != NULL) {
+            UnmapViewOfFile(_data);
+        }
+        if (_mapping != NULL) {
+            CloseHandle(_mapping);
+        }
+        if (_file != INVALID_HANDLE_VALUE) {
+            CloseHandle(_file);
+        }
+        _file = INVALID_HANDLE_VALUE;
+        _mapping = NULL;
+#else
+        if (_data != NULL) {
+            munmap((void*)_data, _size);
+        }
+        if (_file >= 0) {
+            close(_file);
+        }
+        _file = -1;
+#endif
+        _data = NULL;
+        _size = 0;
+        _next = NULL;
+        _lineBegin = NULL;
+        _lineEnd = NULL;
+        _cell = NULL;
+    }
+
+    bool CEPReader::ReadLine() {
+        const char* end = _data + _size;
+        _lineNumber++;
+        if (_next >= end) {
+            // end of file reads as empty line
+            _lineBegin = end;
+            _lineEnd = end;
+            _cell = end;
+            return false;
+        }
+
+        const char* lineEnd = (const char*)memchr(_next, '\n', end - _next);
+        if (lineEnd == NULL) {
+            lineEnd = end;
+        }
+        _lineBegin = _next;
+        _next = lineEnd < end ? lineEnd + 1 : end;
+
+        // trailing white space and carriage return are not part of the line
+        while (lineEnd > _lineBegin && (lineEnd[-1] == ' ' || lineEnd[-1] == '\r' || lineEnd[-1] == '\t')) {
+            lineEnd--;
+        }
+        _lineEnd = lineEnd;
+        _cell = _lineBegin;
+        return _lineEnd > _lineBegin;
+    }
+
+    bool CEPReader::IsComment(const std::string& prefix) const {
+        size_t length = _lineEnd > _lineBegin ? 1 : 0;
+        return prefix.size() == length && prefix.compare(0, length, _lineBegin, length) == 0;
+    }
+
+    bool CEPReader::NextCell(std::string_view& cell) {
+        // same cells as splitting with getline, a delimiter at the end starts no further cell
+        if (_cell >= _lineEnd) {
+            return false;
+        }
+        const char* cellEnd = (const char*)memchr(_cell, ',', _lineEnd - _cell);
+        if (cellEnd == NULL) {
+            cellEnd = _lineEnd;
+        }
+        cell = std::string_view(_cell, cellEnd - _cell);
+        _cell = cellEnd < _lineEnd ? cellEnd + 1 : _lineEnd;
+        return true;
+    }
+
+    bool CEPReader::ToDouble(std::string_view cell, double& value) {
+        const char* begin = cell.data();
+        const char* end = begin + cell.size();
+        while (begin < end && (*begin == ' ' || *begin == '\t')) {
+            begin++;
+        }
+        if (end - begin > 1 && begin[0] == '+' && begin[1] != '-') {
+            // from_chars only accepts the minus sign
+            begin++;
+        }
+
+        std::from_chars_result result = std::from_chars(begin, end, value);
+        if (result.ec == std::errc::result_out_of_range) {
+            SetError("Number out of range '" + std::string(cell) + "'", cell.data());
+            return false;
+        }
+
+        const char* rest = result.ptr;
+        while (rest < end && (*rest == ' ' || *rest == '\t')) {
+            rest++;
+        }
+        if (result.ec != std::errc() || rest != end) {
+            SetError("Invalid number '" + std::string(cell) + "'", cell.data());
+            return false;
+        }
+        return true;
+    }
+
+    bool CEPReader::ReadDoubleList(std::vector<double>& values) {
+        std::string_view cell;
+        while (NextCell(cell)) {
+            double value;
+            if (!ToDouble(cell, value)) {
+                return false;
+            }
+            values.push_back(value);
+        }
+        return true;
+    }
+
+    void CEPReader::SetError(const std::string& message, const char* position) {
+        _error = message + " in " + _fileName + " at line " + std::to_string(_lineNumber) + ", column " + std::to_string(position - _lineBegin + 1);
+    }
+}
@@ -0,0 +1,109 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    CEPReader.h
+/// @author  agent
+/// @date    2026/10/17
+///
+/// Memory mapped reader for the comma separated PHEMlight files, cells are views into the file.
+//
+/****************************************************************************/
+
+
+#ifndef PHEMlightCEPREADER
+#define PHEMlightCEPREADER
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace PHEMlightdll {
+    class CEPReader {
+        //--------------------------------------------------------------------------------------------------
+        // Constructors
+        //--------------------------------------------------------------------------------------------------
+
+    public:
+        CEPReader();
+        ~CEPReader();
+
+    private:
+        CEPReader(const CEPReader&);
+        CEPReader& operator=(const CEPReader&);
+
+
+        //--------------------------------------------------------------------------------------------------
+        // Members
+        //--------------------------------------------------------------------------------------------------
+
+    private:
+        // mapped file
+        std::string _fileName;
+        const char* _data;
+        size_t _size;
+#if defined(_WIN32)
+        void* _file;
+        void* _mapping;
+#else
+        int _file;
+#endif
+
+        // current line without trailing white space and the next cell in it
+        const char* _next;
+        const char* _lineBegin;
+        const char* _lineEnd;
+        const char* _cell;
+        int _lineNumber;
+
+        std::string _error;
+    public:
+        const std::string& getFileName() const;
+        int getLineNumber() const;
+
+        // mapped content for binary files
+        const char* getData() const;
+        size_t getSize() const;
+
+        // last conversion error with file, line and column
+        const std::string& getError() const;
+
+
+        //--------------------------------------------------------------------------------------------------
+        // Methods
+        //--------------------------------------------------------------------------------------------------
+
+    public:
+        // Maps the first existing file of DataPath[i] + fileName
+        bool Open(const std::vector<std::string>& DataPath, const std::string& fileName);
+        void Close();
+
+        // Moves to the next line, false if it is empty or the file ends
+        bool ReadLine();
+
+        // Current line starts with the comment prefix
+        bool IsComment(const std::string& prefix) const;
+
+        // Next cell of the current line, false after the last one
+        bool NextCell(std::string_view& cell);
+
+        // Converts a cell of the current line, no allocation
+        bool ToDouble(std::string_view cell, double& value);
+
+        // Converts all remaining cells of the current line
+        bool ReadDoubleList(std::vector<double>& values);
+
+    private:
+        void SetError(const std::string& message, const char* position);
+    };
+}
+
+
+#endif	//#ifndef PHEMlightCEPREADER
@@ -55,13 +55,4 @@ const std::string Constants::strEU = "EU";
 const std::string Constants::strSI = "I";
 const std::string Constants::strSII = "II";
 const std::string Constants::strSIII = "III";
-double Constants::_DRIVE_TRAIN_EFFICIENCY = 0;
-
-    const double& Constants::getDRIVE_TRAIN_EFFICIENCY() {
-        return _DRIVE_TRAIN_EFFICIENCY;
-    }
-
-    void Constants::setDRIVE_TRAIN_EFFICIENCY(const double& value) {
-        _DRIVE_TRAIN_EFFICIENCY = value;
-    }
 }
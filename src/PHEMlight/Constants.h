@@ -74,11 +74,6 @@ namespace PHEMlightdll {
         static const std::string strSIII;
 
 
-        //Drive train efficiency
-        static double _DRIVE_TRAIN_EFFICIENCY;
-        const static double&  getDRIVE_TRAIN_EFFICIENCY();
-        static void setDRIVE_TRAIN_EFFICIENCY(const double&  value);
-
     };
 }
 
@@ -28,6 +28,10 @@
 
 namespace PHEMlightdll {
 
+    Helpers::Helpers() {
+        _driveTrainEfficiency = Constants::DRIVE_TRAIN_EFFICIENCY_All;
+    }
+
     const std::string& Helpers::getvClass() const {
         return _vClass;
     }
@@ -92,9 +96,13 @@ namespace PHEMlightdll {
         _PHEMDataV = value;
     }
 
+    const double& Helpers::getDriveTrainEfficiency() const {
+        return _driveTrainEfficiency;
+    }
+
     bool Helpers::getvclass(const std::string& VEH) {
         // Set the drive train efficency
-        Constants::setDRIVE_TRAIN_EFFICIENCY(Constants::DRIVE_TRAIN_EFFICIENCY_All);
+        _driveTrainEfficiency = Constants::DRIVE_TRAIN_EFFICIENCY_All;
 
         //Get the vehicle class
         if (VEH.find(Constants::strPKW) != std::string::npos) {
@@ -119,7 +127,7 @@ namespace PHEMlightdll {
         }
         else if (VEH.find(Constants::strLB) != std::string::npos) {
             _vClass = Constants::strLB;
-            Constants::setDRIVE_TRAIN_EFFICIENCY(Constants::DRIVE_TRAIN_EFFICIENCY_CB);
+            _driveTrainEfficiency = Constants::DRIVE_TRAIN_EFFICIENCY_CB;
             return true;
         }
         else if (VEH.find(Constants::strMR2) != std::string::npos) {
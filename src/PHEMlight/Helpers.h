@@ -30,6 +30,14 @@
 
 namespace PHEMlightdll {
     class Helpers {
+        //--------------------------------------------------------------------------------------------------
+        // Constructors
+        //--------------------------------------------------------------------------------------------------
+
+    public:
+        Helpers();
+
+
         //--------------------------------------------------------------------------------------------------
         // Members 
         //--------------------------------------------------------------------------------------------------
@@ -73,6 +81,11 @@ namespace PHEMlightdll {
     public:
         const std::string&  getPHEMDataV() const;
         void setPHEMDataV(const std::string& value);
+    private:
+        // set with the vehicle class, coaches have their own value
+        double _driveTrainEfficiency;
+    public:
+        const double&  getDriveTrainEfficiency() const;
 
         //Get vehicle class
     private:
@@ -0,0 +1,262 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    UniformGrid.cpp
+/// @author  agent
+/// @date    2026/10/17
+///
+//
+/****************************************************************************/
+
+
+#include <cmath>
+#include "UniformGrid.h"
+
+
+namespace PHEMlightdll {
+
+    UniformGrid::UniformGrid() {
+        _monotonic = false;
+        _valid = false;
+        _breakpointCount = 0;
+        _columnCount = 0;
+        _size = 0;
+        _start = 0;
+        _end = 0;
+        _inverseStep = 0;
+        _lastCell = 0;
+        _achievedError = 0;
+    }
+
+    const std::string& UniformGrid::getName() const {
+        return _name;
+    }
+
+    const bool& UniformGrid::getMonotonic() const {
+        return _monotonic;
+    }
+
+    const bool& UniformGrid::getValid() const {
+        return _valid;
+    }
+
+    const int& UniformGrid::getBreakpointCount() const {
+        return _breakpointCount;
+    }
+
+    const int& UniformGrid::getColumnCount() const {
+        return _columnCount;
+    }
+
+    const int& UniformGrid::getSize() const {
+        return _size;
+    }
+
+    const double& UniformGrid::getStart() const {
+        return _start;
+    }
+
+    const double& UniformGrid::getEnd() const {
+        return _end;
+    }
+
+    const double& UniformGrid::getInverseStep() const {
+        return _inverseStep;
+    }
+
+    const double& UniformGrid::getLastCell() const {
+        return _lastCell;
+    }
+
+    const double& UniformGrid::getAchievedError() const {
+        return _achievedError;
+    }
+
+    const std::vector<double>& UniformGrid::getValues() const {
+        return _values;
+    }
+
+    bool UniformGrid::IsStrictlyIncreasing(const std::vector<double>& pattern) {
+        for (int i = 1; i < (int)pattern.size(); i++) {
+            if (!(pattern[i - 1] < pattern[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    double UniformGrid::InterpolateOriginal(const std::vector<double>& pattern, const std::vector<double>& values, int columnCount, int column, double x) {
+        int count = (int)pattern.size();
+        if (x <= pattern.front()) {
+            return values[column];
+        }
+        if (x >= pattern.back()) {
+            return values[(count - 1) * columnCount + column];
+        }
+
+        int lowerIndex = 0;
+        int upperIndex = count - 1;
+        while (upperIndex - lowerIndex > 1) {
+            int middleIndex = (upperIndex + lowerIndex) / 2;
+            if (pattern[middleIndex] <= x) {
+                lowerIndex = middleIndex;
+            }
+            else {
+                upperIndex = middleIndex;
+            }
+        }
+
+        double e1 = values[lowerIndex * columnCount + column];
+        double e2 = values[upperIndex * columnCount + column];
+        return e1 + (x - pattern[lowerIndex]) / (pattern[upperIndex] - pattern[lowerIndex]) * (e2 - e1);
+    }
+
+    bool UniformGrid::Build(const std::string& name, const std::vector<double>& pattern, const std::vector<double>& values, int columnCount, double maxRelativeError, int maxSize) {
+        _name = name;
+        _valid = false;
+        _breakpointCount = (int)pattern.size();
+        _columnCount = columnCount;
+        _size = 0;
+        _achievedError = 0;
+        _values = std::vector<double>();
+
+        // the fast path relies on ordered breakpoints and complete columns
+        _monotonic = IsStrictlyIncreasing(pattern);
+        if (!_monotonic || _breakpointCount < 2 || columnCount < 1 || (int)values.size() != _breakpointCount * columnCount) {
+            return false;
+        }
+
+        // scale of each column for the relative error
+        std::vector<double> scale(columnCount, 0.0);
+        for (int i = 0; i < _breakpointCount; i++) {
+            for (int j = 0; j < columnCount; j++) {
+                scale[j] = std::fmax(scale[j], std::fabs(values[i * columnCount + j]));
+            }
+        }
+
+        _start = pattern.front();
+        _end = pattern.back();
+        double end = _end;
+        for (int cells = 16; ; cells *= 2) {
+            _size = cells + 1;
+            _lastCell = cells;
+            _inverseStep = cells / (end - _start);
+
+            // sample the original curve at the grid points
+            _values.assign(_size * columnCount, 0.0);
+            for (int i = 0; i < _size; i++) {
+                double x = i == cells ? end : _start + (end - _start) * i / cells;
+                for (int j = 0; j < columnCount; j++) {
+                    _values[i * columnCount + j] = InterpolateOriginal(pattern, values, columnCount, j, x);
+                }
+            }
+
+            // both curves are piecewise linear and agree on the grid points,
+            // so the largest deviation is found at one of the original breakpoints
+            _achievedError = 0;
+            std::vector<double> approximation(columnCount);
+            for (int i = 0; i < _breakpointCount; i++) {
+                Evaluate(pattern[i], &approximation[0]);
+                for (int j = 0; j < columnCount; j++) {
+                    if (scale[j] > 0) {
+                        _achievedError = std::fmax(_achievedError, std::fabs(approximation[j] - values[i * columnCount + j]) / scale[j]);
+                    }
+                }
+            }
+
+            if (_achievedError <= maxRelativeError) {
+                _valid = true;
+                return true;
+            }
+            if (cells * 2 + 1 > maxSize) {
+                // tolerance not reachable, keep the bisection for this table
+                return false;
+            }
+        }
+    }
+
+    bool UniformGrid::Build(const std::string& name, Function function, const void* context, double start, double end, const std::vector<double>& checkPoints, int columnCount, double maxRelativeError, int maxSize) {
+        _name = name;
+        _valid = false;
+        _columnCount = columnCount;
+        _size = 0;
+        _achievedError = 0;
+        _values = std::vector<double>();
+
+        std::vector<double> points;
+        for (int i = 0; i < (int)checkPoints.size(); i++) {
+            if (checkPoints[i] >= start && checkPoints[i] <= end) {
+                points.push_back(checkPoints[i]);
+            }
+        }
+        _breakpointCount = (int)points.size();
+        _monotonic = start < end;
+        if (!_monotonic || columnCount < 1) {
+            return false;
+        }
+
+        _start = start;
+        _end = end;
+        std::vector<double> exact(columnCount);
+        std::vector<double> approximation(columnCount);
+        for (int cells = 16; ; cells *= 2) {
+            _size = cells + 1;
+            _lastCell = cells;
+            _inverseStep = cells / (end - _start);
+
+            _values.assign(_size * columnCount, 0.0);
+            for (int i = 0; i < _size; i++) {
+                double x = i == cells ? end : _start + (end - _start) * i / cells;
+                function(context, x, &_values[i * columnCount]);
+            }
+
+            // the interior of each cell and the kinks, which may fall between the grid points
+            std::vector<double> scale(columnCount, 0.0);
+            std::vector<double> deviation(columnCount, 0.0);
+            bool finite = true;
+            for (int i = 0; i < cells * CHECKS_PER_CELL + _breakpointCount; i++) {
+                double x;
+                if (i < cells * CHECKS_PER_CELL) {
+                    int cell = i / CHECKS_PER_CELL;
+                    x = _start + (end - _start) * (cell + (double)(i % CHECKS_PER_CELL + 1) / (CHECKS_PER_CELL + 1)) / cells;
+                }
+                else {
+                    x = points[i - cells * CHECKS_PER_CELL];
+                }
+                function(context, x, &exact[0]);
+                Evaluate(x, &approximation[0]);
+                for (int j = 0; j < columnCount; j++) {
+                    finite = finite && std::isfinite(exact[j]) && std::isfinite(approximation[j]);
+                    scale[j] = std::fmax(scale[j], std::fabs(exact[j]));
+                    deviation[j] = std::fmax(deviation[j], std::fabs(approximation[j] - exact[j]));
+                }
+            }
+            if (!finite) {
+                // poles can't be resampled
+                _achievedError = INFINITY;
+                return false;
+            }
+
+            _achievedError = 0;
+            for (int j = 0; j < columnCount; j++) {
+                if (scale[j] > 0) {
+                    _achievedError = std::fmax(_achievedError, deviation[j] / scale[j]);
+                }
+            }
+
+            if (_achievedError <= maxRelativeError) {
+                _valid = true;
+                return true;
+            }
+            if (cells * 2 + 1 > maxSize) {
+                return false;
+            }
+        }
+    }
+}
@@ -0,0 +1,148 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    UniformGrid.h
+/// @author  agent
+/// @date    2026/10/17
+///
+/// Piecewise linear table resampled onto a uniform grid for O(1) lookup.
+//
+/****************************************************************************/
+
+
+#ifndef PHEMlightUNIFORMGRID
+#define PHEMlightUNIFORMGRID
+
+#include <string>
+#include <vector>
+
+
+namespace PHEMlightdll {
+    class UniformGrid {
+        //--------------------------------------------------------------------------------------------------
+        // Constructors
+        //--------------------------------------------------------------------------------------------------
+
+    public:
+        UniformGrid();
+
+
+        //--------------------------------------------------------------------------------------------------
+        // Members
+        //--------------------------------------------------------------------------------------------------
+
+    private:
+        std::string _name;
+        bool _monotonic;
+        bool _valid;
+        int _breakpointCount;
+        int _columnCount;
+        int _size;
+        double _start;
+        double _end;
+        double _inverseStep;
+        double _lastCell;
+        double _achievedError;
+        // interleaved: all columns of one grid point are adjacent
+        std::vector<double> _values;
+
+    public:
+        const std::string& getName() const;
+        const bool& getMonotonic() const;
+        const bool& getValid() const;
+        const int& getBreakpointCount() const;
+        const int& getColumnCount() const;
+        const int& getSize() const;
+        const double& getStart() const;
+        const double& getEnd() const;
+        const double& getInverseStep() const;
+        const double& getLastCell() const;
+        const double& getAchievedError() const;
+        const std::vector<double>& getValues() const;
+
+
+        //--------------------------------------------------------------------------------------------------
+        // Methods
+        //--------------------------------------------------------------------------------------------------
+
+    public:
+        // values of all columns of a sampled function at x, see the second Build
+        typedef void (*Function)(const void* context, double x, double* values);
+
+        // Resamples the table given by its breakpoints and interleaved column values. The grid is refined
+        // until the maximum deviation from the original piecewise linear curve, relative to the largest
+        // absolute value of the column, is below maxRelativeError. Breakpoints must be strictly increasing.
+        bool Build(const std::string& name, const std::vector<double>& pattern, const std::vector<double>& values, int columnCount, double maxRelativeError, int maxSize);
+
+        // Samples a function between start and end. A function is only known at the points it is called
+        // for, so the deviation is measured at the checkPoints (kinks of the function) and at
+        // CHECKS_PER_CELL points inside each cell, relative to the largest absolute value found there.
+        bool Build(const std::string& name, Function function, const void* context, double start, double end, const std::vector<double>& checkPoints, int columnCount, double maxRelativeError, int maxSize);
+
+        // Values outside of the breakpoints are clamped to the first and last entry like the bisection
+        inline void Evaluate(double x, double* values) const {
+            int index;
+            double fraction;
+            Locate(x, index, fraction);
+            const double* lower = &_values[index * _columnCount];
+            const double* upper = lower + _columnCount;
+            for (int i = 0; i < _columnCount; i++) {
+                values[i] = lower[i] + fraction * (upper[i] - lower[i]);
+            }
+        }
+
+        // Evaluates the given columns only, columns out of range are skipped
+        inline void Evaluate(double x, const int* columns, int count, double* values) const {
+            int index;
+            double fraction;
+            Locate(x, index, fraction);
+            const double* lower = &_values[index * _columnCount];
+            const double* upper = lower + _columnCount;
+            for (int i = 0; i < count; i++) {
+                int column = columns[i];
+                if (column >= 0 && column < _columnCount) {
+                    values[i] = lower[column] + fraction * (upper[column] - lower[column]);
+                }
+            }
+        }
+
+        inline double Evaluate(double x, int column) const {
+            int index;
+            double fraction;
+            Locate(x, index, fraction);
+            const double* lower = &_values[index * _columnCount + column];
+            return lower[0] + fraction * (lower[_columnCount] - lower[0]);
+        }
+
+        static bool IsStrictlyIncreasing(const std::vector<double>& pattern);
+
+    private:
+        inline void Locate(double x, int& index, double& fraction) const {
+            double t = (x - _start) * _inverseStep;
+            if (!(t > 0)) {
+                t = 0;
+            }
+            else if (t > _lastCell) {
+                t = _lastCell;
+            }
+            index = (int)t;
+            if (index > _size - 2) {
+                index = _size - 2;
+            }
+            fraction = t - index;
+        }
+
+        static const int CHECKS_PER_CELL = 3;
+
+        static double InterpolateOriginal(const std::vector<double>& pattern, const std::vector<double>& values, int columnCount, int column, double x);
+    };
+}
+
+
+#endif	//#ifndef PHEMlightUNIFORMGRID
@@ -0,0 +1,276 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    CEPEmbed.cpp
+/// @author  agent
+/// @date    2026/10/17
+///
+/// Build tool writing PHEMlight classes as constexpr tables for CEPEmbedded.cpp.
+///
+/// usage: CEPEmbed <data path> <output header> <class> [<class> ...]
+///        e.g. CEPEmbed example/phem_vehicles EmbeddedCEPData.h PC_G_EU4 PC_D_EU4
+///
+/// The header is compiled into the library with PHEMLIGHT_EMBEDDED_CEPS defined and its directory
+/// on the include path, see CMakeLists.txt. The classes are then used without their files.
+//
+/****************************************************************************/
+
+
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../CEPData.h"
+#include "../CEPHandler.h"
+#include "../Helpers.h"
+
+
+namespace PHEMlightdll {
+    class CEPEmbed {
+        //--------------------------------------------------------------------------------------------------
+        // Members
+        //--------------------------------------------------------------------------------------------------
+
+    private:
+        std::ostringstream _output;
+        std::vector<std::string> _names;
+        std::string _error;
+    public:
+        const std::string& getError() const {
+            return _error;
+        }
+
+
+        //--------------------------------------------------------------------------------------------------
+        // Methods
+        //--------------------------------------------------------------------------------------------------
+
+    public:
+        // Reads the files of the class and appends its tables
+        bool AddClass(const std::string& dataPath, const std::string& emissionClass) {
+            Helpers helper;
+            if (!helper.setclass(emissionClass)) {
+                _error = helper.getErrMsg();
+                return false;
+            }
+            helper.setCommentPrefix("c");
+
+            CEPHandler handler;
+            CEPData data;
+            if (!handler.ReadCEPData(std::vector<std::string>(1, dataPath), &helper, data)) {
+                _error = helper.getErrMsg();
+                return false;
+            }
+
+            // the constructor needs rectangular tables and a header entry per value column
+            int columnsFC = (int)data.headerFC.size() + 1;
+            int columnsPollutants = (int)data.headerPollutants.size() + 1;
+            if (!IsRectangular(data.matrixSpeedInertiaTable, 3) || !IsRectangular(data.normedDragTable, 2)
+                    || !IsRectangular(data.matrixFC, columnsFC) || !IsRectangular(data.matrixPollutants, columnsPollutants)) {
+                _error = "Table rows of " + emissionClass + " don't match the header";
+                return false;
+            }
+            if (data.idlingValuesFC.empty() || data.idlingValuesPollutants.size() < data.headerPollutants.size()) {
+                _error = "Idling values of " + emissionClass + " don't match the header";
+                return false;
+            }
+
+            std::string name = "CEP_" + GetIdentifier(emissionClass);
+            _names.push_back(name);
+
+            _output << "        // " << emissionClass << "\n";
+            WriteTable(name + "_transmissionGearRatios", data.transmissionGearRatios);
+            WriteMatrix(name + "_matrixSpeedInertiaTable", data.matrixSpeedInertiaTable);
+            WriteMatrix(name + "_normedDragTable", data.normedDragTable);
+            WriteHeader(name + "_headerFC", data.headerFC);
+            WriteMatrix(name + "_matrixFC", data.matrixFC);
+            WriteTable(name + "_idlingValuesFC", data.idlingValuesFC);
+            WriteHeader(name + "_headerPollutants", data.headerPollutants);
+            WriteMatrix(name + "_matrixPollutants", data.matrixPollutants);
+            WriteTable(name + "_idlingValuesPollutants", data.idlingValuesPollutants);
+
+            _output << "        constexpr EmbeddedCEP " << name << " = {\n";
+            _output << "            " << GetLiteral(emissionClass) << ",\n";
+            const double parameters[] = { data.vehicleMass, data.vehicleLoading, data.vehicleMassRot, data.crossArea, data.cWValue, data.f0, data.f1, data.f2, data.f3, data.f4, data.axleRatio, data.auxPower, data.ratedPower, data.engineIdlingSpeed, data.engineRatedSpeed, data.effectiveWheelDiameter, data.pNormV0, data.pNormP0, data.pNormV1, data.pNormP1 };
+            for (int i = 0; i < (int)(sizeof(parameters) / sizeof(parameters[0])); i++) {
+                _output << "            " << GetNumber(parameters[i]) << ",\n";
+            }
+            _output << "            " << GetTableReference(name + "_transmissionGearRatios", (int)data.transmissionGearRatios.size(), 1) << ",\n";
+            _output << "            " << GetLiteral(data.vehicleMassType) << ",\n";
+            _output << "            " << GetLiteral(data.vehicleFuelType) << ",\n";
+            _output << "            " << GetTableReference(name + "_matrixSpeedInertiaTable", (int)data.matrixSpeedInertiaTable.size(), 3) << ",\n";
+            _output << "            " << GetTableReference(name + "_normedDragTable", (int)data.normedDragTable.size(), 2) << ",\n";
+            _output << "            " << GetHeaderReference(name + "_headerFC", data.headerFC) << ",\n";
+            _output << "            " << GetTableReference(name + "_matrixFC", (int)data.matrixFC.size(), columnsFC) << ",\n";
+            _output << "            " << GetTableReference(name + "_idlingValuesFC", (int)data.idlingValuesFC.size(), 1) << ",\n";
+            _output << "            " << GetHeaderReference(name + "_headerPollutants", data.headerPollutants) << ",\n";
+            _output << "            " << GetTableReference(name + "_matrixPollutants", (int)data.matrixPollutants.size(), columnsPollutants) << ",\n";
+            _output << "            " << GetTableReference(name + "_idlingValuesPollutants", (int)data.idlingValuesPollutants.size(), 1) << "\n";
+            _output << "        };\n\n";
+            return true;
+        }
+
+        bool Write(const std::string& fileName, const std::string& dataPath) {
+            std::ofstream file(fileName.c_str(), std::ios::binary | std::ios::trunc);
+            file << "// generated by CEPEmbed from " << dataPath << ", do not edit\n\n";
+            file << "#ifndef PHEMlightEMBEDDEDCEPDATA\n#define PHEMlightEMBEDDEDCEPDATA\n\n";
+            // included by CEPEmbedded.cpp after CEPData.h, which is not on the path of the generated file
+            file << "#include <limits>\n\n\n";
+            file << "namespace PHEMlightdll {\n    namespace EmbeddedData {\n";
+            file << _output.str();
+            file << "        constexpr const EmbeddedCEP* EmbeddedCEPList[] = {\n";
+            for (int i = 0; i < (int)_names.size(); i++) {
+                file << "            &" << _names[i] << (i + 1 < (int)_names.size() ? ",\n" : "\n");
+            }
+            file << "        };\n";
+            file << "        constexpr int EmbeddedCEPCount = " << _names.size() << ";\n";
+            file << "    }\n}\n\n\n#endif\n";
+            file.close();
+            if (!file) {
+                _error = "Unable to write " + fileName;
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        bool IsRectangular(const std::vector<std::vector<double> >& matrix, int columns) {
+            for (int i = 0; i < (int)matrix.size(); i++) {
+                if ((int)matrix[i].size() != columns) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void WriteTable(const std::string& name, const std::vector<double>& values) {
+            if (values.empty()) {
+                // no zero sized arrays, referenced as NULL
+                return;
+            }
+            _output << "        constexpr double " << name << "[] = {";
+            for (int i = 0; i < (int)values.size(); i++) {
+                _output << (i > 0 ? ", " : " ") << GetNumber(values[i]);
+            }
+            _output << " };\n";
+        }
+
+        void WriteMatrix(const std::string& name, const std::vector<std::vector<double> >& matrix) {
+            if (matrix.empty()) {
+                return;
+            }
+            _output << "        constexpr double " << name << "[] = {\n";
+            for (int i = 0; i < (int)matrix.size(); i++) {
+                _output << "           ";
+                for (int j = 0; j < (int)matrix[i].size(); j++) {
+                    _output << " " << GetNumber(matrix[i][j]) << ",";
+                }
+                _output << "\n";
+            }
+            _output << "        };\n";
+        }
+
+        void WriteHeader(const std::string& name, const std::vector<std::string>& header) {
+            if (header.empty()) {
+                return;
+            }
+            _output << "        constexpr const char* const " << name << "[] = {";
+            for (int i = 0; i < (int)header.size(); i++) {
+                _output << (i > 0 ? ", " : " ") << GetLiteral(header[i]);
+            }
+            _output << " };\n";
+        }
+
+        std::string GetTableReference(const std::string& name, int rows, int columns) {
+            std::ostringstream reference;
+            reference << "{ " << (rows > 0 ? name : std::string("NULL")) << ", " << rows << ", " << columns << " }";
+            return reference.str();
+        }
+
+        std::string GetHeaderReference(const std::string& name, const std::vector<std::string>& header) {
+            return header.empty() ? std::string("NULL") : name;
+        }
+
+        std::string GetNumber(double value) {
+            // the reader accepts inf and nan, which have no literals
+            if (std::isnan(value)) {
+                return "std::numeric_limits<double>::quiet_NaN()";
+            }
+            if (std::isinf(value)) {
+                return value > 0 ? "std::numeric_limits<double>::infinity()" : "-std::numeric_limits<double>::infinity()";
+            }
+
+            // shortest representation restoring the parsed value exactly
+            char buffer[32];
+            std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+            return std::string(buffer, result.ptr);
+        }
+
+        std::string GetLiteral(const std::string& value) {
+            std::string literal = "\"";
+            for (int i = 0; i < (int)value.size(); i++) {
+                unsigned char c = (unsigned char)value[i];
+                if (c == '"' || c == '\\') {
+                    literal += '\\';
+                    literal += (char)c;
+                }
+                else if (c < 32 || c > 126) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\%03o", c);
+                    literal += escaped;
+                }
+                else {
+                    literal += (char)c;
+                }
+            }
+            return literal + "\"";
+        }
+
+        std::string GetIdentifier(const std::string& value) {
+            std::string identifier = value;
+            for (int i = 0; i < (int)identifier.size(); i++) {
+                char c = identifier[i];
+                if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))) {
+                    identifier[i] = '_';
+                }
+            }
+            return identifier;
+        }
+    };
+}
+
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        std::cerr << "usage: CEPEmbed <data path> <output header> <class> [<class> ...]" << std::endl;
+        return 1;
+    }
+
+    std::string dataPath = argv[1];
+    if (dataPath.empty() || (dataPath[dataPath.size() - 1] != '/' && dataPath[dataPath.size() - 1] != '\\')) {
+        dataPath += "/";
+    }
+
+    PHEMlightdll::CEPEmbed embed;
+    for (int i = 3; i < argc; i++) {
+        if (!embed.AddClass(dataPath, argv[i])) {
+            std::cerr << "CEPEmbed: " << embed.getError() << std::endl;
+            return 1;
+        }
+    }
+    if (!embed.Write(argv[2], dataPath)) {
+        std::cerr << "CEPEmbed: " << embed.getError() << std::endl;
+        return 1;
+    }
+    return 0;
+}
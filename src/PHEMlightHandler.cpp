@@ -15,7 +15,10 @@
 //
 /****************************************************************************/
 
+#include <chrono>
+
 #include "PHEMlightHandler.h"
+#include "Tracer.h"
 
 #define DEBUG_PHEM_LIGHT 0
 
@@ -25,64 +28,260 @@ std::ofstream debug_phem_light("phemlight.txt");
 
 #endif
 
-#define PROFILE_PHEM_LIGHT 0
-
-#if PROFILE_PHEM_LIGHT > 0
-
-#include <iostream>
-#include <fstream>
-
-#include <chrono>
-using default_time = std::chrono::nanoseconds;
-
-std::ofstream profile_phem("profile_phem.txt");
-
-#endif
+phem_light_handler::phem_light_handler() : phem_light_handler("Vissim_PHEMlight.cfg")
+{
+}
 
-phem_light_handler::phem_light_handler()
+phem_light_handler::phem_light_handler(const std::string &p_config_path)
 {
+  // config of this handler, read at the first vehicle
+  config_path = p_config_path;
+
   // Initalise cache for faster access
-  cached_emission = NULL;
-  cached_emission_id = -1;
-  cached_vehicle = NULL;
   cached_vehicle_id = -1;
 
   // Initialise PHEMlight helper and cep class and
   helper_init = false;
+  default_helper = NULL;
+  has_default_binding = false;
+
+  simulation_time = -1;
+
+  // all pollutants without LAZY
+  requested_pollutants = ALL_POLLUTANTS;
+  pollutant_generation = 1;
+  lazy_commands = 0;
+  lazy_calculations = 0;
+  lazy_recalculations = 0;
+  lazy_evaluated_pollutants = 0;
+  lazy_skipped_pollutants = 0;
+
+  load_running = false;
+  threads_abandoned = false;
 }
 
 phem_light_handler::~phem_light_handler()
 {
-  cached_emission = NULL;
-  cached_emission_id = -1;
-  cached_vehicle = NULL;
-  cached_vehicle_id = -1;
-
-  for (std::map<long, vehicle *>::iterator iterator_vehicles = vehicles.begin(); iterator_vehicles != vehicles.end(); iterator_vehicles++)
+  // ceps requested by other handlers may be loaded by this one
+  if (!threads_abandoned)
   {
-    delete iterator_vehicles->second;
+    std::unique_lock<std::mutex> lock(load_mutex);
+    load_condition.wait(lock, [this]
+                        { return !load_running; });
   }
 
-  for (std::map<long, emission *>::iterator iterator_emissions = emissions.begin(); iterator_emissions != emissions.end(); iterator_emissions++)
+  if (report.is_open() && !memos.empty())
+  {
+    write_memo_report();
+  }
+  if (report.is_open())
   {
-    delete iterator_emissions->second;
+    write_idle_report();
   }
+  if (report.is_open() && settings.lazy_calculation)
+  {
+    write_lazy_report();
+  }
+  dump_trace();
+
+  cached_vehicle_id = -1;
+  vehicles.clear();
 
   for (std::map<long, PHEMlightdll::Helpers *>::iterator iterator_helpers = helpers.begin(); iterator_helpers != helpers.end(); iterator_helpers++)
   {
     delete iterator_helpers->second;
   }
 
-  for (std::map<long, PHEMlightdll::CEPHandler *>::iterator iterator_cep_handlers = cep_handlers.begin(); iterator_cep_handlers != cep_handlers.end(); iterator_cep_handlers++)
+  delete default_helper;
+
+  // ceps are released when the last handler using them is gone
+  ceps.clear();
+}
+
+void phem_light_handler::init_config()
+{
+  // config is read once, before the first vehicle is bound to a cep
+  if (helper_init == false)
+  {
+    read_config();
+    if (settings.trace)
+    {
+      // the first handler with TRACE sets the sampling for the process
+      tracer::instance().start(settings.trace_sample_rate, settings.trace_size);
+    }
+    start_loading();
+    start_workers();
+    helper_init = true;
+  }
+}
+
+void phem_light_handler::load_config()
+{
+  init_config();
+}
+
+void phem_light_handler::start_loading()
+{
+  // also after a config error, other handlers may wait for ceps requested here
+  unsigned int thread_count = settings.load_thread_count;
+  if (thread_count == 0)
+  {
+    thread_count = std::thread::hardware_concurrency();
+  }
+  if (thread_count > loading.size())
+  {
+    thread_count = (unsigned int)loading.size();
+  }
+
+  loaders.start(thread_count, std::vector<int>());
+  load_running = true;
+  if (!start_detached_thread(&phem_light_handler::load_entry, this, -1))
+  {
+    load_ceps();
+  }
+}
+
+void phem_light_handler::load_entry(void *handler)
+{
+  ((phem_light_handler *)handler)->load_ceps();
+}
+
+void phem_light_handler::load_ceps()
+{
+  // independent classes are parsed in parallel, vehicles only wait for the cep of their type
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  loaders.run(loading.size(), &phem_light_handler::load_cep, this);
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  unsigned int thread_count = loaders.size();
+  loaders.stop();
+
+  if (report.is_open())
+  {
+    // the report is only written here after read_config, no other thread uses it
+    report << "# CEP loading, " << loading.size() << " classes on " << thread_count << " threads in "
+           << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+    write_load_report();
+  }
+
+  // notified under the lock, the destructor may free the handler right after it
+  std::lock_guard<std::mutex> lock(load_mutex);
+  load_running = false;
+  load_condition.notify_all();
+}
+
+void phem_light_handler::load_cep(void *context, size_t chunk, unsigned int worker)
+{
+  (void)worker;
+  phem_light_handler *handler = (phem_light_handler *)context;
+  handler->loading[chunk]->load();
+}
+
+void phem_light_handler::write_load_report()
+{
+  // one line per cep class, classes loaded by other handlers are reported as shared
+  std::set<const cep_entry *> created;
+  for (size_t i = 0; i < loading.size(); i++)
+  {
+    created.insert(loading[i].get());
+  }
+
+  std::vector<const cep_entry *> entries;
+  std::set<const cep_entry *> unique_ceps;
+  for (size_t i = 0; i < ceps.size(); i++)
+  {
+    if (unique_ceps.insert(ceps[i].get()).second)
+    {
+      entries.push_back(ceps[i].get());
+    }
+  }
+
+  report << "# PHEM_CLASS;DATA_PATH;LOAD_MS;STATUS" << std::endl;
+  for (size_t i = 0; i < entries.size(); i++)
+  {
+    const cep_entry *entry = entries[i];
+    bool valid = entry->wait() != NULL;
+    report << entry->get_g_class() << ";" << entry->get_data_path() << ";" << entry->get_load_time() * 1000 << ";";
+    if (!valid)
+    {
+      report << "FAILED (" << entry->get_error() << ")" << std::endl;
+    }
+    else if (created.find(entry) == created.end())
+    {
+      report << "SHARED" << std::endl;
+    }
+    else if (entry->is_embedded())
+    {
+      report << "EMBEDDED" << std::endl;
+    }
+    else if (entry->is_cached())
+    {
+      report << "CACHED" << std::endl;
+    }
+    else
+    {
+      report << "LOADED" << std::endl;
+    }
+  }
+  report << std::endl;
+
+  if (settings.use_uniform_grids)
+  {
+    // report accuracy of the interpolation grids per cep class
+    report << "# Interpolation grids, maximum relative error " << settings.grid_max_error << std::endl;
+    report << "# PHEM_CLASS;TABLE;BREAKPOINTS;GRID_SIZE;ACHIEVED_ERROR;INTERPOLATION" << std::endl;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+      write_grid_report(entries[i]);
+    }
+    report << std::endl;
+  }
+
+  if (settings.deferred_calculation && settings.precision == PHEMlightdll::Batch::Precision_Single)
+  {
+    // deviation of the float kernels from double, relative to the largest value and to the cycle total
+    report << "# Single precision, deviation from double precision over the standard drive cycles" << std::endl;
+    report << "# PHEM_CLASS;CYCLE;OUTPUT;MAX_ERROR;TOTAL_ERROR" << std::endl;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+      write_precision_report(entries[i]);
+    }
+    report << std::endl;
+  }
+  report.flush();
+}
+
+void phem_light_handler::start_workers()
+{
+  unsigned int thread_count = settings.thread_count;
+  if (thread_count == 0)
+  {
+    thread_count = std::thread::hardware_concurrency();
+  }
+  if (!settings.deferred_calculation || thread_count < 1)
+  {
+    // immediate calculation is driven by vissim vehicle by vehicle
+    thread_count = 1;
+  }
+
+  std::vector<int> cores = settings.affinity_cores;
+  if (settings.affinity.compare("COMPACT") == 0)
   {
-    delete iterator_cep_handlers->second;
+    // one core per worker thread, core 0 is left to vissim. Threads beyond the affinity mask
+    // share its cores round robin
+    for (unsigned int i = 1; i < thread_count && i < (unsigned int)worker_pool::core_limit(); i++)
+    {
+      cores.push_back((int)i);
+    }
   }
+
+  workers.start(thread_count, cores);
+  worker_batches.resize(workers.size());
 }
 
 bool phem_light_handler::read_config()
 {
   // define config file input stream
-  ifstream config("Vissim_PHEMlight.cfg");
+  ifstream config(config_path.c_str());
   string line;
   string base_path = "";
   if (config.is_open())
@@ -94,19 +293,36 @@ bool phem_light_handler::read_config()
       if (line.length() > 0 && line[0] != '#')
       {
         // skip lines with "#" at the beginning
-        if (line.find("PATH") != string::npos)
+        if (line.find("=") != string::npos)
         {
-          // line contains "PATH" so base path should be defined
-          base_path = line.substr(line.find("=") + 1);
+          // line contains "=" so a setting should be defined
+          string key = line.substr(0, line.find("="));
+          string value = line.substr(line.find("=") + 1);
 
           // skip empty spaces
-          base_path.erase(0, base_path.find_first_not_of(' '));
-          base_path.erase(base_path.find_last_not_of(' ') + 1);
+          key.erase(0, key.find_first_not_of(' '));
+          key.erase(key.find_last_not_of(' ') + 1);
+          value.erase(0, value.find_first_not_of(' '));
+          value.erase(value.find_last_not_of(" \r") + 1);
 
-          if (base_path.back() != '\\')
+          if (key.compare("PATH") == 0)
+          {
+            // line contains "PATH" so base path should be defined
+            base_path = value;
+
+            if (base_path.empty() || (base_path.back() != '\\' && base_path.back() != '/'))
+            {
+              // check whether the path ends with "\" or "/" if not, append "\" to string
+              base_path += "\\";
+            }
+          }
+          else if (!read_setting(key, value))
           {
-            // check whether the path ends with "\" if not, append "\" to string
-            base_path += "\\";
+// unknown setting or invalid value
+#if DEBUG_PHEM_LIGHT >= 1
+            debug_phem_light << "<ERROR> Invalid setting " << key << " = " << value << " in config." << std::endl;
+#endif
+            return false;
           }
         }
         else
@@ -134,7 +350,6 @@ bool phem_light_handler::read_config()
           // fleet currently not supported
           // helper.setclass nor working
           PHEMlightdll::Helpers *helper = new PHEMlightdll::Helpers();
-          PHEMlightdll::CEPHandler *cep_handler = new PHEMlightdll::CEPHandler();
 
           bool valid = false;
           if (eu_class.substr(0, 2).compare("EU") == 0)
@@ -162,28 +377,53 @@ bool phem_light_handler::read_config()
           helper->seteClass(eu_class);
           helper->setCommentPrefix("c");
 
-          std::vector<std::string> vec = std::vector<std::string>();
-          vec.push_back(base_path);
-          if (!cep_handler->GetCEP(vec, helper))
+          // types of the same class share one cep, loaded in the background after the config
+          cep_options options;
+          options.use_uniform_grids = settings.use_uniform_grids;
+          options.grid_max_error = settings.grid_max_error;
+          options.grid_max_size = settings.grid_max_size;
+          options.instruction_set = settings.instruction_set;
+          // the immediate calculation always uses the double methods of the cep
+          options.precision = settings.deferred_calculation ? settings.precision : PHEMlightdll::Batch::Precision_Double;
+          options.use_embedded = settings.use_embedded;
+          if (settings.cep_cache.compare("SOURCE") == 0)
           {
-// return false if get cep failed
-#if DEBUG_PHEM_LIGHT >= 1
-            debug_phem_light << "<ERROR> While getting cep." << std::endl;
-            debug_phem_light << base_path << std::endl;
-#endif
-            return false;
+            options.cache_path = base_path;
+          }
+          else if (settings.cep_cache.compare("NONE") != 0)
+          {
+            options.cache_path = settings.cep_cache;
+            if (options.cache_path.back() != '\\' && options.cache_path.back() != '/')
+            {
+              // directory separator as for PATH
+              options.cache_path += "\\";
+            }
+          }
+          bool created = false;
+          std::shared_ptr<cep_entry> cep = cep_registry::instance().request(base_path, *helper, options, created);
+          if (created)
+          {
+            loading.push_back(cep);
           }
+          ceps.push_back(cep);
+
+          // cep and class metadata are resolved by the first vehicle of this type
+          cep_binding binding;
+          binding.entry = cep.get();
+          binding.helper = helper;
+
           if (vissim_id == -1)
           {
-            // if vehicle id is -1 the default helper and cep_handler will be set
+            // if vehicle id is -1 the default helper will be set
             default_helper = helper;
-            default_cep_handler = cep_handler;
+            default_binding = binding;
+            has_default_binding = true;
           }
           else
           {
-            // otherwise helper and cep_handler will be added to PHEMlightHandler
+            // otherwise helper will be added to PHEMlightHandler
             create_phemlight_helper(vissim_id, helper);
-            create_phemlight_cep_handlers(vissim_id, cep_handler);
+            bindings.insert(std::pair<long, cep_binding>(vissim_id, binding));
           }
         }
       }
@@ -198,274 +438,726 @@ bool phem_light_handler::read_config()
 #endif
     return false;
   }
-  return true;
-}
-
-bool phem_light_handler::create_phemlight_helper(long id, PHEMlightdll::Helpers *helper)
-{
-#if PROFILE_PHEM_LIGHT > 0
-  auto start = std::chrono::high_resolution_clock::now();
-#endif
-
-  // assume phemlight helper id not existing
-  if (helpers.find(id) == helpers.end())
-  {
-    // no matching id found -> can insert helper
-    // insert helper to map
-    helpers.insert(std::pair<long, PHEMlightdll::Helpers *>(id, helper));
-
-#if PROFILE_PHEM_LIGHT > 0
-    auto end = std::chrono::high_resolution_clock::now();
-    profile_phem << "PHEM_CREATE_HELPER;" << std::chrono::duration_cast<default_time>(end - start).count() << std::endl;
-#endif
-
-    return true;
-  }
-  else
-  {
-// found existing helper for id -> can't insert helper
-#if DEBUG_PHEM_LIGHT >= 1
-    debug_phem_light << "<ERROR> Vehicle with id " << id << " already exists in create_vehicle." << std::endl;
-#endif
-    return false;
-  }
-}
-
-PHEMlightdll::Helpers *phem_light_handler::get_phemlight_helper(long id)
-{
-#if PROFILE_PHEM_LIGHT > 0
-  auto start = std::chrono::high_resolution_clock::now();
-#endif
-
-  // assume id is in helper
-  std::map<long, PHEMlightdll::Helpers *>::iterator element = helpers.find(id);
-  PHEMlightdll::Helpers *helper;
-  if (element == helpers.end())
-  {
-    // no helper for given id found -> return default helper
-    helper = default_helper;
-  }
-  else
-  {
-    helper = element->second;
-  }
-
-#if PROFILE_PHEM_LIGHT > 0
-  auto end = std::chrono::high_resolution_clock::now();
-  profile_phem << "PHEM_GET_HELPER;" << std::chrono::duration_cast<default_time>(end - start).count() << std::endl;
-#endif
-
-  // return helper
-  return helper;
-}
-
-bool phem_light_handler::create_phemlight_cep_handlers(long id, PHEMlightdll::CEPHandler *cep_handler)
-{
-#if PROFILE_PHEM_LIGHT > 0
-  auto start = std::chrono::high_resolution_clock::now();
-#endif
-
-  // assume phemlight handler id not existing
-  if (cep_handlers.find(id) == cep_handlers.end())
-  {
-    // no matching id found -> can insert handler
-    // insert handler to map
-    cep_handlers.insert(std::pair<long, PHEMlightdll::CEPHandler *>(id, cep_handler));
-
-#if PROFILE_PHEM_LIGHT > 0
-    auto end = std::chrono::high_resolution_clock::now();
-    profile_phem << "PHEM_CREATE_CEP_HANDLER;" << std::chrono::duration_cast<default_time>(end - start).count() << std::endl;
-#endif
-
-    return true;
-  }
-  else
-  {
-// found existing handler for id -> can't insert handler
-#if DEBUG_PHEM_LIGHT >= 1
-    debug_phem_light << "<ERROR> Vehicle with id " << id << " already exists in create_vehicle." << std::endl;
-#endif
-    return false;
-  }
-}
-
-PHEMlightdll::CEPHandler *phem_light_handler::get_phemlight_cep_handlers(long id)
-{
-#if PROFILE_PHEM_LIGHT > 0
-  auto start = std::chrono::high_resolution_clock::now();
-#endif
-
-  // assume id is in handler
-  std::map<long, PHEMlightdll::CEPHandler *>::iterator element = cep_handlers.find(id);
-  PHEMlightdll::CEPHandler *cep_handler;
-  if (element == cep_handlers.end())
-  {
-    // no handler for given id found -> return default cep_handler
-    cep_handler = default_cep_handler;
-  }
-  else
-  {
-    cep_handler = element->second;
-  }
-
-#if PROFILE_PHEM_LIGHT > 0
-  auto end = std::chrono::high_resolution_clock::now();
-  profile_phem << "PHEM_GET_CEP_HANDLER;" << std::chrono::duration_cast<default_time>(end - start).count() << std::endl;
-#endif
-
-  // return handler
-  return cep_handler;
-}
-
-bool phem_light_handler::create_vehicle(long id, long type)
-{
-#if PROFILE_PHEM_LIGHT > 0
-  auto start = std::chrono::high_resolution_clock::now();
-#endif
-
-  // assume vehicle id not existing
-  if (vehicles.find(id) == vehicles.end())
-  {
-    // no matching id found -> can insert vehicle
-    vehicle *new_vehicle = new vehicle(type);
-
-    // set cache
-    cached_vehicle = new_vehicle;
-    cached_vehicle_id = id;
-
-    // insert vehicle to map
-    vehicles.insert(std::pair<long, vehicle *>(id, new_vehicle));
-
-#if PROFILE_PHEM_LIGHT > 0
-    auto end = std::chrono::high_resolution_clock::now();
-    profile_phem << "PHEM_CREATE_VEHICLE;" << std::chrono::duration_cast<default_time>(end - start).count() << std::endl;
-#endif
-
-    return true;
-  }
-  else
-  {
-// found existing vehicle id -> can't insert vehicle
-#if DEBUG_PHEM_LIGHT >= 1
-    debug_phem_light << "<ERROR> Vehicle with id " << id << " already exists in create_vehicle." << std::endl;
-#endif
-    return false;
-  }
-}
-
-bool phem_light_handler::destroy_vehicle(long id)
-{
-#if PROFILE_PHEM_LIGHT > 0
-  auto start = std::chrono::high_resolution_clock::now();
-#endif
 
-  // assume vehicle id existing
-  // clear cache
-  if (cached_emission_id == id)
+  if (settings.lazy_calculation)
   {
-    cached_emission_id = -1;
-    cached_emission = NULL;
-  }
-  if (cached_vehicle_id == id)
-  {
-    cached_vehicle_id = -1;
-    cached_vehicle = NULL;
+    // pollutants are requested by the emission model
+    requested_pollutants = 0;
   }
 
-  // check for delete vehicle
-  std::map<long, vehicle *>::iterator vehicles_element = vehicles.find(id);
-  if (vehicles_element == vehicles.end())
+  if (report.is_open())
   {
-// no matching id found -> can't remove vehicle from map
-#if DEBUG_PHEM_LIGHT >= 1
-    debug_phem_light << "<ERROR> No vehicle for id " << id << " found in destroy_vehicle." << std::endl;
-#endif
-    return false;
-  }
+    report << "# Calculation " << (settings.deferred_calculation ? "DEFERRED" : "IMMEDIATE") << ", instruction set "
+           << PHEMlightdll::Batch::GetInstructionSetName(settings.instruction_set) << " (supported "
+           << PHEMlightdll::Batch::GetInstructionSetName(PHEMlightdll::Batch::GetSupportedInstructionSet()) << "), precision "
+           << PHEMlightdll::Batch::GetPrecisionName(settings.deferred_calculation ? settings.precision : PHEMlightdll::Batch::Precision_Double) << std::endl;
+    report << "# Threads " << settings.thread_count << ", affinity " << settings.affinity << std::endl;
+    for (size_t i = 0; i < settings.emission_columns.size(); i++)
+    {
+      report << "# Column " << settings.emission_columns[i].pollutant << " as " << settings.emission_columns[i].type << std::endl;
+    }
 
-  // check for delete emission
-  std::map<long, emission *>::iterator emission_element = emissions.find(id);
-  if (emission_element == emissions.end())
-  {
-// no matching id found -> can't remove vehicle from map
-#if DEBUG_PHEM_LIGHT >= 1
-    debug_phem_light << "<ERROR> No emission for id " << id << " found in destroy_vehicle." << std::endl;
-#endif
-    return false;
+    std::set<const cep_entry *> unique_ceps;
+    for (size_t i = 0; i < ceps.size(); i++)
+    {
+      unique_ceps.insert(ceps[i].get());
+    }
+    report << "# Vehicle types " << ceps.size() << ", CEPs " << unique_ceps.size() << " (process: " << cep_registry::instance().get_request_count()
+           << " requests, " << cep_registry::instance().get_load_count() << " loads)" << std::endl
+           << std::endl;
   }
 
-  // found existing vehicle id -> can remove vehicle from map
-  delete vehicles_element->second;
-  vehicles.erase(id);
-
-  // found existing vehicle id -> can remove vehicle from map
-  delete emission_element->second;
-  emissions.erase(id);
-
-#if PROFILE_PHEM_LIGHT > 0
-  auto end = std::chrono::high_resolution_clock::now();
-  profile_phem << "PHEM_DESTROY_VEHICLE;" << std::chrono::duration_cast<default_time>(end - start).count() << std::endl;
-#endif
-
   return true;
 }
 
-vehicle *phem_light_handler::get_vehicle(long id)
+bool phem_light_handler::read_setting(const std::string &key, const std::string &value)
 {
-#if PROFILE_PHEM_LIGHT > 0
-  auto start = std::chrono::high_resolution_clock::now();
-#endif
-
-  // assume id is in vehicles
-  // check cached vehicle first
-  vehicle *veh;
-  if (cached_vehicle_id == id)
-  {
-    veh = cached_vehicle;
-  }
-  else
+  try
   {
-    std::map<long, vehicle *>::iterator element = vehicles.find(id);
-    if (element == vehicles.end())
+    if (key.compare("INTERPOLATION") == 0)
     {
-// no emission for given id found
-#if DEBUG_PHEM_LIGHT >= 2
-      debug_phem_light << "<ERROR> No vehicle for id " << id << " found in get_vehicle." << std::endl;
-#endif
-      return NULL;
+      if (value.compare("GRID") == 0)
+      {
+        settings.use_uniform_grids = true;
+      }
+      else if (value.compare("BISECTION") == 0)
+      {
+        settings.use_uniform_grids = false;
+      }
+      else
+      {
+        return false;
+      }
     }
-    else
+    else if (key.compare("GRID_MAX_ERROR") == 0)
     {
-      // vehicle for given id exists
-      // update cache
-      cached_vehicle_id = id;
-      cached_vehicle = element->second;
-
-      veh = element->second;
+      settings.grid_max_error = stod(value);
     }
-  }
-
-#if PROFILE_PHEM_LIGHT > 0
-  auto end = std::chrono::high_resolution_clock::now();
-  profile_phem << "PHEM_GET_VEHICLE;" << std::chrono::duration_cast<default_time>(end - start).count() << std::endl;
-#endif
+    else if (key.compare("GRID_MAX_SIZE") == 0)
+    {
+      // the grids start with 16 cells
+      if (stoi(value) < 17)
+      {
+        return false;
+      }
+      settings.grid_max_size = stoi(value);
+    }
+    else if (key.compare("CALCULATION") == 0)
+    {
+      if (value.compare("DEFERRED") == 0)
+      {
+        settings.deferred_calculation = true;
+      }
+      else if (value.compare("IMMEDIATE") == 0)
+      {
+        settings.deferred_calculation = false;
+      }
+      else
+      {
+        return false;
+      }
+    }
+    else if (key.compare("INSTRUCTION_SET") == 0)
+    {
+      if (value.compare("AUTO") == 0)
+      {
+        settings.instruction_set = PHEMlightdll::Batch::GetSupportedInstructionSet();
+      }
+      else if (value.compare("SCALAR") == 0)
+      {
+        settings.instruction_set = PHEMlightdll::Batch::InstructionSet_Scalar;
+      }
+      else if (value.compare("AVX2") == 0)
+      {
+        settings.instruction_set = PHEMlightdll::Batch::InstructionSet_AVX2;
+      }
+      else if (value.compare("AVX512") == 0)
+      {
+        settings.instruction_set = PHEMlightdll::Batch::InstructionSet_AVX512;
+      }
+      else
+      {
+        return false;
+      }
+    }
+    else if (key.compare("PRECISION") == 0)
+    {
+      if (value.compare("DOUBLE") == 0)
+      {
+        settings.precision = PHEMlightdll::Batch::Precision_Double;
+      }
+      else if (value.compare("SINGLE") == 0)
+      {
+        settings.precision = PHEMlightdll::Batch::Precision_Single;
+      }
+      else
+      {
+        return false;
+      }
+    }
+    else if (key.compare("THREADS") == 0)
+    {
+      if (stoi(value) < 0)
+      {
+        return false;
+      }
+      settings.thread_count = (unsigned int)stoi(value);
+    }
+    else if (key.compare("CEP_CACHE") == 0)
+    {
+      if (value.empty())
+      {
+        return false;
+      }
+      settings.cep_cache = value;
+    }
+    else if (key.compare("EMBEDDED") == 0)
+    {
+      if (value.compare("ON") == 0)
+      {
+        settings.use_embedded = true;
+      }
+      else if (value.compare("OFF") == 0)
+      {
+        settings.use_embedded = false;
+      }
+      else
+      {
+        return false;
+      }
+    }
+    else if (key.compare("MEMO") == 0)
+    {
+      if (value.compare("ON") == 0)
+      {
+        settings.use_memo = true;
+      }
+      else if (value.compare("OFF") == 0)
+      {
+        settings.use_memo = false;
+      }
+      else
+      {
+        return false;
+      }
+    }
+    else if (key.compare("MEMO_VELOCITY_STEP") == 0)
+    {
+      if (stod(value) < 0)
+      {
+        return false;
+      }
+      settings.memo_velocity_step = stod(value);
+    }
+    else if (key.compare("MEMO_ACCELERATION_STEP") == 0)
+    {
+      if (stod(value) < 0)
+      {
+        return false;
+      }
+      settings.memo_acceleration_step = stod(value);
+    }
+    else if (key.compare("MEMO_SLOPE_STEP") == 0)
+    {
+      if (stod(value) < 0)
+      {
+        return false;
+      }
+      settings.memo_slope_step = stod(value);
+    }
+    else if (key.compare("MEMO_MAX_SIZE") == 0)
+    {
+      if (stoi(value) < 1)
+      {
+        return false;
+      }
+      settings.memo_max_size = (unsigned int)stoi(value);
+    }
+    else if (key.compare("LOAD_THREADS") == 0)
+    {
+      if (stoi(value) < 0)
+      {
+        return false;
+      }
+      settings.load_thread_count = (unsigned int)stoi(value);
+    }
+    else if (key.compare("AFFINITY") == 0)
+    {
+      // comma separated cores, used round robin by the worker threads. Kept unchanged if one
+      // is invalid or outside of the affinity mask
+      std::vector<int> affinity_cores;
+      if (value.compare("NONE") != 0 && value.compare("COMPACT") != 0)
+      {
+        std::stringstream cores(value);
+        std::string core;
+        while (getline(cores, core, ','))
+        {
+          int index = stoi(core);
+          if (index < 0 || index >= worker_pool::core_limit())
+          {
+            return false;
+          }
+          affinity_cores.push_back(index);
+        }
+      }
+      settings.affinity = value;
+      settings.affinity_cores = affinity_cores;
+    }
+    else if (key.compare(0, 14, "EMISSION_DATA_") == 0)
+    {
+      // cep column read as a vissim type, resolved to its index when a cep is bound
+      if (value.empty())
+      {
+        return false;
+      }
+      size_t column = 0;
+      while (column < settings.emission_columns.size() && settings.emission_columns[column].type.compare(key) != 0)
+      {
+        column++;
+      }
+      if (column == settings.emission_columns.size())
+      {
+        if (column >= (size_t)EMISSION_COLUMN_COUNT)
+        {
+          return false;
+        }
+        settings.emission_columns.push_back(emission_column());
+        settings.emission_columns[column].type = key;
+      }
+      settings.emission_columns[column].pollutant = value;
+    }
+    else if (key.compare("LAZY") == 0)
+    {
+      if (value.compare("ON") == 0)
+      {
+        settings.lazy_calculation = true;
+      }
+      else if (value.compare("OFF") == 0)
+      {
+        settings.lazy_calculation = false;
+      }
+      else
+      {
+        return false;
+      }
+    }
+    else if (key.compare("LAZY_TYPES") == 0)
+    {
+      settings.lazy_types.clear();
+      if (value.compare("AUTO") != 0)
+      {
+        std::stringstream types(value);
+        std::string type;
+        while (getline(types, type, ','))
+        {
+          type.erase(0, type.find_first_not_of(' '));
+          type.erase(type.find_last_not_of(' ') + 1);
+          if (type.compare(0, 14, "EMISSION_DATA_") != 0)
+          {
+            return false;
+          }
+          settings.lazy_types.push_back(type);
+        }
+      }
+    }
+    else if (key.compare("TRACE") == 0)
+    {
+      if (value.compare("ON") == 0)
+      {
+        settings.trace = true;
+      }
+      else if (value.compare("OFF") == 0)
+      {
+        settings.trace = false;
+      }
+      else
+      {
+        return false;
+      }
+    }
+    else if (key.compare("TRACE_SAMPLE") == 0)
+    {
+      if (stoi(value) < 1)
+      {
+        return false;
+      }
+      settings.trace_sample_rate = (unsigned int)stoi(value);
+    }
+    else if (key.compare("TRACE_SIZE") == 0)
+    {
+      if (stoi(value) < 1)
+      {
+        return false;
+      }
+      settings.trace_size = (size_t)stoi(value);
+    }
+    else if (key.compare("TRACE_FILE") == 0)
+    {
+      if (value.empty())
+      {
+        return false;
+      }
+      settings.trace_path = value;
+    }
+    else if (key.compare("REPORT") == 0)
+    {
+      settings.report_path = value;
+      report.close();
+      report.open(settings.report_path.c_str());
+    }
+    else
+    {
+      return false;
+    }
+  }
+  catch (const std::exception &)
+  {
+    // value is not a number
+    return false;
+  }
+  return true;
+}
+
+void phem_light_handler::write_grid_report(const cep_entry *entry)
+{
+  const PHEMlightdll::CEP *cep = entry->wait();
+  if (cep == NULL)
+  {
+    return;
+  }
+
+  std::vector<const PHEMlightdll::UniformGrid *> grids = cep->GetUniformGrids();
+  for (size_t i = 0; i < grids.size(); i++)
+  {
+    const PHEMlightdll::UniformGrid *grid = grids[i];
+    report << entry->get_g_class() << ";" << grid->getName() << ";"
+           << grid->getBreakpointCount() << ";" << grid->getSize() << ";" << grid->getAchievedError() << ";";
+    if (grid->getValid())
+    {
+      report << "GRID" << std::endl;
+    }
+    else if (!grid->getMonotonic())
+    {
+      report << "BISECTION (breakpoints not strictly increasing)" << std::endl;
+    }
+    else
+    {
+      report << "BISECTION (error not reached)" << std::endl;
+    }
+  }
+}
+
+void phem_light_handler::write_precision_report(const cep_entry *entry)
+{
+  if (entry->wait() == NULL)
+  {
+    return;
+  }
+
+  const std::vector<precision_error> &errors = entry->get_precision_errors();
+  for (size_t i = 0; i < errors.size(); i++)
+  {
+    report << entry->get_g_class() << ";" << errors[i].cycle << ";" << errors[i].output << ";"
+           << errors[i].max_error << ";" << errors[i].total_error << std::endl;
+  }
+}
+
+bool phem_light_handler::create_phemlight_helper(long id, PHEMlightdll::Helpers *helper)
+{
+  trace_point trace(TRACE_PHEM_CREATE_HELPER);
+
+  // assume phemlight helper id not existing
+  if (helpers.find(id) == helpers.end())
+  {
+    // no matching id found -> can insert helper
+    // insert helper to map
+    helpers.insert(std::pair<long, PHEMlightdll::Helpers *>(id, helper));
+
+    trace.stop();
+    return true;
+  }
+  else
+  {
+// found existing helper for id -> can't insert helper
+#if DEBUG_PHEM_LIGHT >= 1
+    debug_phem_light << "<ERROR> Vehicle with id " << id << " already exists in create_vehicle." << std::endl;
+#endif
+    return false;
+  }
+}
+
+bool phem_light_handler::create_cep_binding(PHEMlightdll::Helpers *helper, const PHEMlightdll::CEP *cep, cep_binding &binding)
+{
+  if (cep == NULL)
+  {
+// no entry in CEPS found
+#if DEBUG_PHEM_LIGHT >= 1
+    debug_phem_light << "<Error> No CEPS found for " << helper->getgClass() << "." << std::endl;
+#endif
+    return false;
+  }
+
+  // grids and instruction set are prepared by the registry
+  binding.cep = cep;
+  binding.helper = helper;
+  binding.is_bev = helper->gettClass() == PHEMlightdll::Constants::strBEV;
+  binding.driving_power = binding.cep->getDrivingPower();
+  binding.rated_power = binding.cep->getRatedPower();
+  binding.pollutant_indices[POLLUTANT_FC] = PHEMlightdll::CEP::PollutantIndexFC;
+  binding.pollutant_indices[POLLUTANT_CO] = binding.cep->GetPollutantIndex("CO");
+  binding.pollutant_indices[POLLUTANT_HC] = binding.cep->GetPollutantIndex("HC");
+  binding.pollutant_indices[POLLUTANT_NOX] = binding.cep->GetPollutantIndex("NOx");
+  binding.pollutant_indices[POLLUTANT_PM] = binding.cep->GetPollutantIndex("PM");
+
+  // configured columns are evaluated with the other pollutants, columns missing in this cep stay 0
+  binding.pollutant_count = POLLUTANT_COUNT;
+  for (size_t i = 0; i < settings.emission_columns.size(); i++)
+  {
+    int index = binding.cep->GetPollutantIndex(settings.emission_columns[i].pollutant);
+    if (index != PHEMlightdll::CEP::PollutantIndexUnknown)
+    {
+      binding.column_slots[binding.pollutant_count - POLLUTANT_COUNT] = (int)i;
+      binding.pollutant_indices[binding.pollutant_count] = index;
+      binding.pollutant_count++;
+    }
+  }
+  select_pollutants(binding);
+
+  // unknown pollutants and an unknown fuel type for co2 set error messages on the shared helper,
+  // BEV only uses the fuel consumption
+  binding.concurrent = binding.is_bev || binding.cep->getFuelTypeKnown();
+  for (int i = 0; i < POLLUTANT_COUNT && !binding.is_bev; i++)
+  {
+    if (binding.pollutant_indices[i] == PHEMlightdll::CEP::PollutantIndexUnknown)
+    {
+      binding.concurrent = false;
+    }
+  }
+  return true;
+}
+
+bool phem_light_handler::resolve_cep_binding(cep_binding &binding)
+{
+  if (!binding.resolved)
+  {
+    // blocks only if the cep of this type is still being loaded
+    const PHEMlightdll::CEP *cep = binding.entry->wait();
+    if (cep == NULL)
+    {
+      binding.helper->setErrMsg(binding.entry->get_error());
+#if DEBUG_PHEM_LIGHT >= 1
+      debug_phem_light << "<ERROR> While getting cep " << binding.entry->get_g_class() << ": " << binding.entry->get_error() << std::endl;
+      debug_phem_light << binding.entry->get_data_path() << std::endl;
+#endif
+    }
+    else if (!create_cep_binding(binding.helper, cep, binding))
+    {
+      binding.cep = NULL;
+    }
+    else
+    {
+      // standing vehicle, computed once as for any other vehicle
+      vehicle idle_vehicle;
+      idle_vehicle.binding = &binding;
+      calculate_vehicle_emission(&idle_vehicle, &binding.idle_emission);
+
+      if (settings.use_memo)
+      {
+        binding.memo = get_memo(cep);
+      }
+    }
+    binding.resolved = true;
+  }
+  return binding.cep != NULL;
+}
+
+void phem_light_handler::select_pollutants(cep_binding &binding)
+{
+  // pollutants of the binding in the requested set, all of them without LAZY
+  binding.evaluated_count = 0;
+  for (int i = 0; i < binding.pollutant_count; i++)
+  {
+    int bit = i < POLLUTANT_COUNT ? i : POLLUTANT_COUNT + binding.column_slots[i - POLLUTANT_COUNT];
+    if (requested_pollutants & (1u << bit))
+    {
+      binding.evaluated_indices[binding.evaluated_count] = binding.pollutant_indices[i];
+      binding.evaluated_positions[binding.evaluated_count] = i;
+      binding.evaluated_count++;
+    }
+  }
+}
+
+emission_memo *phem_light_handler::get_memo(const PHEMlightdll::CEP *cep)
+{
+  std::unique_ptr<emission_memo> &memo = memos[cep];
+  if (!memo)
+  {
+    memo.reset(new emission_memo(settings.memo_velocity_step, settings.memo_acceleration_step, settings.memo_slope_step, settings.memo_max_size));
+  }
+  return memo.get();
+}
+
+void phem_light_handler::write_memo_report()
+{
+  report << "# Memo, steps velocity " << settings.memo_velocity_step << " acceleration " << settings.memo_acceleration_step << " slope "
+         << settings.memo_slope_step << ", max size " << settings.memo_max_size << std::endl;
+  report << "# PHEM_CLASS;HITS;MISSES;HIT_RATE;SIZE;CLEARS" << std::endl;
+  std::set<const emission_memo *> written;
+  for (size_t i = 0; i < ceps.size(); i++)
+  {
+    // one line per cep, types of the same class share the memo
+    const PHEMlightdll::CEP *cep = ceps[i]->is_loaded() ? ceps[i]->wait() : NULL;
+    std::map<const PHEMlightdll::CEP *, std::unique_ptr<emission_memo> >::iterator element = memos.find(cep);
+    if (element == memos.end() || !written.insert(element->second.get()).second)
+    {
+      continue;
+    }
+    const emission_memo *memo = element->second.get();
+    unsigned long long requests = memo->get_hit_count() + memo->get_miss_count();
+    report << ceps[i]->get_g_class() << ";" << memo->get_hit_count() << ";" << memo->get_miss_count() << ";"
+           << (requests > 0 ? (double)memo->get_hit_count() / requests : 0) << ";" << memo->size() << ";" << memo->get_clear_count() << std::endl;
+  }
+  report << std::endl;
+  report.flush();
+}
+
+void phem_light_handler::write_lazy_report()
+{
+  report << "# Lazy calculation, types ";
+  if (settings.lazy_types.empty())
+  {
+    report << "AUTO";
+  }
+  for (size_t i = 0; i < settings.lazy_types.size(); i++)
+  {
+    report << (i > 0 ? "," : "") << settings.lazy_types[i];
+  }
+  report << std::endl;
+  report << "# CALCULATE_COMMANDS;CALCULATED;SKIPPED;RECALCULATED;POLLUTANTS_EVALUATED;POLLUTANTS_SKIPPED" << std::endl;
+  report << lazy_commands << ";" << lazy_calculations << ";" << lazy_commands - lazy_calculations << ";" << lazy_recalculations << ";"
+         << lazy_evaluated_pollutants << ";" << lazy_skipped_pollutants << std::endl;
+  report << std::endl;
+  report.flush();
+}
+
+void phem_light_handler::write_idle_report()
+{
+  std::vector<long> types;
+  vehicles.get_idle_types(types);
+  if (types.empty())
+  {
+    return;
+  }
+  report << "# Standing vehicles, most at the same time per vissim type" << std::endl;
+  report << "# VISSIM_TYPE;PEAK" << std::endl;
+  for (size_t i = 0; i < types.size(); i++)
+  {
+    report << types[i] << ";" << vehicles.get_idle_peak(types[i]) << std::endl;
+  }
+  report << std::endl;
+  report.flush();
+}
+
+const cep_binding *phem_light_handler::get_cep_binding(long type)
+{
+  std::map<long, cep_binding>::iterator element = bindings.find(type);
+  if (element != bindings.end())
+  {
+    return resolve_cep_binding(element->second) ? &element->second : NULL;
+  }
+
+  // no binding for given type found -> fall back to default
+  if (has_default_binding)
+  {
+    return resolve_cep_binding(default_binding) ? &default_binding : NULL;
+  }
+  return NULL;
+}
+
+bool phem_light_handler::find_vehicle(long id, vehicle_handle &handle)
+{
+  // check cached vehicle first, the generation check rejects reused slots
+  if (cached_vehicle_id == id && vehicles.is_valid(cached_handle))
+  {
+    handle = cached_handle;
+    return true;
+  }
+
+  if (!vehicles.find(id, handle))
+  {
+    return false;
+  }
+
+  // update cache
+  cached_vehicle_id = id;
+  cached_handle = handle;
+  return true;
+}
+
+bool phem_light_handler::create_vehicle(long id, long type)
+{
+  trace_point trace(TRACE_PHEM_CREATE_VEHICLE);
+
+  init_config();
+
+  // assume vehicle id not existing
+  vehicle_handle handle;
+  if (vehicles.create(id, type, handle))
+  {
+    // bind the cep of the vehicle type once, unknown types use the default
+    vehicles.get_vehicle(handle)->binding = get_cep_binding(type);
+#if DEBUG_PHEM_LIGHT >= 1
+    if (vehicles.get_vehicle(handle)->binding == NULL)
+    {
+      debug_phem_light << "<ERROR> No cep for type " << type << " and no DEFAULT in create_vehicle." << std::endl;
+    }
+#endif
+
+    // set cache
+    cached_vehicle_id = id;
+    cached_handle = handle;
+
+    trace.stop();
+    return true;
+  }
+  else
+  {
+// found existing vehicle id -> can't insert vehicle
+#if DEBUG_PHEM_LIGHT >= 1
+    debug_phem_light << "<ERROR> Vehicle with id " << id << " already exists in create_vehicle." << std::endl;
+#endif
+    return false;
+  }
+}
+
+bool phem_light_handler::destroy_vehicle(long id)
+{
+  trace_point trace(TRACE_PHEM_DESTROY_VEHICLE);
+
+  // assume vehicle id existing
+  // the slot is freed and its generation bumped, so the cache needs no clearing
+  if (!vehicles.destroy(id))
+  {
+// no matching id found -> can't remove vehicle
+#if DEBUG_PHEM_LIGHT >= 1
+    debug_phem_light << "<ERROR> No vehicle for id " << id << " found in destroy_vehicle." << std::endl;
+#endif
+    return false;
+  }
+
+  trace.stop();
+  return true;
+}
+
+vehicle *phem_light_handler::get_vehicle(long id)
+{
+  trace_point trace(TRACE_PHEM_GET_VEHICLE);
+
+  // assume id is in vehicles
+  vehicle_handle handle;
+  if (!find_vehicle(id, handle))
+  {
+// no vehicle for given id found
+#if DEBUG_PHEM_LIGHT >= 2
+    debug_phem_light << "<ERROR> No vehicle for id " << id << " found in get_vehicle." << std::endl;
+#endif
+    return NULL;
+  }
+  vehicle *veh = vehicles.get_vehicle(handle);
 
+  trace.stop();
   // return vehicle
   return veh;
 }
 
-emission *phem_light_handler::calculate_vehicle_emission(vehicle *veh)
+static const double *expand_pollutants(const cep_binding *binding, const double *evaluated, double *values)
 {
-#if PROFILE_PHEM_LIGHT > 0
-  auto start = std::chrono::high_resolution_clock::now();
-#endif
+  // values ordered as the pollutant indices of the binding, 0 for the pollutants skipped with LAZY
+  if (binding->evaluated_count == binding->pollutant_count)
+  {
+    return evaluated;
+  }
+  for (int i = 0; i < binding->pollutant_count; i++)
+  {
+    values[i] = 0;
+  }
+  for (int i = 0; i < binding->evaluated_count; i++)
+  {
+    values[binding->evaluated_positions[i]] = evaluated[i];
+  }
+  return values;
+}
+
+bool phem_light_handler::calculate_vehicle_emission(const vehicle *veh, emission *emis)
+{
+  trace_point trace(TRACE_PHEM_CALC_EMISSION);
 
-  PHEMlightdll::Helpers *helper = get_phemlight_helper(veh->type);
-  PHEMlightdll::CEPHandler *cep_handler = get_phemlight_cep_handlers(veh->type);
-  if (cep_handler->getCEPS().find(helper->getgClass()) != cep_handler->getCEPS().end())
+  const cep_binding *binding = veh->binding;
+  if (binding != NULL)
   {
-    // CEPS found
-    PHEMlightdll::CEP *cep = cep_handler->getCEPS().find(helper->getgClass())->second;
+    // CEPS bound at vehicle creation
+    const PHEMlightdll::CEP *cep = binding->cep;
+    PHEMlightdll::Helpers *helper = binding->helper;
 
     /***
     * Actually from PHEMlight cs code in starter.
@@ -473,39 +1165,55 @@ emission *phem_light_handler::calculate_vehicle_emission(vehicle *veh)
     ***/
     double time = veh->timestep;
     double gradient = veh->slope;
+    double input_velocity = veh->velocity;
+    double input_acceleration = veh->acceleration;
+
+    // vehicles in the same state share one evaluation, computed at the center of the cell
+    emission_memo *memo = binding->memo;
+    memo_key key;
+    if (memo != NULL)
+    {
+      key = memo->quantize(input_velocity, input_acceleration, gradient);
+      const emission *memo_emis = memo->find(key);
+      if (memo_emis != NULL)
+      {
+        *emis = *memo_emis;
+        trace.stop();
+        return true;
+      }
+    }
 
     // set speed and acceleration with limitations
     double velocity = 0;
-    if (veh->velocity > 0)
+    if (input_velocity > 0)
     {
-      velocity = veh->velocity;
+      velocity = input_velocity;
     }
-    double acceleration = veh->acceleration;
+    double acceleration = input_acceleration;
     if (velocity == 0)
     {
       acceleration = 0;
     }
-    else if (acceleration > cep->GetMaxAccel(velocity, gradient))
+    else
     {
-      acceleration = cep->GetMaxAccel(velocity, gradient);
+      double max_acceleration = cep->GetMaxAccel(velocity, gradient);
+      if (acceleration > max_acceleration)
+      {
+        acceleration = max_acceleration;
+      }
     }
 
     // calculate the power
     double power = cep->CalcPower(velocity, acceleration, gradient);
     double energie = cep->CalcEngPower(power);
 
-    emission *emis = new emission(0.0);
+    // write result in place into the emission row of the vehicle
     // calculate result if BEV
-    if (helper->gettClass() == PHEMlightdll::Constants::strBEV)
+    if (binding->is_bev)
     {
-      emis->fuel_consumption = cep->GetEmission("FC", power, velocity, helper) / 3600.0;
-      emis->norm_drive = energie / cep->getDrivingPower();
-      emis->norm_rated = energie / cep->getRatedPower();
-      emis->co = 0;
-      emis->co2 = 0;
-      emis->hc = 0;
-      emis->nox = 0;
-      emis->pm = 0;
+      double values[POLLUTANT_COUNT + EMISSION_COLUMN_COUNT];
+      values[POLLUTANT_FC] = cep->GetEmission(binding->pollutant_indices[POLLUTANT_FC], power, velocity, helper);
+      write_vehicle_emission(binding, energie, values, emis);
     }
     else
     {
@@ -514,169 +1222,596 @@ emission *phem_light_handler::calculate_vehicle_emission(vehicle *veh)
       // calculate the result values (zero emissions by costing, idling emissions by v <= 0.5m/s�)
       if (acceleration >= decel_coast || velocity <= PHEMlightdll::Constants::ZERO_SPEED_ACCURACY)
       {
-        double fuel_consumption = cep->GetEmission("FC", power, velocity, helper);
-        emis->norm_drive = energie / cep->getDrivingPower();
-        emis->norm_rated = energie / cep->getRatedPower();
-        double co = cep->GetEmission("CO", power, velocity, helper);
-        double hc = cep->GetEmission("HC", power, velocity, helper);
-        double nox = cep->GetEmission("NOx", power, velocity, helper);
-        double pm = cep->GetEmission("PM", power, velocity, helper);
-        emis->co2 = cep->GetCO2Emission(fuel_consumption, co, hc, helper) / 3600.0;
-        emis->fuel_consumption = fuel_consumption / 3600.0;
-        emis->co = co / 3600.0;
-        emis->hc = hc / 3600.0;
-        emis->nox = nox / 3600.0;
-        emis->pm = pm / 3600.0;
+        // all requested pollutants with one search in the power pattern
+        double evaluated[POLLUTANT_COUNT + EMISSION_COLUMN_COUNT];
+        double values[POLLUTANT_COUNT + EMISSION_COLUMN_COUNT];
+        cep->GetEmissions(binding->evaluated_indices, binding->evaluated_count, power, velocity, evaluated, helper);
+        write_vehicle_emission(binding, energie, expand_pollutants(binding, evaluated, values), emis);
       }
       else
       {
-        emis->fuel_consumption = 0;
-        emis->norm_drive = energie / cep->getDrivingPower();
-        emis->norm_rated = energie / cep->getRatedPower();
-        emis->co = 0;
-        emis->co2 = 0;
-        emis->hc = 0;
-        emis->nox = 0;
-        emis->pm = 0;
+        write_vehicle_emission(binding, energie, NULL, emis);
       }
     }
 
+    if (memo != NULL)
+    {
+      memo->insert(key, *emis);
+    }
+
 #if DEBUG_PHEM_LIGHT >= 2
     debug_phem_light << "<MSG> Calculation Done. Calculated FC " << emis->fuel_consumption << " ND " << emis->norm_drive << " NDR " << emis->norm_rated
                      << " CO " << emis->co << " CO2 " << emis->co2 << " HC " << emis->hc << " NOx " << emis->nox << " PM " << emis->pm << std::endl;
 #endif
 
-#if PROFILE_PHEM_LIGHT > 0
-    auto end = std::chrono::high_resolution_clock::now();
-    profile_phem << "PHEM_CALC_EMISSION;" << std::chrono::duration_cast<default_time>(end - start).count() << std::endl;
-#endif
-
-    return emis;
+    trace.stop();
+    return true;
   }
   else
   {
 // no entry in CEPS found
 #if DEBUG_PHEM_LIGHT >= 1
-    debug_phem_light << "<Error> No CEPS found." << std::endl;
+    debug_phem_light << "<Error> No CEPS bound to vehicle." << std::endl;
 #endif
-    return NULL;
+    return false;
   }
 }
 
-bool phem_light_handler::calculate_vehicle_emission(long id)
+void phem_light_handler::write_vehicle_emission(const cep_binding *binding, double energie, const double *values, emission *emis)
 {
-#if PROFILE_PHEM_LIGHT > 0
-  auto start = std::chrono::high_resolution_clock::now();
-#endif
-
-  if (helper_init == false)
+  // values ordered as the pollutant indices of the binding, BEV only needs POLLUTANT_FC, NULL for
+  // coasting vehicles
+  if (binding->is_bev)
   {
-    read_config();
-    helper_init = true;
+    emis->fuel_consumption = values[POLLUTANT_FC] / 3600.0;
+    emis->norm_drive = energie / binding->driving_power;
+    emis->norm_rated = energie / binding->rated_power;
+    emis->co = 0;
+    emis->co2 = 0;
+    emis->hc = 0;
+    emis->nox = 0;
+    emis->pm = 0;
   }
-  // free emission object if necessary and set new one
-  // check cached vehicle first
-  vehicle *veh = NULL;
-  if (cached_vehicle_id == id)
+  else if (values != NULL)
   {
-    veh = cached_vehicle;
+    double fuel_consumption = values[POLLUTANT_FC];
+    emis->norm_drive = energie / binding->driving_power;
+    emis->norm_rated = energie / binding->rated_power;
+    double co = values[POLLUTANT_CO];
+    double hc = values[POLLUTANT_HC];
+    double nox = values[POLLUTANT_NOX];
+    double pm = values[POLLUTANT_PM];
+    emis->co2 = binding->cep->GetCO2Emission(fuel_consumption, co, hc, binding->helper) / 3600.0;
+    emis->fuel_consumption = fuel_consumption / 3600.0;
+    emis->co = co / 3600.0;
+    emis->hc = hc / 3600.0;
+    emis->nox = nox / 3600.0;
+    emis->pm = pm / 3600.0;
   }
   else
   {
-    std::map<long, vehicle *>::iterator element = vehicles.find(id);
-    if (element == vehicles.end())
+    emis->fuel_consumption = 0;
+    emis->norm_drive = energie / binding->driving_power;
+    emis->norm_rated = energie / binding->rated_power;
+    emis->co = 0;
+    emis->co2 = 0;
+    emis->hc = 0;
+    emis->nox = 0;
+    emis->pm = 0;
+  }
+
+  // configured columns, 0 for BEV, coasting vehicles and columns missing in the cep
+  for (size_t i = 0; i < settings.emission_columns.size(); i++)
+  {
+    emis->columns[i] = 0;
+  }
+  if (values != NULL && !binding->is_bev)
+  {
+    for (int i = POLLUTANT_COUNT; i < binding->pollutant_count; i++)
     {
-// no vehicle for given id found
-#if DEBUG_PHEM_LIGHT >= 1
-      debug_phem_light << "<ERROR> No vehicle for id " << id << " found in calculate_vehicle_emission." << std::endl;
-#endif
-      return false;
+      emis->columns[binding->column_slots[i - POLLUTANT_COUNT]] = values[i] / 3600.0;
     }
-    else
+  }
+}
+
+static bool pending_before(const pending_calculation &a, const pending_calculation &b)
+{
+  // group by cep binding and vehicle, repeated calculate commands of a vehicle in command order
+  if (a.binding != b.binding)
+  {
+    return std::less<const cep_binding *>()(a.binding, b.binding);
+  }
+  if (a.handle.slot != b.handle.slot)
+  {
+    return a.handle.slot < b.handle.slot;
+  }
+  if (a.handle.generation != b.handle.generation)
+  {
+    return a.handle.generation < b.handle.generation;
+  }
+  return a.sequence < b.sequence;
+}
+
+static bool same_vehicle(const pending_calculation &a, const pending_calculation &b)
+{
+  return a.handle.slot == b.handle.slot && a.handle.generation == b.handle.generation;
+}
+
+void phem_light_handler::calculate_pending_emissions()
+{
+  if (pending.empty())
+  {
+    return;
+  }
+
+  trace_point trace(TRACE_PHEM_CALC_PENDING);
+
+  std::sort(pending.begin(), pending.end(), pending_before);
+
+  // only the last calculate command of a vehicle counts, so every emission row has a single writer
+  size_t kept = 0;
+  for (size_t i = 0; i < pending.size(); i++)
+  {
+    if (i + 1 < pending.size() && same_vehicle(pending[i], pending[i + 1]))
+    {
+      continue;
+    }
+
+    // idle set and its counts are only changed by this thread
+    vehicle_handle handle = pending[i].handle;
+    bool requested = true;
+    if (settings.lazy_calculation && vehicles.is_valid(handle))
+    {
+      vehicle *veh = vehicles.get_vehicle(handle);
+      requested = veh->row_requested;
+      veh->row_requested = false;
+    }
+    if (!(pending[i].velocity > 0))
+    {
+      if (vehicles.is_valid(handle))
+      {
+        vehicles.set_idle(handle, &pending[i].binding->idle_emission);
+      }
+      continue;
+    }
+    if (vehicles.is_valid(handle))
+    {
+      vehicles.set_idle(handle, NULL);
+    }
+
+    if (settings.lazy_calculation)
+    {
+      // vehicles not read in the last time step are calculated at their first get
+      lazy_commands++;
+      if (!requested)
+      {
+        if (vehicles.is_valid(handle))
+        {
+          vehicles.set_has_emission(handle);
+        }
+        continue;
+      }
+    }
+
+    if (find_memo_emission(pending[i]))
+    {
+      if (settings.lazy_calculation && vehicles.is_valid(handle))
+      {
+        vehicles.get_vehicle(handle)->row_generation = pollutant_generation;
+        count_lazy_calculation(pending[i].binding, false);
+      }
+      continue;
+    }
+    pending[kept++] = pending[i];
+  }
+  pending.resize(kept);
+
+  // fixed chunks per binding, the result of a vehicle doesn't depend on the thread or chunk computing it
+  chunks.clear();
+  serial_chunks.clear();
+  size_t begin = 0;
+  while (begin < pending.size())
+  {
+    size_t end = begin + 1;
+    while (end < pending.size() && pending[end].binding == pending[begin].binding)
+    {
+      end++;
+    }
+    if (!pending[begin].binding->concurrent)
     {
-      veh = element->second;
-      cached_vehicle_id = id;
-      cached_vehicle = veh;
+      // helpers may be shared by bindings, their error messages are only written by this thread
+      pending_chunk chunk;
+      chunk.begin = begin;
+      chunk.count = end - begin;
+      serial_chunks.push_back(chunk);
+      begin = end;
+      continue;
     }
+    for (size_t chunk_begin = begin; chunk_begin < end; chunk_begin += BATCH_CHUNK_SIZE)
+    {
+      pending_chunk chunk;
+      chunk.begin = chunk_begin;
+      chunk.count = std::min(BATCH_CHUNK_SIZE, end - chunk_begin);
+      chunks.push_back(chunk);
+    }
+    begin = end;
   }
 
-  // calculate emission
-  emission *emis = calculate_vehicle_emission(veh);
+  workers.run(chunks.size(), calculate_chunk, this);
+  for (size_t i = 0; i < serial_chunks.size(); i++)
+  {
+    calculate_batch(&pending[serial_chunks[i].begin], serial_chunks[i].count, worker_batches[0]);
+  }
 
-  if (emis == NULL)
+  // results of the new states, the memos are only used by this thread
+  for (size_t i = 0; i < pending.size(); i++)
+  {
+    if (pending[i].binding->memo != NULL && vehicles.is_valid(pending[i].handle))
+    {
+      pending[i].binding->memo->insert(pending[i].key, *vehicles.get_emission_row(pending[i].handle));
+    }
+    if (settings.lazy_calculation && vehicles.is_valid(pending[i].handle))
+    {
+      vehicles.get_vehicle(pending[i].handle)->row_generation = pollutant_generation;
+      count_lazy_calculation(pending[i].binding, false);
+    }
+  }
+
+  trace.stop(pending.size());
+  pending.clear();
+}
+
+bool phem_light_handler::find_memo_emission(pending_calculation &calculation)
+{
+  emission_memo *memo = calculation.binding->memo;
+  if (memo == NULL)
   {
     return false;
   }
 
-  // update cache
-  cached_emission = emis;
-  cached_emission_id = id;
+  // a miss is calculated at the center of its cell
+  calculation.key = memo->quantize(calculation.velocity, calculation.acceleration, calculation.slope);
+  const emission *memo_emis = memo->find(calculation.key);
+  if (memo_emis == NULL)
+  {
+    return false;
+  }
+  if (vehicles.is_valid(calculation.handle))
+  {
+    *vehicles.get_emission_row(calculation.handle) = *memo_emis;
+    vehicles.set_has_emission(calculation.handle);
+  }
+  return true;
+}
+
+void phem_light_handler::calculate_chunk(void *context, size_t chunk, unsigned int worker)
+{
+  phem_light_handler *handler = (phem_light_handler *)context;
+  const pending_chunk &current = handler->chunks[chunk];
+  handler->calculate_batch(&handler->pending[current.begin], current.count, handler->worker_batches[worker]);
+}
+
+void phem_light_handler::calculate_batch(const pending_calculation *calculations, size_t count, batch_buffers &batch)
+{
+  trace_point trace(TRACE_PHEM_CALC_BATCH);
+
+  // same steps as calculate_vehicle_emission for all vehicles of one cep
+  const cep_binding *binding = calculations[0].binding;
+  const PHEMlightdll::CEP *cep = binding->cep;
+  int n = (int)count;
+
+  batch.velocity.resize(count);
+  batch.acceleration.resize(count);
+  batch.gradient.resize(count);
+  batch.max_acceleration.resize(count);
+  batch.power.resize(count);
+  for (size_t i = 0; i < count; i++)
+  {
+    batch.velocity[i] = calculations[i].velocity > 0 ? calculations[i].velocity : 0;
+    batch.acceleration[i] = calculations[i].acceleration;
+    batch.gradient[i] = calculations[i].slope;
+  }
+
+  // set acceleration with limitations
+  cep->GetMaxAccelBatch(n, &batch.velocity[0], &batch.gradient[0], &batch.max_acceleration[0]);
+  for (size_t i = 0; i < count; i++)
+  {
+    if (batch.velocity[i] == 0)
+    {
+      batch.acceleration[i] = 0;
+    }
+    else if (batch.acceleration[i] > batch.max_acceleration[i])
+    {
+      batch.acceleration[i] = batch.max_acceleration[i];
+    }
+  }
+
+  // calculate the power
+  cep->CalcPowerBatch(n, &batch.velocity[0], &batch.acceleration[0], &batch.gradient[0], &batch.power[0]);
 
-  // insert or replace emission
-  if (emissions.find(id) == emissions.end())
+  // vehicles with emissions, all for BEV
+  batch.emitting.clear();
+  if (binding->is_bev)
   {
-    // no emission for given id found -> only insert emission for id
-    emissions.insert(std::pair<long, emission *>(id, emis));
+    for (size_t i = 0; i < count; i++)
+    {
+      batch.emitting.push_back((unsigned int)i);
+    }
   }
   else
   {
-    // emission for given id exists -> free old emission and set new one
-    delete emissions.find(id)->second;
-    emissions.erase(id);
-    emissions.insert(std::pair<long, emission *>(id, emis));
+    batch.decel_coast.resize(count);
+    cep->GetDecelCoastBatch(n, &batch.velocity[0], &batch.acceleration[0], &batch.gradient[0], &batch.decel_coast[0]);
+    for (size_t i = 0; i < count; i++)
+    {
+      if (batch.acceleration[i] >= batch.decel_coast[i] || batch.velocity[i] <= PHEMlightdll::Constants::ZERO_SPEED_ACCURACY)
+      {
+        batch.emitting.push_back((unsigned int)i);
+      }
+    }
   }
 
-#if PROFILE_PHEM_LIGHT > 0
-  auto end = std::chrono::high_resolution_clock::now();
-  profile_phem << "PHEM_CALC_EMISSION_PUB;" << std::chrono::duration_cast<default_time>(end - start).count() << std::endl;
-#endif
+  // requested pollutants of the emitting vehicles, BEV only needs the fuel consumption
+  int emitting_count = (int)batch.emitting.size();
+  int pollutant_count = binding->is_bev ? 1 : binding->evaluated_count;
+  const int *pollutant_indices = binding->is_bev ? binding->pollutant_indices : binding->evaluated_indices;
+  batch.emitting_power.resize(batch.emitting.size());
+  batch.emitting_velocity.resize(batch.emitting.size());
+  batch.values.resize(batch.emitting.size() * pollutant_count);
+  for (int i = 0; i < emitting_count; i++)
+  {
+    batch.emitting_power[i] = batch.power[batch.emitting[i]];
+    batch.emitting_velocity[i] = batch.velocity[batch.emitting[i]];
+  }
+  if (emitting_count > 0 && pollutant_count > 0)
+  {
+    cep->GetEmissionsBatch(pollutant_indices, pollutant_count, emitting_count, &batch.emitting_power[0], &batch.emitting_velocity[0], &batch.values[0], binding->helper);
+  }
 
-  return true;
+  // write results, vehicles destroyed since their calculate command are skipped
+  int next_emitting = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    const double *values = NULL;
+    double expanded[POLLUTANT_COUNT + EMISSION_COLUMN_COUNT];
+    if (next_emitting < emitting_count && batch.emitting[next_emitting] == i)
+    {
+      values = batch.values.data() + next_emitting * pollutant_count;
+      if (!binding->is_bev)
+      {
+        values = expand_pollutants(binding, values, expanded);
+      }
+      next_emitting++;
+    }
+
+    vehicle_handle handle = calculations[i].handle;
+    if (!vehicles.is_valid(handle))
+    {
+      continue;
+    }
+    write_vehicle_emission(binding, cep->CalcEngPower(batch.power[i]), values, vehicles.get_emission_row(handle));
+    vehicles.set_has_emission(handle);
+  }
+  trace.stop(count);
 }
 
-emission *phem_light_handler::get_vehicle_emission(long id)
+void phem_light_handler::set_simulation_time(double time)
 {
-#if PROFILE_PHEM_LIGHT > 0
-  auto start = std::chrono::high_resolution_clock::now();
-#endif
+  // a new time step starts, compute the vehicles of the last one
+  if (time != simulation_time)
+  {
+    calculate_pending_emissions();
+    simulation_time = time;
+  }
+}
 
-  // assume id is in emissions
-  // check cached emission first
-  emission *emis;
-  if (cached_emission_id == id)
+bool phem_light_handler::calculate_vehicle_emission(long id, const vehicle_input &input)
+{
+  trace_point trace(TRACE_PHEM_CALC_EMISSION_PUB);
+
+  init_config();
+  vehicle_handle handle;
+  if (!find_vehicle(id, handle))
   {
-    emis = cached_emission;
+// no vehicle for given id found
+#if DEBUG_PHEM_LIGHT >= 1
+    debug_phem_light << "<ERROR> No vehicle for id " << id << " found in calculate_vehicle_emission." << std::endl;
+#endif
+    return false;
   }
-  else
+
+  // values set since the vehicle id, written in one step
+  input.apply(vehicles.get_vehicle(handle));
+
+  if (settings.deferred_calculation)
   {
-    std::map<long, emission *>::iterator element = emissions.find(id);
-    if (element == emissions.end())
+    // record inputs, the emission is calculated with all vehicles of the time step
+    const vehicle *veh = vehicles.get_vehicle(handle);
+    if (veh->binding == NULL)
     {
-      // no emission for given id found
+// no entry in CEPS found
 #if DEBUG_PHEM_LIGHT >= 1
-      debug_phem_light << "<ERROR> Vehicle id for get request not found." << std::endl;
+      debug_phem_light << "<Error> No CEPS bound to vehicle." << std::endl;
 #endif
-      return NULL;
+      return false;
     }
-    else
-    {
-#if DEBUG_PHEM_LIGHT >= 3
-      debug_phem_light << "<GET> Returning emission for vehicle " << id << "." << std::endl;
-#endif
-      // emission for given id exists
-      // update cache
-      this->cached_emission_id = id;
-      this->cached_emission = element->second;
 
-      emis = element->second;
+    if (settings.lazy_calculation)
+    {
+      vehicles.get_vehicle(handle)->row_generation = 0;
     }
+
+    pending_calculation calculation;
+    calculation.handle = handle;
+    calculation.binding = veh->binding;
+    calculation.sequence = (unsigned int)pending.size();
+    calculation.acceleration = veh->acceleration;
+    calculation.velocity = veh->velocity;
+    calculation.slope = veh->slope;
+    pending.push_back(calculation);
+    trace.stop();
+    return true;
+  }
+
+  // standing vehicles share the row of their cep
+  const vehicle *veh = vehicles.get_vehicle(handle);
+  if (veh->binding != NULL && !(veh->velocity > 0))
+  {
+    vehicles.set_idle(handle, &veh->binding->idle_emission);
+    trace.stop();
+    return true;
+  }
+  vehicles.set_idle(handle, NULL);
+
+  if (settings.lazy_calculation && veh->binding != NULL)
+  {
+    // calculated at the first get of its emission
+    vehicles.get_vehicle(handle)->row_generation = 0;
+    vehicles.set_has_emission(handle);
+    lazy_commands++;
+    trace.stop();
+    return true;
+  }
+
+  // calculate emission into the row of the vehicle, no allocation per time step
+  if (!calculate_vehicle_emission(veh, vehicles.get_emission_row(handle)))
+  {
+    return false;
   }
+  vehicles.set_has_emission(handle);
+
+  trace.stop();
+  return true;
+}
 
-#if PROFILE_PHEM_LIGHT > 0
-  auto end = std::chrono::high_resolution_clock::now();
-  profile_phem << "PHEM_GET_VEHICLE_EMISSION;" << std::chrono::duration_cast<default_time>(end - start).count() << std::endl;
+const emission *phem_light_handler::get_vehicle_emission(long id)
+{
+  trace_point trace(TRACE_PHEM_GET_VEHICLE_EMISSION);
+
+  // results of deferred calculations are needed now
+  calculate_pending_emissions();
+
+  // assume id is in emissions
+  vehicle_handle handle;
+  const emission *emis = NULL;
+  if (find_vehicle(id, handle))
+  {
+    emis = vehicles.get_emission(handle);
+    if (emis != NULL && settings.lazy_calculation && !calculate_lazy_emission(handle))
+    {
+      emis = NULL;
+    }
+  }
+  if (emis == NULL)
+  {
+    // no emission for given id found
+#if DEBUG_PHEM_LIGHT >= 1
+    debug_phem_light << "<ERROR> Vehicle id for get request not found." << std::endl;
 #endif
+    return NULL;
+  }
 
+  trace.stop();
   // return emission
   return emis;
 }
+
+bool phem_light_handler::calculate_lazy_emission(const vehicle_handle &handle)
+{
+  // inputs of the last calculate command, for the pollutants requested now
+  vehicle *veh = vehicles.get_vehicle(handle);
+  veh->row_requested = true;
+  if (veh->row_generation == pollutant_generation || !(veh->velocity > 0))
+  {
+    // calculated, or the shared row of standing vehicles
+    return true;
+  }
+  count_lazy_calculation(veh->binding, veh->row_generation != 0);
+  veh->row_generation = pollutant_generation;
+  return calculate_vehicle_emission(veh, vehicles.get_emission_row(handle));
+}
+
+void phem_light_handler::count_lazy_calculation(const cep_binding *binding, bool recalculation)
+{
+  if (recalculation)
+  {
+    lazy_recalculations++;
+  }
+  else
+  {
+    lazy_calculations++;
+  }
+  if (!binding->is_bev)
+  {
+    lazy_evaluated_pollutants += binding->evaluated_count;
+    lazy_skipped_pollutants += binding->pollutant_count - binding->evaluated_count;
+  }
+}
+
+const std::vector<emission_column> &phem_light_handler::get_emission_columns() const
+{
+  return settings.emission_columns;
+}
+
+bool phem_light_handler::get_lazy_calculation() const
+{
+  return settings.lazy_calculation;
+}
+
+const std::vector<std::string> &phem_light_handler::get_lazy_types() const
+{
+  return settings.lazy_types;
+}
+
+void phem_light_handler::request_pollutants(unsigned int pollutants)
+{
+  if (!settings.lazy_calculation || pollutants == requested_pollutants)
+  {
+    return;
+  }
+
+  // rows of the older pollutants are calculated again at their next get
+  requested_pollutants = pollutants;
+  pollutant_generation++;
+
+  // states of the memos and rows of standing vehicles are calculated with the new pollutants
+  for (std::map<const PHEMlightdll::CEP *, std::unique_ptr<emission_memo> >::iterator element = memos.begin(); element != memos.end(); element++)
+  {
+    element->second->invalidate();
+  }
+  std::vector<cep_binding *> resolved;
+  if (has_default_binding)
+  {
+    resolved.push_back(&default_binding);
+  }
+  for (std::map<long, cep_binding>::iterator element = bindings.begin(); element != bindings.end(); element++)
+  {
+    resolved.push_back(&element->second);
+  }
+  for (size_t i = 0; i < resolved.size(); i++)
+  {
+    if (resolved[i]->resolved && resolved[i]->cep != NULL)
+    {
+      select_pollutants(*resolved[i]);
+      vehicle idle_vehicle;
+      idle_vehicle.binding = resolved[i];
+      calculate_vehicle_emission(&idle_vehicle, &resolved[i]->idle_emission);
+    }
+  }
+}
+
+bool phem_light_handler::dump_trace()
+{
+  if (!settings.trace)
+  {
+    return false;
+  }
+  return tracer::instance().dump(settings.trace_path);
+}
+
+void phem_light_handler::abandon_threads()
+{
+  workers.abandon();
+  loaders.abandon();
+  threads_abandoned = true;
+}
@@ -15,7 +15,12 @@
 //
 /****************************************************************************/
 
+#include <algorithm>
+#include <functional>
 #include <map>
+#include <memory>
+#include <set>
+#include <thread>
 #include <vector>
 #include <iostream>
 #include <sstream>
@@ -26,115 +31,316 @@
 #include "PHEMlight/Constants.h"
 #include "PHEMlight/Helpers.h"
 
+#include "CEPRegistry.h"
+#include "EmissionMemo.h"
+#include "VehicleStore.h"
+#include "WorkerPool.h"
+
 using namespace std;
 
-struct vehicle
+// cep column read as a vissim emission type, "EMISSION_DATA_NO3 = NO" in the config
+struct emission_column
 {
-  long type;
-  double acceleration;
-  double velocity;
-  double slope;
-  double weight;
-  double timestep;
+  std::string type;      // name of the vissim type, resolved by the emission model
+  std::string pollutant; // column of the cep
+};
 
-  vehicle() : type(-1) {}
+// settings read from Vissim_PHEMlight.cfg as "KEY = VALUE"
+struct handler_settings
+{
+  // INTERPOLATION = GRID resamples the cep tables onto uniform grids
+  bool use_uniform_grids;
+  double grid_max_error; // GRID_MAX_ERROR
+  int grid_max_size;     // GRID_MAX_SIZE
 
-  vehicle(long p_type) : type(p_type) {}
+  // REPORT = file for load and accuracy reports
+  std::string report_path;
 
-  vehicle(long p_type, double p_acceleration, double p_velocity, double p_slope, double p_weight, double p_timestep)
-  {
-    type = p_type;
-    acceleration = p_acceleration;
-    velocity = p_velocity;
-    slope = p_slope;
-    weight = p_weight;
-    timestep = p_timestep;
-  }
+  // CALCULATION = DEFERRED records vehicles at calculate and computes them in batches
+  bool deferred_calculation;
+
+  // INSTRUCTION_SET = AUTO | SCALAR | AVX2 | AVX512 for the batch calculation
+  PHEMlightdll::Batch::InstructionSet instruction_set;
+
+  // PRECISION = DOUBLE | SINGLE for the batch calculation, SINGLE reports its deviation from DOUBLE
+  PHEMlightdll::Batch::Precision precision;
+
+  // THREADS = n for the deferred calculation, 0 uses all hardware threads
+  unsigned int thread_count;
+
+  // AFFINITY = NONE | COMPACT | list of cores, core of each worker thread
+  std::string affinity;
+  std::vector<int> affinity_cores;
+
+  // CEP_CACHE = NONE | SOURCE | directory of the binary cep images, SOURCE stores them next to the cep files
+  std::string cep_cache;
+
+  // EMBEDDED = ON | OFF, use classes compiled into the library instead of their files
+  bool use_embedded;
+
+  // LOAD_THREADS = n parsing the cep files in the background, 0 uses all hardware threads
+  unsigned int load_thread_count;
+
+  // MEMO = ON shares one evaluation between vehicles of a cep in the same quantized state
+  bool use_memo;
+  double memo_velocity_step;     // MEMO_VELOCITY_STEP, 0 keys on the exact value
+  double memo_acceleration_step; // MEMO_ACCELERATION_STEP
+  double memo_slope_step;        // MEMO_SLOPE_STEP
+  unsigned int memo_max_size;    // MEMO_MAX_SIZE, states per cep
+
+  // EMISSION_DATA_* = column, at most EMISSION_COLUMN_COUNT, written to emission::columns in this order
+  std::vector<emission_column> emission_columns;
+
+  // LAZY = ON calculates a vehicle at the first get of its emission, with the pollutants read so far
+  // or those of the types in LAZY_TYPES
+  bool lazy_calculation;
+  std::vector<std::string> lazy_types; // LAZY_TYPES, empty for AUTO
+
+  // TRACE = ON records the time of 1 of TRACE_SAMPLE calls per probe and thread, the last
+  // TRACE_SIZE records per thread are written to TRACE_FILE
+  bool trace;
+  unsigned int trace_sample_rate;
+  size_t trace_size;
+  std::string trace_path;
+
+  handler_settings() : use_uniform_grids(false), grid_max_error(1e-4), grid_max_size(65537), report_path(""), deferred_calculation(false),
+                       instruction_set(PHEMlightdll::Batch::GetSupportedInstructionSet()), precision(PHEMlightdll::Batch::Precision_Double), thread_count(1), affinity("NONE"), cep_cache("NONE"), use_embedded(true), load_thread_count(0),
+                       use_memo(false), memo_velocity_step(0.1), memo_acceleration_step(0.05), memo_slope_step(0.5), memo_max_size(65536),
+                       lazy_calculation(false), trace(false), trace_sample_rate(1), trace_size(65536), trace_path("Vissim_PHEMlight_trace.txt") {}
 };
 
-struct emission
+// order of the pollutants evaluated per vehicle
+enum pollutant_slot
 {
-  double fuel_consumption; // [g/s] / [kWh/s for BEV]
-  double norm_drive;       //
-  double norm_rated;       //
-  double co;               // [g/s]
-  double co2;              // [g/s]
-  double hc;               // [g/s]
-  double nox;              // [g/s]
-  double pm;               // [g/s]
-
-  emission(double default_value)
-  {
-    fuel_consumption = default_value;
-    norm_drive = default_value;
-    norm_rated = default_value;
-    co = default_value;
-    co2 = default_value;
-    hc = default_value;
-    nox = default_value;
-    pm = default_value;
-  }
+  POLLUTANT_FC,
+  POLLUTANT_CO,
+  POLLUTANT_HC,
+  POLLUTANT_NOX,
+  POLLUTANT_PM,
+  POLLUTANT_COUNT
+};
 
-  emission()
-  {
-    fuel_consumption = 0.1;
-    norm_drive = 0.2;
-    norm_rated = 0.3;
-    co = 0.4;
-    co2 = 0.5;
-    hc = 0.6;
-    nox = 0.7;
-    pm = 0.8;
-  }
+// pollutants of the lazy calculation, bit pollutant_slot and bit POLLUTANT_COUNT + index of a
+// configured column
+static const unsigned int ALL_POLLUTANTS = 0xFFFFFFFFu;
+
+// binding of a vissim vehicle type to its PHEMlight class, resolved when the first vehicle of the
+// type needs its cep and immutable afterwards, apart from the pollutants requested with LAZY
+struct cep_binding
+{
+  const cep_entry *entry;
+  bool resolved;
+
+  const PHEMlightdll::CEP *cep;
+  PHEMlightdll::Helpers *helper;
+  bool is_bev;
+  double driving_power;
+  double rated_power;
+
+  // pollutant handles of the cep, ordered by pollutant_slot and followed by the configured columns
+  // found in the cep
+  int pollutant_indices[POLLUTANT_COUNT + EMISSION_COLUMN_COUNT];
+  int pollutant_count;
+
+  // emission::columns index of each configured column after POLLUTANT_COUNT
+  int column_slots[EMISSION_COLUMN_COUNT];
+
+  // requested pollutants, their handles and positions in pollutant_indices, all of them without LAZY
+  int evaluated_indices[POLLUTANT_COUNT + EMISSION_COLUMN_COUNT];
+  int evaluated_positions[POLLUTANT_COUNT + EMISSION_COLUMN_COUNT];
+  int evaluated_count;
+
+  // no error messages are written to the helper, so vehicles can be split across threads
+  bool concurrent;
+
+  // results of the cep in this handler, NULL without MEMO
+  emission_memo *memo;
+
+  // constant row of all standing vehicles of the cep, which are calculated without acceleration
+  // and whose power doesn't depend on the slope
+  emission idle_emission;
 
-  emission(double p_fuel_consumption, double p_norm_drive, double p_norm_rated, double p_co, double p_co2, double p_hc, double p_nox, double p_pm)
+  cep_binding() : entry(NULL), resolved(false), cep(NULL), helper(NULL), is_bev(false), driving_power(0), rated_power(0), pollutant_count(POLLUTANT_COUNT), evaluated_count(0), concurrent(false), memo(NULL)
   {
-    fuel_consumption = p_fuel_consumption;
-    norm_drive = p_norm_drive;
-    norm_rated = p_norm_rated;
-    co = p_co;
-    co2 = p_co2;
-    hc = p_hc;
-    nox = p_nox;
-    pm = p_pm;
+    for (int i = 0; i < POLLUTANT_COUNT + EMISSION_COLUMN_COUNT; i++)
+    {
+      pollutant_indices[i] = PHEMlightdll::CEP::PollutantIndexUnknown;
+      evaluated_indices[i] = PHEMlightdll::CEP::PollutantIndexUnknown;
+      evaluated_positions[i] = i;
+    }
+    for (int i = 0; i < EMISSION_COLUMN_COUNT; i++)
+    {
+      column_slots[i] = -1;
+    }
   }
 };
 
+// inputs of a vehicle at its calculate command, computed later in deferred mode
+struct pending_calculation
+{
+  vehicle_handle handle;
+  const cep_binding *binding;
+  unsigned int sequence; // order of the calculate commands
+  double acceleration;
+  double velocity;
+  double slope;
+  memo_key key; // cell of the quantized inputs with MEMO
+};
+
+// vehicles of one binding calculated by one worker
+struct pending_chunk
+{
+  size_t begin;
+  size_t count;
+};
+
+// work arrays of one batch, kept to avoid allocation per time step
+struct batch_buffers
+{
+  std::vector<double> velocity;
+  std::vector<double> acceleration;
+  std::vector<double> gradient;
+  std::vector<double> max_acceleration;
+  std::vector<double> power;
+  std::vector<double> decel_coast;
+  std::vector<unsigned int> emitting;
+  std::vector<double> emitting_power;
+  std::vector<double> emitting_velocity;
+  std::vector<double> values;
+};
+
 class phem_light_handler
 {
 
 private:
-  std::map<long, vehicle *> vehicles;
-  std::map<long, emission *> emissions;
+  // vehicle states and emission rows
+  vehicle_store vehicles;
 
-  // emission and vehicle cache
-  emission *cached_emission;
-  long cached_emission_id;
-  vehicle *cached_vehicle;
+  // handle of the last accessed vehicle
+  vehicle_handle cached_handle;
   long cached_vehicle_id;
 
+  bool find_vehicle(long id, vehicle_handle &handle);
+
   bool helper_init;
   PHEMlightdll::Helpers *default_helper;
-  PHEMlightdll::CEPHandler *default_cep_handler;
   std::map<long, PHEMlightdll::Helpers *> helpers;
-  std::map<long, PHEMlightdll::CEPHandler *> cep_handlers;
+
+  // ceps of the bindings, shared with all types and handlers of the same class
+  std::vector<std::shared_ptr<const cep_entry> > ceps;
+
+  // ceps first requested by this handler, parsed in the background by the loaders
+  std::vector<std::shared_ptr<cep_entry> > loading;
+  worker_pool loaders;
+
+  // set while load_ceps runs on its detached thread
+  std::mutex load_mutex;
+  std::condition_variable load_condition;
+  bool load_running;
+  bool threads_abandoned;
+
+  void start_loading();
+  static void load_entry(void *handler);
+  void load_ceps();
+  static void load_cep(void *context, size_t chunk, unsigned int worker);
+  void write_load_report();
+
+  // resolved cep per vissim type, default for unknown types
+  bool has_default_binding;
+  cep_binding default_binding;
+  std::map<long, cep_binding> bindings;
 
   bool create_phemlight_helper(long id, PHEMlightdll::Helpers *helper);
-  PHEMlightdll::Helpers *get_phemlight_helper(long id);
-  bool create_phemlight_cep_handlers(long id, PHEMlightdll::CEPHandler *cep_handler);
-  PHEMlightdll::CEPHandler *get_phemlight_cep_handlers(long id);
+  bool create_cep_binding(PHEMlightdll::Helpers *helper, const PHEMlightdll::CEP *cep, cep_binding &binding);
+  bool resolve_cep_binding(cep_binding &binding);
+  const cep_binding *get_cep_binding(long type);
+
+  std::string config_path;
+  handler_settings settings;
+  std::ofstream report;
 
   bool read_config();
+  bool read_setting(const std::string &key, const std::string &value);
+  void init_config();
+  void write_grid_report(const cep_entry *entry);
+
+  void write_precision_report(const cep_entry *entry);
+
+  // memo per cep, shared by the bindings of this handler
+  std::map<const PHEMlightdll::CEP *, std::unique_ptr<emission_memo> > memos;
+
+  emission_memo *get_memo(const PHEMlightdll::CEP *cep);
+  bool find_memo_emission(pending_calculation &calculation);
+  void write_memo_report();
+
+  void write_idle_report();
+
+  bool calculate_vehicle_emission(const vehicle *veh, emission *emis);
+  void write_vehicle_emission(const cep_binding *binding, double energie, const double *values, emission *emis);
+
+  // LAZY, rows calculated for an older generation of the requested pollutants are recalculated at
+  // their next get
+  unsigned int requested_pollutants;
+  unsigned int pollutant_generation;
+
+  // calculate commands of moving vehicles, their calculations at a get or in a batch, calculations
+  // again for new pollutants, and the pollutants evaluated and skipped by them
+  unsigned long long lazy_commands;
+  unsigned long long lazy_calculations;
+  unsigned long long lazy_recalculations;
+  unsigned long long lazy_evaluated_pollutants;
+  unsigned long long lazy_skipped_pollutants;
 
-  emission *calculate_vehicle_emission(vehicle *veh);
+  void select_pollutants(cep_binding &binding);
+  bool calculate_lazy_emission(const vehicle_handle &handle);
+  void count_lazy_calculation(const cep_binding *binding, bool recalculation);
+  void write_lazy_report();
+
+  // deferred calculation, flushed on the first get request or when the simulation time changes
+  std::vector<pending_calculation> pending;
+  std::vector<pending_chunk> chunks;
+  std::vector<pending_chunk> serial_chunks; // bindings that aren't concurrent, calculated by the flushing thread
+  double simulation_time;
+
+  // chunks are distributed to the workers, each with its own work arrays
+  static constexpr size_t BATCH_CHUNK_SIZE = 256;
+  worker_pool workers;
+  std::vector<batch_buffers> worker_batches;
+
+  void start_workers();
+  void calculate_pending_emissions();
+  void calculate_batch(const pending_calculation *calculations, size_t count, batch_buffers &batch);
+  static void calculate_chunk(void *context, size_t chunk, unsigned int worker);
 
 public:
   phem_light_handler();
+  explicit phem_light_handler(const std::string &p_config_path);
   ~phem_light_handler();
 
+  // reads the config and starts loading the ceps, otherwise done at the first vehicle
+  void load_config();
+
   bool create_vehicle(long id, long type);
   bool destroy_vehicle(long id);
   vehicle *get_vehicle(long id);
-  bool calculate_vehicle_emission(long id);
-  emission *get_vehicle_emission(long id);
+  // writes the staged input to the vehicle and calculates it, one lookup of the id
+  bool calculate_vehicle_emission(long id, const vehicle_input &input);
+  const emission *get_vehicle_emission(long id);
+  void set_simulation_time(double time);
+
+  // cep columns configured as vissim types, available after load_config
+  const std::vector<emission_column> &get_emission_columns() const;
+
+  // LAZY, the emission model requests the pollutant bits of the types read so far or of LAZY_TYPES
+  bool get_lazy_calculation() const;
+  const std::vector<std::string> &get_lazy_types() const;
+  void request_pollutants(unsigned int pollutants);
+
+  // writes the trace of all handlers recorded so far to TRACE_FILE, false without TRACE. Also
+  // done when the handler is destroyed
+  bool dump_trace();
+
+  // forgets the threads of the handler terminated by the exit of the process, so the destructor
+  // doesn't wait for them. A FreeLibrary needs nothing, the dll is unloaded after its threads ended
+  void abandon_threads();
 };
@@ -0,0 +1,263 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    Tracer.cpp
+/// @author  agent
+/// @date    2026/10/17
+///
+//
+/****************************************************************************/
+
+#include <fstream>
+
+#include "Tracer.h"
+
+std::atomic<bool> trace_enabled(false);
+
+// buffer of this thread, created at its first sample and owned by the tracer
+static thread_local trace_buffer *thread_buffer = NULL;
+
+static const char *probe_names[TRACE_PROBE_COUNT] = {
+    "EM_SET",
+    "EM_GET",
+    "EM_EXEC",
+    "PHEM_CREATE_HELPER",
+    "PHEM_CREATE_VEHICLE",
+    "PHEM_DESTROY_VEHICLE",
+    "PHEM_GET_VEHICLE",
+    "PHEM_CALC_EMISSION",
+    "PHEM_CALC_EMISSION_PUB",
+    "PHEM_CALC_PENDING",
+    "PHEM_CALC_BATCH",
+    "PHEM_GET_VEHICLE_EMISSION"};
+
+/*==========================================================================*/
+
+trace_buffer::trace_buffer(size_t capacity, unsigned int p_thread, unsigned int p_rate) : written(0)
+{
+  size_t size = 1;
+  while (size < capacity)
+  {
+    size <<= 1;
+  }
+  records.reset(new trace_slot[size]);
+  for (size_t i = 0; i < size; i++)
+  {
+    records[i].start.store(0, std::memory_order_relaxed);
+    records[i].duration.store(0, std::memory_order_relaxed);
+    records[i].value.store(0, std::memory_order_relaxed);
+    records[i].probe.store(0, std::memory_order_relaxed);
+  }
+  slot_count = size;
+  mask = size - 1;
+  thread = p_thread;
+  random_state = 2463534242u + p_thread;
+  rate = p_rate;
+}
+
+void trace_buffer::record(unsigned int probe, uint64_t start, uint64_t end, uint32_t value)
+{
+  uint64_t index = written.load(std::memory_order_relaxed);
+  trace_slot &slot = records[(size_t)(index & mask)];
+  uint64_t duration = end - start;
+  // a dump reading one of the stores below also sees the count of the records before, so it
+  // drops this slot as being written
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.start.store(start, std::memory_order_relaxed);
+  slot.duration.store(duration < 0xFFFFFFFFull ? (uint32_t)duration : 0xFFFFFFFFu, std::memory_order_relaxed);
+  slot.value.store(value, std::memory_order_relaxed);
+  slot.probe.store(probe, std::memory_order_relaxed);
+  // publishes the record to a concurrent dump
+  written.store(index + 1, std::memory_order_release);
+}
+
+unsigned int trace_buffer::next_skip()
+{
+  if (rate <= 1)
+  {
+    return 0;
+  }
+  // xorshift32
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return random_state % (2 * rate - 1);
+}
+
+void trace_buffer::copy(std::vector<trace_record> &out) const
+{
+  uint64_t end = written.load(std::memory_order_acquire);
+  uint64_t begin = end > slot_count ? end - slot_count : 0;
+  size_t offset = out.size();
+  for (uint64_t i = begin; i < end; i++)
+  {
+    const trace_slot &slot = records[(size_t)(i & mask)];
+    trace_record rec;
+    rec.start = slot.start.load(std::memory_order_relaxed);
+    rec.duration = slot.duration.load(std::memory_order_relaxed);
+    rec.value = slot.value.load(std::memory_order_relaxed);
+    rec.probe = slot.probe.load(std::memory_order_relaxed);
+    out.push_back(rec);
+  }
+
+  // the thread may have written over the oldest records in the meantime, up to the one it writes now
+  std::atomic_thread_fence(std::memory_order_acquire);
+  uint64_t now = written.load(std::memory_order_relaxed);
+  uint64_t valid = now + 1 > slot_count ? now + 1 - slot_count : 0;
+  if (valid > begin)
+  {
+    size_t dropped = (size_t)(valid - begin < end - begin ? valid - begin : end - begin);
+    out.erase(out.begin() + offset, out.begin() + offset + dropped);
+  }
+}
+
+uint64_t trace_buffer::get_written() const
+{
+  return written.load(std::memory_order_acquire);
+}
+
+unsigned int trace_buffer::get_thread() const
+{
+  return thread;
+}
+
+/*==========================================================================*/
+
+tracer::tracer() : buffer_size(0), sample_rate(1), start_ticks(0)
+{
+}
+
+tracer &tracer::instance()
+{
+  static tracer trace;
+  return trace;
+}
+
+bool tracer::start(unsigned int p_sample_rate, size_t p_buffer_size)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (trace_enabled.load(std::memory_order_relaxed))
+  {
+    return false;
+  }
+  sample_rate = p_sample_rate > 0 ? p_sample_rate : 1;
+  buffer_size = p_buffer_size > 0 ? p_buffer_size : 1;
+  start_time = std::chrono::steady_clock::now();
+  start_ticks = trace_ticks();
+  trace_enabled.store(true, std::memory_order_release);
+  return true;
+}
+
+trace_buffer *tracer::sample(unsigned int probe)
+{
+  if (thread_buffer == NULL)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    buffers.push_back(std::unique_ptr<trace_buffer>(new trace_buffer(buffer_size, (unsigned int)buffers.size(), sample_rate)));
+    thread_buffer = buffers.back().get();
+  }
+  trace_countdown[probe] = thread_buffer->next_skip();
+  return thread_buffer;
+}
+
+bool tracer::dump(const std::string &path)
+{
+  std::vector<trace_record> records;
+  std::vector<size_t> thread_ends;
+  std::vector<unsigned int> threads;
+  uint64_t written = 0;
+  double ns_per_tick = 0;
+  unsigned int rate;
+  uint64_t first_ticks;
+  {
+    // the settings of start() are copied under the lock, like the buffers
+    std::lock_guard<std::mutex> lock(mutex);
+    rate = sample_rate;
+    first_ticks = start_ticks;
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+      written += buffers[i]->get_written();
+      buffers[i]->copy(records);
+      thread_ends.push_back(records.size());
+      threads.push_back(buffers[i]->get_thread());
+    }
+
+    uint64_t ticks = trace_ticks() - start_ticks;
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start_time;
+    if (ticks > 0)
+    {
+      ns_per_tick = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / (double)ticks;
+    }
+  }
+
+  std::ofstream out(path.c_str());
+  if (!out.is_open())
+  {
+    return false;
+  }
+
+  out << "# TRACE" << std::endl;
+  out << "# 1 of " << rate << " calls per probe and thread, " << records.size() << " of " << written << " samples kept" << std::endl;
+  out << "# PROBE;SAMPLES;MEAN_NS;MIN_NS;MAX_NS" << std::endl;
+  for (unsigned int probe = 0; probe < TRACE_PROBE_COUNT; probe++)
+  {
+    size_t samples = 0;
+    double sum = 0;
+    uint32_t min_duration = 0xFFFFFFFFu;
+    uint32_t max_duration = 0;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+      if (records[i].probe != probe)
+      {
+        continue;
+      }
+      samples++;
+      sum += records[i].duration;
+      min_duration = records[i].duration < min_duration ? records[i].duration : min_duration;
+      max_duration = records[i].duration > max_duration ? records[i].duration : max_duration;
+    }
+    if (samples == 0)
+    {
+      continue;
+    }
+    out << probe_names[probe] << ";" << samples << ";" << (uint64_t)(sum / samples * ns_per_tick) << ";"
+        << (uint64_t)(min_duration * ns_per_tick) << ";" << (uint64_t)(max_duration * ns_per_tick) << std::endl;
+  }
+  out << std::endl;
+
+  out << "# THREAD;PROBE;START_NS;DURATION_NS;VALUE" << std::endl;
+  size_t begin = 0;
+  for (size_t thread = 0; thread < thread_ends.size(); thread++)
+  {
+    for (size_t i = begin; i < thread_ends[thread]; i++)
+    {
+      const trace_record &rec = records[i];
+      // the counters of the cores may differ slightly
+      uint64_t start = rec.start > first_ticks ? rec.start - first_ticks : 0;
+      out << threads[thread] << ";" << probe_names[rec.probe] << ";" << (uint64_t)(start * ns_per_tick) << ";"
+          << (uint64_t)(rec.duration * ns_per_tick) << ";" << rec.value << "\n";
+    }
+    begin = thread_ends[thread];
+  }
+  out << std::endl;
+  out.flush();
+  return true;
+}
+
+/*==========================================================================*/
+
+trace_buffer *trace_begin(trace_probe probe)
+{
+  return tracer::instance().sample(probe);
+}
+
+void trace_end(trace_buffer *buffer, trace_probe probe, uint64_t start, size_t value)
+{
+  buffer->record(probe, start, trace_ticks(), (uint32_t)value);
+}
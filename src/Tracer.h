@@ -0,0 +1,188 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    Tracer.h
+/// @author  agent
+/// @date    2026/10/17
+///
+/// Sampled timing of calls in per thread ring buffers, switched on by the config.
+//
+/****************************************************************************/
+
+#ifndef __TRACER_H
+#define __TRACER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// the time stamp counter on x86, the steady clock elsewhere
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define TRACE_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// traced calls, named without the prefix in the dump
+enum trace_probe
+{
+  TRACE_EM_SET,
+  TRACE_EM_GET,
+  TRACE_EM_EXEC,
+  TRACE_PHEM_CREATE_HELPER,
+  TRACE_PHEM_CREATE_VEHICLE,
+  TRACE_PHEM_DESTROY_VEHICLE,
+  TRACE_PHEM_GET_VEHICLE,
+  TRACE_PHEM_CALC_EMISSION,
+  TRACE_PHEM_CALC_EMISSION_PUB,
+  TRACE_PHEM_CALC_PENDING, // value: pending vehicles
+  TRACE_PHEM_CALC_BATCH,   // value: vehicles of the batch
+  TRACE_PHEM_GET_VEHICLE_EMISSION,
+  TRACE_PROBE_COUNT
+};
+
+// one sampled call, in ticks of trace_ticks()
+struct trace_record
+{
+  uint64_t start;
+  uint32_t duration;
+  uint32_t value;
+  uint32_t probe;
+};
+
+// records of one thread, only written by it. The oldest records are overwritten when it is full
+class trace_buffer
+{
+
+private:
+  // record in the ring, read by a concurrent dump while the thread overwrites it. Relaxed atomics,
+  // the dump drops the records written during its copy
+  struct trace_slot
+  {
+    std::atomic<uint64_t> start;
+    std::atomic<uint32_t> duration;
+    std::atomic<uint32_t> value;
+    std::atomic<uint32_t> probe;
+  };
+
+  std::unique_ptr<trace_slot[]> records;
+  uint64_t slot_count; // power of two
+  uint64_t mask;
+  std::atomic<uint64_t> written;
+  unsigned int thread; // in the order of the first sample
+
+  // spacing of the samples, random so they don't follow a repeating order of the calls. The rate
+  // is copied from the tracer, the thread reads it without its lock
+  uint32_t random_state;
+  unsigned int rate;
+
+public:
+  trace_buffer(size_t capacity, unsigned int p_thread, unsigned int p_rate);
+
+  void record(unsigned int probe, uint64_t start, uint64_t end, uint32_t value);
+
+  // calls to skip before the next sample, 0 to 2 * rate - 2 with a mean of rate - 1
+  unsigned int next_skip();
+
+  // appends the records, those overwritten while copying are dropped
+  void copy(std::vector<trace_record> &out) const;
+  uint64_t get_written() const;
+  unsigned int get_thread() const;
+};
+
+class tracer
+{
+
+private:
+  std::mutex mutex;
+  std::vector<std::unique_ptr<trace_buffer> > buffers;
+  size_t buffer_size;
+  unsigned int sample_rate;
+
+  // ticks are converted with the clock elapsed since the start
+  uint64_t start_ticks;
+  std::chrono::steady_clock::time_point start_time;
+
+  tracer();
+
+public:
+  static tracer &instance();
+
+  // records 1 of sample_rate calls of each probe and thread, in buffers of buffer_size records.
+  // Only the first start sets them, false for the later ones
+  bool start(unsigned int p_sample_rate, size_t p_buffer_size);
+
+  // sampled call, returns the buffer of the thread and sets the calls skipped until the next sample
+  trace_buffer *sample(unsigned int probe);
+
+  // summary per probe and the records of all threads, while they are still recording
+  bool dump(const std::string &path);
+};
+
+// set by tracer::start, checked by every probe
+extern std::atomic<bool> trace_enabled;
+
+// calls of each probe until its next sample in this thread, 0 samples the first call. Defined
+// inline, so the probes access it without a call to initialize it
+inline thread_local unsigned int trace_countdown[TRACE_PROBE_COUNT];
+
+inline uint64_t trace_ticks()
+{
+#ifdef TRACE_X86
+  return __rdtsc();
+#else
+  return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// sampled call of a probe, returns the buffer of the thread
+trace_buffer *trace_begin(trace_probe probe);
+void trace_end(trace_buffer *buffer, trace_probe probe, uint64_t start, size_t value);
+
+// times a call from its construction to stop() if tracing is on and the call is sampled, otherwise
+// one load and branch at both. Without a destructor and with the sampled calls recorded out of
+// line, the probes don't keep small functions from inlining
+class trace_point
+{
+
+private:
+  trace_buffer *buffer;
+  uint64_t start;
+  trace_probe probe;
+
+public:
+  inline explicit trace_point(trace_probe p_probe) : buffer(NULL), start(0), probe(p_probe)
+  {
+    if (trace_enabled.load(std::memory_order_relaxed) && trace_countdown[p_probe]-- == 0)
+    {
+      buffer = trace_begin(p_probe);
+      start = trace_ticks();
+    }
+  }
+
+  // records the call, paths without a stop() are not recorded
+  inline void stop(size_t value = 0)
+  {
+    if (buffer != NULL)
+    {
+      trace_end(buffer, probe, start, value);
+      buffer = NULL;
+    }
+  }
+};
+
+#endif /* __TRACER_H */
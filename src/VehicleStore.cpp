@@ -0,0 +1,221 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    VehicleStore.cpp
+/// @author  agent
+/// @date    2026/10/17
+///
+//
+/****************************************************************************/
+
+#include <algorithm>
+
+#include "VehicleStore.h"
+
+const long vehicle_store::DIRECT_INDEX_LIMIT;
+const unsigned int vehicle_store::NO_SLOT;
+
+vehicle_store::vehicle_store()
+{
+  // avoid reallocation for the first vehicles of a run
+  vehicles.reserve(1024);
+  emissions.reserve(1024);
+  slots.reserve(1024);
+  idle_total = 0;
+}
+
+unsigned int vehicle_store::find_slot(long id) const
+{
+  if (id >= 0 && id < DIRECT_INDEX_LIMIT)
+  {
+    if (id < (long)direct_index.size())
+    {
+      return direct_index[id];
+    }
+    return NO_SLOT;
+  }
+
+  std::unordered_map<long, unsigned int>::const_iterator element = sparse_index.find(id);
+  if (element == sparse_index.end())
+  {
+    return NO_SLOT;
+  }
+  return element->second;
+}
+
+void vehicle_store::set_slot(long id, unsigned int slot)
+{
+  if (id >= 0 && id < DIRECT_INDEX_LIMIT)
+  {
+    if (id >= (long)direct_index.size())
+    {
+      // vissim ids are increasing, so grow geometrically
+      size_t new_size = direct_index.size() < 1024 ? 1024 : direct_index.size() * 2;
+      while ((long)new_size <= id)
+      {
+        new_size *= 2;
+      }
+      direct_index.resize(new_size, NO_SLOT);
+    }
+    direct_index[id] = slot;
+  }
+  else if (slot == NO_SLOT)
+  {
+    sparse_index.erase(id);
+  }
+  else
+  {
+    sparse_index[id] = slot;
+  }
+}
+
+bool vehicle_store::create(long id, long type, vehicle_handle &handle)
+{
+  if (find_slot(id) != NO_SLOT)
+  {
+    // vehicle id already existing
+    return false;
+  }
+
+  unsigned int slot;
+  if (free_slots.empty())
+  {
+    // append new row
+    slot = (unsigned int)slots.size();
+    vehicles.push_back(vehicle(type));
+    emissions.push_back(emission(0.0));
+    slot_info info;
+    info.id = id;
+    info.generation = 1;
+    info.has_emission = false;
+    info.idle_emission = NULL;
+    slots.push_back(info);
+  }
+  else
+  {
+    // reuse row of a destroyed vehicle
+    slot = free_slots.back();
+    free_slots.pop_back();
+    vehicles[slot] = vehicle(type);
+    emissions[slot] = emission(0.0);
+    slots[slot].id = id;
+    slots[slot].generation++;
+    slots[slot].has_emission = false;
+    slots[slot].idle_emission = NULL;
+  }
+
+  set_slot(id, slot);
+  handle = vehicle_handle(slot, slots[slot].generation);
+  return true;
+}
+
+bool vehicle_store::destroy(long id)
+{
+  unsigned int slot = find_slot(id);
+  if (slot == NO_SLOT)
+  {
+    // no vehicle for id
+    return false;
+  }
+
+  remove_idle(slot);
+
+  // invalidate all handles to this slot and put it on the free list
+  slots[slot].generation++;
+  slots[slot].has_emission = false;
+  free_slots.push_back(slot);
+  set_slot(id, NO_SLOT);
+  return true;
+}
+
+bool vehicle_store::find(long id, vehicle_handle &handle) const
+{
+  unsigned int slot = find_slot(id);
+  if (slot == NO_SLOT)
+  {
+    return false;
+  }
+  handle = vehicle_handle(slot, slots[slot].generation);
+  return true;
+}
+
+void vehicle_store::clear()
+{
+  vehicles.clear();
+  emissions.clear();
+  slots.clear();
+  free_slots.clear();
+  direct_index.clear();
+  sparse_index.clear();
+  idle_counts.clear();
+  idle_total = 0;
+}
+
+size_t vehicle_store::size() const
+{
+  return slots.size() - free_slots.size();
+}
+
+void vehicle_store::remove_idle(unsigned int slot)
+{
+  if (slots[slot].idle_emission != NULL)
+  {
+    slots[slot].idle_emission = NULL;
+    idle_counts[vehicles[slot].type].current--;
+    idle_total--;
+  }
+}
+
+void vehicle_store::set_idle(const vehicle_handle &handle, const emission *idle_emission)
+{
+  slot_info &info = slots[handle.slot];
+  if (idle_emission == NULL)
+  {
+    remove_idle(handle.slot);
+    return;
+  }
+
+  if (info.idle_emission == NULL)
+  {
+    // vehicle stops, counted once until it starts again
+    idle_count &count = idle_counts[vehicles[handle.slot].type];
+    count.current++;
+    count.peak = std::max(count.peak, count.current);
+    idle_total++;
+  }
+  info.idle_emission = idle_emission;
+  info.has_emission = true;
+}
+
+size_t vehicle_store::get_idle_count() const
+{
+  return idle_total;
+}
+
+size_t vehicle_store::get_idle_count(long type) const
+{
+  std::unordered_map<long, idle_count>::const_iterator element = idle_counts.find(type);
+  return element != idle_counts.end() ? element->second.current : 0;
+}
+
+size_t vehicle_store::get_idle_peak(long type) const
+{
+  std::unordered_map<long, idle_count>::const_iterator element = idle_counts.find(type);
+  return element != idle_counts.end() ? element->second.peak : 0;
+}
+
+void vehicle_store::get_idle_types(std::vector<long> &types) const
+{
+  types.clear();
+  for (std::unordered_map<long, idle_count>::const_iterator element = idle_counts.begin(); element != idle_counts.end(); element++)
+  {
+    types.push_back(element->first);
+  }
+  std::sort(types.begin(), types.end());
+}
@@ -0,0 +1,283 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    VehicleStore.h
+/// @author  agent
+/// @date    2026/10/17
+///
+/// Dense, generation checked storage for vehicle states and emission rows.
+//
+/****************************************************************************/
+
+#ifndef __VEHICLESTORE_H
+#define __VEHICLESTORE_H
+
+#include <cstddef>
+#include <vector>
+#include <unordered_map>
+
+struct cep_binding;
+
+struct vehicle
+{
+  long type;
+  const cep_binding *binding; // resolved once at creation
+  double acceleration;
+  double velocity;
+  double slope;
+  double weight;
+  double timestep;
+
+  // LAZY: pollutant generation of its emission row, 0 until its last calculate command is calculated
+  unsigned int row_generation;
+  bool row_requested; // LAZY: emission read since the last deferred calculation
+
+  vehicle() : type(-1), binding(NULL), acceleration(0), velocity(0), slope(0), weight(0), timestep(0), row_generation(0), row_requested(false) {}
+
+  vehicle(long p_type) : type(p_type), binding(NULL), acceleration(0), velocity(0), slope(0), weight(0), timestep(0), row_generation(0), row_requested(false) {}
+
+  vehicle(long p_type, double p_acceleration, double p_velocity, double p_slope, double p_weight, double p_timestep)
+  {
+    type = p_type;
+    binding = NULL;
+    acceleration = p_acceleration;
+    velocity = p_velocity;
+    slope = p_slope;
+    weight = p_weight;
+    timestep = p_timestep;
+    row_generation = 0;
+    row_requested = false;
+  }
+};
+
+// vehicle values set by vissim since the vehicle id, written to the vehicle at its calculate command
+struct vehicle_input
+{
+  enum field
+  {
+    FIELD_TIMESTEP = 1,
+    FIELD_VELOCITY = 2,
+    FIELD_ACCELERATION = 4,
+    FIELD_WEIGHT = 8,
+    FIELD_SLOPE = 16
+  };
+
+  unsigned int fields; // set fields, the others keep the value of the vehicle
+  double timestep;     // general timestep of the simulation, added at the calculate command
+  double velocity;
+  double acceleration;
+  double weight;
+  double slope;
+
+  vehicle_input() : fields(0), timestep(-1), velocity(-1), acceleration(-1), weight(-1), slope(-1) {}
+
+  inline void apply(vehicle *veh) const
+  {
+    if (fields & FIELD_TIMESTEP)
+    {
+      veh->timestep = timestep;
+    }
+    if (fields & FIELD_VELOCITY)
+    {
+      veh->velocity = velocity;
+    }
+    if (fields & FIELD_ACCELERATION)
+    {
+      veh->acceleration = acceleration;
+    }
+    if (fields & FIELD_WEIGHT)
+    {
+      veh->weight = weight;
+    }
+    if (fields & FIELD_SLOPE)
+    {
+      veh->slope = slope;
+    }
+  }
+};
+
+// cep columns that can be read as additional vissim emission types
+static const int EMISSION_COLUMN_COUNT = 8;
+
+struct emission
+{
+  double fuel_consumption; // [g/s] / [kWh/s for BEV]
+  double norm_drive;       //
+  double norm_rated;       //
+  double co;               // [g/s]
+  double co2;              // [g/s]
+  double hc;               // [g/s]
+  double nox;              // [g/s]
+  double pm;               // [g/s]
+
+  // configured cep columns in the order of the config, [unit of the column / s]
+  double columns[EMISSION_COLUMN_COUNT];
+
+  emission(double default_value)
+  {
+    fuel_consumption = default_value;
+    norm_drive = default_value;
+    norm_rated = default_value;
+    co = default_value;
+    co2 = default_value;
+    hc = default_value;
+    nox = default_value;
+    pm = default_value;
+    for (int i = 0; i < EMISSION_COLUMN_COUNT; i++)
+    {
+      columns[i] = default_value;
+    }
+  }
+
+  emission()
+  {
+    fuel_consumption = 0.1;
+    norm_drive = 0.2;
+    norm_rated = 0.3;
+    co = 0.4;
+    co2 = 0.5;
+    hc = 0.6;
+    nox = 0.7;
+    pm = 0.8;
+    for (int i = 0; i < EMISSION_COLUMN_COUNT; i++)
+    {
+      columns[i] = 0;
+    }
+  }
+
+  emission(double p_fuel_consumption, double p_norm_drive, double p_norm_rated, double p_co, double p_co2, double p_hc, double p_nox, double p_pm)
+  {
+    fuel_consumption = p_fuel_consumption;
+    norm_drive = p_norm_drive;
+    norm_rated = p_norm_rated;
+    co = p_co;
+    co2 = p_co2;
+    hc = p_hc;
+    nox = p_nox;
+    pm = p_pm;
+    for (int i = 0; i < EMISSION_COLUMN_COUNT; i++)
+    {
+      columns[i] = 0;
+    }
+  }
+};
+
+// handle to a slot of the vehicle store, only valid as long as the generation matches
+struct vehicle_handle
+{
+  unsigned int slot;
+  unsigned int generation;
+
+  vehicle_handle() : slot(0), generation(0) {}
+
+  vehicle_handle(unsigned int p_slot, unsigned int p_generation) : slot(p_slot), generation(p_generation) {}
+};
+
+class vehicle_store
+{
+
+private:
+  // vissim ids below this limit are resolved by a direct index, all others by hashing
+  static constexpr long DIRECT_INDEX_LIMIT = 1L << 22;
+  static constexpr unsigned int NO_SLOT = 0xFFFFFFFFu;
+
+  struct slot_info
+  {
+    long id;
+    unsigned int generation; // odd while the slot is in use
+    bool has_emission;
+
+    // standing vehicles share the constant emission row of their cep instead of their own row
+    const emission *idle_emission;
+  };
+
+  // vehicle state and emission rows share the slot index
+  std::vector<vehicle> vehicles;
+  std::vector<emission> emissions;
+  std::vector<slot_info> slots;
+  std::vector<unsigned int> free_slots;
+
+  // id -> slot
+  std::vector<unsigned int> direct_index;
+  std::unordered_map<long, unsigned int> sparse_index;
+
+  // standing vehicles per vissim type, only changed when a vehicle stops, starts or is destroyed
+  struct idle_count
+  {
+    size_t current;
+    size_t peak;
+
+    idle_count() : current(0), peak(0) {}
+  };
+  std::unordered_map<long, idle_count> idle_counts;
+  size_t idle_total;
+
+  void remove_idle(unsigned int slot);
+
+  unsigned int find_slot(long id) const;
+  void set_slot(long id, unsigned int slot);
+
+public:
+  vehicle_store();
+
+  bool create(long id, long type, vehicle_handle &handle);
+  bool destroy(long id);
+  bool find(long id, vehicle_handle &handle) const;
+  void clear();
+
+  size_t size() const;
+
+  // puts a valid vehicle into the idle set with the shared row of its cep, NULL removes it, so the
+  // vehicle uses its own row again. Not thread safe, unlike the row access below
+  void set_idle(const vehicle_handle &handle, const emission *idle_emission);
+
+  // standing vehicles at the moment and at most since the start, in total or of one vissim type
+  size_t get_idle_count() const;
+  size_t get_idle_count(long type) const;
+  size_t get_idle_peak(long type) const;
+  void get_idle_types(std::vector<long> &types) const;
+
+  // generation check, fails for handles of destroyed or reused slots
+  inline bool is_valid(const vehicle_handle &handle) const
+  {
+    return handle.slot < slots.size() && slots[handle.slot].generation == handle.generation;
+  }
+
+  // access rows of a valid handle
+  inline vehicle *get_vehicle(const vehicle_handle &handle)
+  {
+    return &vehicles[handle.slot];
+  }
+
+  inline const emission *get_emission(const vehicle_handle &handle)
+  {
+    const slot_info &info = slots[handle.slot];
+    if (!info.has_emission)
+    {
+      return NULL;
+    }
+    return info.idle_emission != NULL ? info.idle_emission : &emissions[handle.slot];
+  }
+
+  inline emission *get_emission_row(const vehicle_handle &handle)
+  {
+    return &emissions[handle.slot];
+  }
+
+  // ignored for handles of destroyed or reused slots
+  inline void set_has_emission(const vehicle_handle &handle)
+  {
+    if (is_valid(handle))
+    {
+      slots[handle.slot].has_emission = true;
+    }
+  }
+};
+
+#endif /* __VEHICLESTORE_H */
@@ -0,0 +1,358 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    WorkerPool.cpp
+/// @author  agent
+/// @date    2026/10/17
+///
+//
+/****************************************************************************/
+
+#include <chrono>
+#include <climits>
+#include <system_error>
+
+#include "WorkerPool.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+static unsigned long long pack_range(unsigned long long front, unsigned long long back)
+{
+  return (front << 32) | back;
+}
+
+#if defined(_WIN32)
+
+// argument of a thread started by start_detached_thread
+struct detached_start
+{
+  void (*entry)(void *);
+  void *context;
+  HMODULE module;
+};
+
+static DWORD WINAPI detached_main(LPVOID parameter)
+{
+  detached_start start = *(detached_start *)parameter;
+  delete (detached_start *)parameter;
+  start.entry(start.context);
+
+  // drops the reference without returning into the code it may unload
+  FreeLibraryAndExitThread(start.module, 0);
+  return 0;
+}
+
+#endif
+
+bool start_detached_thread(void (*entry)(void *), void *context, int core)
+{
+  bool pinned = core >= 0 && core < worker_pool::core_limit();
+#if defined(_WIN32)
+  detached_start *start = new detached_start;
+  start->entry = entry;
+  start->context = context;
+  if (!GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, (LPCSTR)&start_detached_thread, &start->module))
+  {
+    delete start;
+    return false;
+  }
+  HANDLE thread = CreateThread(NULL, 0, &detached_main, start, 0, NULL);
+  if (thread == NULL)
+  {
+    FreeLibrary(start->module);
+    delete start;
+    return false;
+  }
+  if (pinned)
+  {
+    SetThreadAffinityMask(thread, (DWORD_PTR)1 << core);
+  }
+  CloseHandle(thread);
+  return true;
+#else
+  try
+  {
+    std::thread thread(entry, context);
+#if defined(__linux__)
+    if (pinned)
+    {
+      cpu_set_t cpu_set;
+      CPU_ZERO(&cpu_set);
+      CPU_SET(core, &cpu_set);
+      pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set), &cpu_set);
+    }
+#else
+    (void)pinned;
+#endif
+    thread.detach();
+    return true;
+  }
+  catch (const std::system_error &)
+  {
+    return false;
+  }
+#endif
+}
+
+worker_pool::worker_pool()
+{
+  queues = NULL;
+  starts = NULL;
+  worker_count = 1;
+  generation = 0;
+  stopping = false;
+  task = NULL;
+  context = NULL;
+  remaining = 0;
+  busy = 0;
+  running = 0;
+  abandoned = false;
+}
+
+worker_pool::~worker_pool()
+{
+  stop();
+}
+
+void worker_pool::start(unsigned int thread_count, const std::vector<int> &cores)
+{
+  stop();
+
+  worker_count = thread_count > 1 ? thread_count : 1;
+  queues = new worker_queue[worker_count];
+  starts = new worker_start[worker_count];
+  active.assign(worker_count, 0);
+  thread_cores.assign(worker_count, -1);
+  for (unsigned int i = 0; i < worker_count; i++)
+  {
+    queues[i].range = 0;
+    starts[i].pool = this;
+    starts[i].worker = i;
+    if (i > 0 && !cores.empty())
+    {
+      thread_cores[i] = cores[(i - 1) % cores.size()];
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  stopping = false;
+  for (unsigned int i = 1; i < worker_count; i++)
+  {
+    start_thread(i);
+  }
+}
+
+void worker_pool::stop()
+{
+  if (!abandoned)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    stopping = true;
+    start_condition.notify_all();
+    done_condition.wait(lock, [this]
+                        { return running == 0; });
+  }
+
+  active.clear();
+  thread_cores.clear();
+  delete[] starts;
+  starts = NULL;
+  delete[] queues;
+  queues = NULL;
+  worker_count = 1;
+  abandoned = false;
+}
+
+void worker_pool::abandon()
+{
+  abandoned = true;
+  running = 0;
+}
+
+unsigned int worker_pool::size() const
+{
+  return worker_count;
+}
+
+void worker_pool::run(size_t chunk_count, worker_task current_task, void *current_context)
+{
+  if (worker_count <= 1 || chunk_count <= 1)
+  {
+    // nothing to share
+    for (size_t chunk = 0; chunk < chunk_count; chunk++)
+    {
+      current_task(current_context, chunk, 0);
+    }
+    return;
+  }
+
+  {
+    // hand out contiguous ranges, a worker keeps its data local unless it runs out of work
+    std::lock_guard<std::mutex> lock(mutex);
+    for (unsigned int i = 1; i < worker_count; i++)
+    {
+      if (!active[i])
+      {
+        // ended after being idle
+        start_thread(i);
+      }
+    }
+    for (unsigned int i = 0; i < worker_count; i++)
+    {
+      unsigned long long front = (unsigned long long)(chunk_count * i / worker_count);
+      unsigned long long back = (unsigned long long)(chunk_count * (i + 1) / worker_count);
+      queues[i].range = pack_range(front, back);
+    }
+    task = current_task;
+    context = current_context;
+    remaining = chunk_count;
+    generation++;
+  }
+  start_condition.notify_all();
+
+  work(0, current_task, current_context);
+
+  // all chunks done and no worker still looking at the queues of this batch
+  std::unique_lock<std::mutex> lock(mutex);
+  done_condition.wait(lock, [this]
+                      { return remaining == 0 && busy == 0; });
+}
+
+void worker_pool::start_thread(unsigned int worker)
+{
+  // called under mutex, a worker without a thread leaves its chunks to be stolen by the others
+  if (start_detached_thread(&worker_pool::thread_entry, &starts[worker], thread_cores[worker]))
+  {
+    active[worker] = 1;
+    running++;
+  }
+}
+
+void worker_pool::thread_entry(void *start)
+{
+  worker_start *current = (worker_start *)start;
+  current->pool->thread_main(current->worker);
+}
+
+void worker_pool::thread_main(unsigned int worker)
+{
+  unsigned long long seen = 0;
+  for (;;)
+  {
+    worker_task current_task;
+    void *current_context;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      bool woken = start_condition.wait_for(lock, std::chrono::seconds(IDLE_SECONDS), [this, seen]
+                                            { return stopping || generation != seen; });
+      if (!woken || stopping)
+      {
+        // stop() may free the pool once running is 0 and the lock is released
+        active[worker] = 0;
+        running--;
+        done_condition.notify_all();
+        return;
+      }
+      seen = generation;
+      if (remaining == 0)
+      {
+        // woke up after the batch was finished by the others
+        continue;
+      }
+      current_task = task;
+      current_context = context;
+      busy++;
+    }
+
+    work(worker, current_task, current_context);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      busy--;
+    }
+    done_condition.notify_all();
+  }
+}
+
+void worker_pool::work(unsigned int worker, worker_task current_task, void *current_context)
+{
+  size_t chunk;
+  while (pop(worker, chunk) || steal(worker, chunk))
+  {
+    current_task(current_context, chunk, worker);
+    if (remaining.fetch_sub(1) == 1)
+    {
+      // last chunk, wake up the caller
+      std::lock_guard<std::mutex> lock(mutex);
+      done_condition.notify_all();
+    }
+  }
+}
+
+bool worker_pool::pop(unsigned int worker, size_t &chunk)
+{
+  // own chunks are taken from the front
+  std::atomic<unsigned long long> &range = queues[worker].range;
+  unsigned long long current = range.load();
+  for (;;)
+  {
+    unsigned long long front = current >> 32;
+    unsigned long long back = current & 0xFFFFFFFFull;
+    if (front >= back)
+    {
+      return false;
+    }
+    if (range.compare_exchange_weak(current, pack_range(front + 1, back)))
+    {
+      chunk = (size_t)front;
+      return true;
+    }
+  }
+}
+
+bool worker_pool::steal(unsigned int worker, size_t &chunk)
+{
+  // chunks of other workers are taken from the back, far from their owner
+  for (unsigned int i = 1; i < worker_count; i++)
+  {
+    std::atomic<unsigned long long> &range = queues[(worker + i) % worker_count].range;
+    unsigned long long current = range.load();
+    for (;;)
+    {
+      unsigned long long front = current >> 32;
+      unsigned long long back = current & 0xFFFFFFFFull;
+      if (front >= back)
+      {
+        break;
+      }
+      if (range.compare_exchange_weak(current, pack_range(front, back - 1)))
+      {
+        chunk = (size_t)(back - 1);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+int worker_pool::core_limit()
+{
+#if defined(_WIN32)
+  return (int)(sizeof(DWORD_PTR) * 8);
+#elif defined(__linux__)
+  return CPU_SETSIZE;
+#else
+  return INT_MAX;
+#endif
+}
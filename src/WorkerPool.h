@@ -0,0 +1,111 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    WorkerPool.h
+/// @author  agent
+/// @date    2026/10/17
+///
+/// Persistent, optionally core pinned threads working on the chunks of a batch.
+//
+/****************************************************************************/
+
+#ifndef __WORKERPOOL_H
+#define __WORKERPOOL_H
+
+#include <cstddef>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// task for one chunk, worker is the index of the executing worker (0 = calling thread)
+typedef void (*worker_task)(void *context, size_t chunk, unsigned int worker);
+
+// runs entry(context) on a new detached thread, pinned to core unless it is -1. On Windows the thread
+// holds a reference to the dll until it ended, so FreeLibrary doesn't unmap the code it still runs and
+// the dll is unloaded after the last of these threads. False if no thread could be started
+bool start_detached_thread(void (*entry)(void *), void *context, int core);
+
+class worker_pool
+{
+
+private:
+  // chunks owned by a worker, front and back packed into one word so owner and thieves agree by a single CAS
+  struct worker_queue
+  {
+    std::atomic<unsigned long long> range;
+    char padding[64 - sizeof(std::atomic<unsigned long long>)];
+  };
+
+  // argument of the thread of a worker
+  struct worker_start
+  {
+    worker_pool *pool;
+    unsigned int worker;
+  };
+
+  worker_queue *queues;
+  worker_start *starts;
+  unsigned int worker_count;
+
+  // per worker, whether its thread runs and the core it is pinned to (-1 for none). Guarded by mutex
+  std::vector<char> active;
+  std::vector<int> thread_cores;
+
+  // current batch, guarded by mutex while it is handed out
+  std::mutex mutex;
+  std::condition_variable start_condition;
+  std::condition_variable done_condition;
+  unsigned long long generation;
+  bool stopping;
+  worker_task task;
+  void *context;
+  std::atomic<size_t> remaining;
+  unsigned int busy;
+  unsigned int running; // threads that have not left thread_main
+  bool abandoned;
+
+  // a thread without a batch for this long ends, the next batch starts it again
+  static constexpr int IDLE_SECONDS = 5;
+
+  static void thread_entry(void *start);
+  void start_thread(unsigned int worker);
+  void thread_main(unsigned int worker);
+  void work(unsigned int worker, worker_task current_task, void *current_context);
+  bool pop(unsigned int worker, size_t &chunk);
+  bool steal(unsigned int worker, size_t &chunk);
+
+public:
+  worker_pool();
+  ~worker_pool();
+
+  // starts thread_count - 1 detached threads, the calling thread is worker 0. Thread i is pinned to
+  // cores[(i - 1) % cores.size()], no pinning for empty cores. Idle threads end after IDLE_SECONDS, so
+  // they don't keep an unloaded dll loaded during the rest of the process
+  void start(unsigned int thread_count, const std::vector<int> &cores);
+
+  // waits until all threads left the pool, without a join
+  void stop();
+
+  // forgets the threads terminated by the exit of the process, without waiting for them or taking
+  // the lock one of them may have held
+  void abandon();
+
+  unsigned int size() const;
+
+  // threads can be pinned to the cores [0, core_limit()), the size of the affinity mask
+  static int core_limit();
+
+  // executes task for all chunks in [0, chunk_count) and returns when all are done,
+  // chunks are split in contiguous ranges per worker, idle workers steal from the others
+  void run(size_t chunk_count, worker_task current_task, void *current_context);
+};
+
+#endif /* __WORKERPOOL_H */
@@ -0,0 +1,270 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    SteadyStateAllocation.cpp
+/// @author  agent
+/// @date    2026/10/17
+///
+/// Replays the calls of Vissim for a set of vehicles and fails if a time step after the
+/// warm-up allocates heap memory.
+/// usage: SteadyStateAllocation <directory of the vehicle files> <CALCULATION mode>
+//
+/****************************************************************************/
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+
+#include "../EmissionModel.h"
+
+#define VEHICLE_COUNT 64
+#define WARMUP_STEPS 20
+#define MEASURED_STEPS 200
+
+static std::atomic<unsigned long> allocations(0);
+
+// sum of the values read, 0 if no vehicle was calculated
+static double total_emission = 0;
+
+/*==========================================================================*/
+
+// counting replacements of the global allocation functions, the other forms forward to these
+
+void *operator new(std::size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void *memory = std::malloc(size > 0 ? size : 1);
+  if (memory == NULL)
+  {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void *operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(size > 0 ? size : 1);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept
+{
+  return operator new(size, tag);
+}
+
+void operator delete(void *memory) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept
+{
+  std::free(memory);
+}
+
+#if defined(_MSC_VER)
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void *memory = _aligned_malloc(size > 0 ? size : 1, (std::size_t)alignment);
+  if (memory == NULL)
+  {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept
+{
+  _aligned_free(memory);
+}
+
+#else
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  std::size_t align = (std::size_t)alignment > sizeof(void *) ? (std::size_t)alignment : sizeof(void *);
+  void *memory = NULL;
+  if (posix_memalign(&memory, align, size > 0 ? size : 1) != 0)
+  {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept
+{
+  std::free(memory);
+}
+
+#endif
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+  return operator new(size, alignment);
+}
+
+void operator delete[](void *memory, std::align_val_t alignment) noexcept
+{
+  operator delete(memory, alignment);
+}
+
+void operator delete(void *memory, std::size_t, std::align_val_t alignment) noexcept
+{
+  operator delete(memory, alignment);
+}
+
+void operator delete[](void *memory, std::size_t, std::align_val_t alignment) noexcept
+{
+  operator delete(memory, alignment);
+}
+
+/*==========================================================================*/
+
+static bool set_long(long type, long value)
+{
+  return EmissionModelSetValue(type, 0, 0, value, 0, NULL) == 1;
+}
+
+static bool set_double(long type, double value)
+{
+  return EmissionModelSetValue(type, 0, 0, 0, value, NULL) == 1;
+}
+
+// one time step of all vehicles, with a drive cycle that changes the speed of each vehicle
+static bool simulate_step(int step)
+{
+  if (!set_double(EMISSION_DATA_TIME, step))
+  {
+    return false;
+  }
+  for (int i = 0; i < VEHICLE_COUNT; i++)
+  {
+    int phase = (step + 7 * i) % 40;
+    double velocity = phase < 20 ? 1.5 * phase : 1.5 * (40 - phase);
+    double acceleration = phase < 20 ? 1.5 : -1.5;
+    if (!set_long(EMISSION_DATA_VEH_ID, i + 1) ||
+        !set_long(EMISSION_DATA_VEH_TYPE, 100 + i % 3) ||
+        !set_double(EMISSION_DATA_VEH_VELOCITY, velocity) ||
+        !set_double(EMISSION_DATA_VEH_ACCELERATION, acceleration) ||
+        !set_double(EMISSION_DATA_VEH_WEIGHT, 0) ||
+        !set_double(EMISSION_DATA_SLOPE, (i % 5 - 2) * 0.01) ||
+        EmissionModelExecuteCommand(EMISSION_COMMAND_CALCULATE_VEHICLE) != 1)
+    {
+      return false;
+    }
+  }
+
+  // the results are read after all vehicles are calculated, like vissim does
+  for (int i = 0; i < VEHICLE_COUNT; i++)
+  {
+    if (!set_long(EMISSION_DATA_VEH_ID, i + 1))
+    {
+      return false;
+    }
+    for (long type = EMISSION_DATA_BENZ; type <= EMISSION_DATA_NAPHT_GAS; type++)
+    {
+      double value = 0;
+      if (EmissionModelGetValue(type, 0, 0, NULL, &value, NULL) != 1)
+      {
+        return false;
+      }
+      total_emission += value;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 3)
+  {
+    std::fprintf(stderr, "usage: %s <directory of the vehicle files> <CALCULATION mode>\n", argv[0]);
+    return 2;
+  }
+
+  {
+    // the dll reads its config from the working directory
+    std::ofstream config("Vissim_PHEMlight.cfg");
+    config << "PATH = " << argv[1] << "/" << std::endl;
+    config << "CALCULATION = " << argv[2] << std::endl;
+    config << "DEFAULT;PC;G;EU4" << std::endl;
+    config << "100;PC;G;EU4" << std::endl;
+    config << "101;PC;D;EU4" << std::endl;
+    config << "102;PC;G;EU4" << std::endl;
+  }
+
+  if (!set_double(EMISSION_DATA_TIMESTEP, 1) ||
+      !set_double(EMISSION_DATA_TIME, 0) ||
+      EmissionModelExecuteCommand(EMISSION_COMMAND_INIT) != 1)
+  {
+    std::fprintf(stderr, "initialization failed\n");
+    return 1;
+  }
+  for (int i = 0; i < VEHICLE_COUNT; i++)
+  {
+    if (!set_long(EMISSION_DATA_VEH_ID, i + 1) ||
+        !set_long(EMISSION_DATA_VEH_TYPE, 100 + i % 3) ||
+        EmissionModelExecuteCommand(EMISSION_COMMAND_CREATE_VEHICLE) != 1)
+    {
+      std::fprintf(stderr, "vehicle %d not created\n", i + 1);
+      return 1;
+    }
+  }
+
+  int step = 1;
+  for (; step <= WARMUP_STEPS; step++)
+  {
+    if (!simulate_step(step))
+    {
+      std::fprintf(stderr, "warm-up step %d failed\n", step);
+      return 1;
+    }
+  }
+
+  unsigned long warm = allocations.load();
+  for (; step <= WARMUP_STEPS + MEASURED_STEPS; step++)
+  {
+    if (!simulate_step(step))
+    {
+      std::fprintf(stderr, "step %d failed\n", step);
+      return 1;
+    }
+  }
+  unsigned long steady = allocations.load() - warm;
+
+  std::printf("%lu allocations until the end of the warm-up, %lu in %d steps of %d vehicles after it\n", warm, steady,
+              MEASURED_STEPS, VEHICLE_COUNT);
+  if (!(total_emission > 0))
+  {
+    std::fprintf(stderr, "no emissions calculated\n");
+    return 1;
+  }
+  return steady == 0 ? 0 : 1;
+}
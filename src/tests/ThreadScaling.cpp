@@ -0,0 +1,201 @@
+/********************************************************************************/
+// Vissim PHEMlight Handler
+// Copyright (C) 2021 Karlsruhe Institut of Technology (KIT), https://ifv.kit.edu
+// PHEMlight module
+// This program and the accompanying materials are made available under the
+// terms of the Eclipse Public License 2.0 which is available at
+// https://www.eclipse.org/legal/epl-2.0/
+// SPDX-License-Identifier: EPL-2.0
+/********************************************************************************/
+/// @file    ThreadScaling.cpp
+/// @author  agent
+/// @date    2026/10/17
+///
+/// Times the DEFERRED calculation of a synthetic time step for a list of THREADS values and
+/// fails if the results of the thread counts differ or are all 0.
+/// usage: ThreadScaling <directory of the vehicle files> [vehicles] [steps] [thread counts...]
+//
+/****************************************************************************/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../EmissionModel.h"
+#include "../EmissionModelContext.h"
+
+#define DEFAULT_VEHICLE_COUNT 50000
+#define DEFAULT_STEP_COUNT 10
+
+// result of the steps of one thread count
+struct scaling_result
+{
+  double seconds;
+  unsigned long long hash;
+  double total; // sum of the values read, 0 if no vehicle was calculated
+};
+
+static bool set_long(emission_model_context &context, long type, long value)
+{
+  return context.set_value(type, 0, 0, value, 0, NULL) == 1;
+}
+
+static bool set_double(emission_model_context &context, long type, double value)
+{
+  return context.set_value(type, 0, 0, 0, value, NULL) == 1;
+}
+
+// one time step of all vehicles, the bits of all values read are hashed in their order
+static bool simulate_step(emission_model_context &context, int vehicle_count, int step, scaling_result &result)
+{
+  if (!set_double(context, EMISSION_DATA_TIME, step))
+  {
+    return false;
+  }
+  for (int i = 0; i < vehicle_count; i++)
+  {
+    int phase = (step + 7 * i) % 40;
+    double velocity = phase < 20 ? 1.5 * phase : 1.5 * (40 - phase);
+    double acceleration = phase < 20 ? 1.5 : -1.5;
+    if (!set_long(context, EMISSION_DATA_VEH_ID, i + 1) ||
+        !set_long(context, EMISSION_DATA_VEH_TYPE, 100 + i % 2) ||
+        !set_double(context, EMISSION_DATA_VEH_VELOCITY, velocity) ||
+        !set_double(context, EMISSION_DATA_VEH_ACCELERATION, acceleration) ||
+        !set_double(context, EMISSION_DATA_VEH_WEIGHT, 0) ||
+        !set_double(context, EMISSION_DATA_SLOPE, (i % 5 - 2) * 0.01) ||
+        context.execute_command(EMISSION_COMMAND_CALCULATE_VEHICLE) != 1)
+    {
+      return false;
+    }
+  }
+
+  // the first result request calculates the whole step on the worker threads
+  for (int i = 0; i < vehicle_count; i++)
+  {
+    if (!set_long(context, EMISSION_DATA_VEH_ID, i + 1))
+    {
+      return false;
+    }
+    for (long type = EMISSION_DATA_BENZ; type <= EMISSION_DATA_NAPHT_GAS; type++)
+    {
+      double value = 0;
+      if (context.get_value(type, 0, 0, NULL, &value, NULL) != 1)
+      {
+        return false;
+      }
+      unsigned long long bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      result.hash = (result.hash ^ bits) * 1099511628211ull;
+      result.total += value;
+    }
+  }
+  return true;
+}
+
+// runs the steps in a new context with THREADS = thread_count, false on an error of the calls
+static bool measure(const std::string &vehicle_path, int vehicle_count, int step_count, int thread_count,
+                    scaling_result &result)
+{
+  // each thread count reads its own config
+  std::string config_path = "ThreadScaling_" + std::to_string(thread_count) + ".cfg";
+  {
+    std::ofstream config(config_path.c_str());
+    config << "PATH = " << vehicle_path << "/" << std::endl;
+    config << "CALCULATION = DEFERRED" << std::endl;
+    config << "THREADS = " << thread_count << std::endl;
+    config << "DEFAULT;PC;G;EU4" << std::endl;
+    config << "100;PC;G;EU4" << std::endl;
+    config << "101;PC;D;EU4" << std::endl;
+  }
+
+  emission_model_context context(config_path);
+  if (!set_double(context, EMISSION_DATA_TIMESTEP, 1) ||
+      !set_double(context, EMISSION_DATA_TIME, 0) ||
+      context.execute_command(EMISSION_COMMAND_INIT) != 1)
+  {
+    return false;
+  }
+  for (int i = 0; i < vehicle_count; i++)
+  {
+    if (!set_long(context, EMISSION_DATA_VEH_ID, i + 1) ||
+        !set_long(context, EMISSION_DATA_VEH_TYPE, 100 + i % 2) ||
+        context.execute_command(EMISSION_COMMAND_CREATE_VEHICLE) != 1)
+    {
+      return false;
+    }
+  }
+
+  // the first step loads the ceps and sizes the batch, it is not timed
+  result.hash = 1469598103934665603ull;
+  result.total = 0;
+  if (!simulate_step(context, vehicle_count, 1, result))
+  {
+    return false;
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int step = 2; step <= step_count + 1; step++)
+  {
+    if (!simulate_step(context, vehicle_count, step, result))
+    {
+      return false;
+    }
+  }
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  result.seconds = std::chrono::duration<double>(end - start).count();
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    std::fprintf(stderr, "usage: %s <directory of the vehicle files> [vehicles] [steps] [thread counts...]\n", argv[0]);
+    return 2;
+  }
+  int vehicle_count = argc > 2 ? std::atoi(argv[2]) : DEFAULT_VEHICLE_COUNT;
+  int step_count = argc > 3 ? std::atoi(argv[3]) : DEFAULT_STEP_COUNT;
+  std::vector<int> thread_counts;
+  for (int i = 4; i < argc; i++)
+  {
+    thread_counts.push_back(std::atoi(argv[i]));
+  }
+  if (thread_counts.empty())
+  {
+    thread_counts = {1, 2, 4, 8, 16};
+  }
+  if (vehicle_count < 1 || step_count < 1)
+  {
+    std::fprintf(stderr, "vehicles and steps must be positive\n");
+    return 2;
+  }
+
+  std::printf("%d vehicles, %d steps\n", vehicle_count, step_count);
+  std::printf("threads  ms/step  vehicles/s  speedup\n");
+  scaling_result first;
+  for (size_t i = 0; i < thread_counts.size(); i++)
+  {
+    scaling_result result;
+    if (!measure(argv[1], vehicle_count, step_count, thread_counts[i], result) || !(result.total > 0))
+    {
+      std::fprintf(stderr, "THREADS = %d failed\n", thread_counts[i]);
+      return 1;
+    }
+    if (i == 0)
+    {
+      first = result;
+    }
+    std::printf("%7d  %7.2f  %10.0f  %7.2f\n", thread_counts[i], 1000 * result.seconds / step_count,
+                vehicle_count * step_count / result.seconds, first.seconds / result.seconds);
+    if (result.hash != first.hash)
+    {
+      std::fprintf(stderr, "THREADS = %d differs from THREADS = %d\n", thread_counts[i], thread_counts[0]);
+      return 1;
+    }
+  }
+  return 0;
+}